@@ -0,0 +1,172 @@
+#include "affinity.hpp"
+
+#include <cerrno>
+#include <charconv>
+#include <cstring>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <linux/mempolicy.h>
+#include <pthread.h>
+#include <sched.h>
+#include <set>
+#include <stdexcept>
+#include <string_view>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+/**
+ * @brief Parse a cpu number which is all of `text`
+ *
+ * @return False if `text` isn't exactly a number
+ */
+static bool parse_cpu(std::string_view text, int &cpu) {
+  auto [end, error] =
+      std::from_chars(text.data(), text.data() + text.size(), cpu);
+  return error == std::errc() && end == text.data() + text.size() &&
+         !text.empty();
+}
+
+std::vector<int> parse_cpu_list(const std::string &list) {
+  std::vector<int> cpus;
+  std::string_view rest = list;
+  while (true) {
+    std::string_view range = rest.substr(0, rest.find(','));
+    size_t dash = range.find('-');
+    int first;
+    int last;
+    if (!parse_cpu(range.substr(0, dash), first) ||
+        !parse_cpu(dash == range.npos ? range : range.substr(dash + 1),
+                   last) ||
+        first < 0 || last < first || last >= CPU_SETSIZE)
+      throw std::runtime_error(std::format("Invalid cpu list {}", list));
+    for (int cpu = first; cpu <= last; ++cpu)
+      cpus.push_back(cpu);
+    if (range.size() == rest.size())
+      return cpus;
+    rest.remove_prefix(range.size() + 1);
+  }
+}
+
+/**
+ * @brief NUMA node a cpu belongs to
+ *
+ * @return The node or -1 if the kernel doesn't tell
+ */
+static int numa_node_of(int cpu) {
+  std::error_code ec;
+  std::filesystem::path dir = std::format("/sys/devices/system/cpu/cpu{}", cpu);
+  for (auto &entry : std::filesystem::directory_iterator(dir, ec)) {
+    std::string name = entry.path().filename();
+    if (name.starts_with("node"))
+      return std::stoi(name.substr(4));
+  }
+  return -1;
+}
+
+/**
+ * @brief Prefer allocating from the node the cpus are on
+ * @details Only done when all the cpus are on a single node. Otherwise the
+ *          default first touch policy already keeps memory near the cpu
+ *          which touched it.
+ */
+static void prefer_local_node(const std::vector<int> &cpus,
+                              const std::string &tag) {
+  std::set<int> nodes;
+  for (int cpu : cpus)
+    nodes.insert(numa_node_of(cpu));
+  if (nodes.size() != 1 || *nodes.begin() < 0)
+    return;
+
+  int node = *nodes.begin();
+  unsigned long mask[16] = {};
+  if (node >= static_cast<int>(sizeof(mask) * 8))
+    return;
+  mask[node / (sizeof(unsigned long) * 8)] |=
+      1UL << (node % (sizeof(unsigned long) * 8));
+
+  if (syscall(SYS_set_mempolicy, MPOL_PREFERRED, mask, sizeof(mask) * 8) < 0) {
+    std::cerr << std::format("Couldn't prefer NUMA node {} for {}: {}\n", node,
+                             tag, std::strerror(errno));
+  }
+}
+
+/**
+ * @brief IRQ numbers used by a network interface
+ */
+static std::vector<int> interface_irqs(const std::string &interface) {
+  std::vector<int> irqs;
+  std::error_code ec;
+
+  // MSI(-X) vectors of the device backing the interface
+  std::filesystem::path msi =
+      std::format("/sys/class/net/{}/device/msi_irqs", interface);
+  for (auto &entry : std::filesystem::directory_iterator(msi, ec)) {
+    irqs.push_back(std::stoi(entry.path().filename()));
+  }
+  if (!irqs.empty())
+    return irqs;
+
+  // Legacy interrupts are named after the interface in /proc/interrupts
+  std::ifstream interrupts("/proc/interrupts");
+  std::string line;
+  while (std::getline(interrupts, line)) {
+    if (line.find(interface) == std::string::npos)
+      continue;
+    try {
+      irqs.push_back(std::stoi(line));
+    } catch (std::exception &) {
+    }
+  }
+  return irqs;
+}
+
+/**
+ * @brief Spread the IRQs of the interface round robin over the cpus
+ */
+static void steer_irqs(const std::vector<int> &cpus,
+                       const std::string &interface, const std::string &tag) {
+  std::vector<int> irqs = interface_irqs(interface);
+  if (irqs.empty()) {
+    std::cerr << std::format("No IRQs found for interface {} of {}\n",
+                             interface, tag);
+    return;
+  }
+
+  for (size_t i = 0; i < irqs.size(); ++i) {
+    std::string path = std::format("/proc/irq/{}/smp_affinity_list", irqs[i]);
+    std::ofstream affinity(path);
+    affinity << cpus[i % cpus.size()];
+    affinity.close();
+    if (!affinity) {
+      std::cerr << std::format("Couldn't steer IRQ {} of {} for {}\n", irqs[i],
+                               interface, tag);
+    }
+  }
+}
+
+bool apply_affinity(const AffinityConfig &config, const std::string &tag) {
+  if (!config.enabled())
+    return false;
+
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  for (int cpu : config.cpus)
+    CPU_SET(cpu, &set);
+
+  int err = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+  if (err != 0) {
+    std::cerr << std::format("Couldn't pin the thread of {}: {}\n", tag,
+                             std::strerror(err));
+    return false;
+  }
+
+  if (config.numa_local)
+    prefer_local_node(config.cpus, tag);
+
+  if (!config.irq_interface.empty())
+    steer_irqs(config.cpus, config.irq_interface, tag);
+
+  return true;
+}
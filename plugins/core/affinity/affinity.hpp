@@ -0,0 +1,42 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+/**
+ * @brief `affinity` block of a source
+ * @details For an input it applies to the service thread of the input.
+ */
+struct AffinityConfig {
+  /// CPUs the thread may run on. Empty leaves placement to the scheduler
+  std::vector<int> cpus;
+
+  /// Prefer memory from the NUMA node of `cpus` for the thread's buffers
+  bool numa_local = true;
+
+  /// Steer the IRQs of this network interface to `cpus`. Empty to leave the
+  /// IRQs alone, only one source may steer an interface
+  std::string irq_interface;
+
+  bool enabled() const { return !cpus.empty(); }
+};
+
+/**
+ * @brief Parse a Linux style cpu list, e.g. `0-3,8,10-11`
+ *
+ * @param[in] list The cpu list
+ * @return The cpus, throws `std::runtime_error` if malformed
+ */
+std::vector<int> parse_cpu_list(const std::string &list);
+
+/**
+ * @brief Place the calling thread according to `config`
+ * @note Call it first thing on the thread, memory allocated before won't
+ *       move
+ *
+ * @param[in] config Where to place the thread
+ * @param[in] tag Tag of the source the thread serves, used for logging
+ * @return True if the thread was pinned. NUMA and IRQ placement are best
+ *         effort and only logged on failure
+ */
+bool apply_affinity(const AffinityConfig &config, const std::string &tag);
@@ -0,0 +1,261 @@
+#include "aggregator.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <charconv>
+#include <cmath>
+#include <format>
+#include <functional>
+#include <stats/stats.hpp>
+
+/// Bucket `i > 0` of a sketch holds values in
+/// `(MIN_VALUE * GAMMA^(i-1), MIN_VALUE * GAMMA^i]`, bucket 0 the rest
+static constexpr double GAMMA = 1.04;
+static constexpr double MIN_VALUE = 1e-3;
+
+std::optional<AggregateField> AggregateField::parse(std::string_view spec) {
+  static constexpr std::pair<std::string_view, Kind> SYSLOG_FIELDS[] = {
+      {"hostname", Kind::Hostname}, {"app_name", Kind::AppName},
+      {"procid", Kind::ProcId},     {"msgid", Kind::MsgId},
+      {"severity", Kind::Severity}, {"facility", Kind::Facility}};
+
+  for (auto [name, kind] : SYSLOG_FIELDS) {
+    if (spec == name)
+      return AggregateField{kind, std::string(name)};
+  }
+
+  if (spec.starts_with("field:")) {
+    std::string_view number = spec.substr(6);
+    size_t index = 0;
+    auto [end, ec] =
+        std::from_chars(number.data(), number.data() + number.size(), index);
+    if (ec != std::errc() || end != number.data() + number.size() || index == 0)
+      return std::nullopt;
+    AggregateField field{Kind::Field, std::format("field{}", index)};
+    field.index = index;
+    return field;
+  }
+
+  if (spec.starts_with("kv:") && spec.size() > 3) {
+    AggregateField field{Kind::KeyValue, std::string(spec.substr(3))};
+    field.pattern = field.name + "=";
+    return field;
+  }
+
+  // The index is resolved against the `json_keys` of the input
+  if (spec.starts_with("json:") && spec.size() > 5)
+    return AggregateField{Kind::Json, std::string(spec.substr(5))};
+  return std::nullopt;
+}
+
+std::string_view AggregateField::extract(const Record &record,
+                                         std::string &scratch) const {
+  const SyslogRecord &syslog = record.syslog;
+  switch (kind) {
+  case Kind::Hostname:
+    return syslog.hostname;
+  case Kind::AppName:
+    return syslog.app_name;
+  case Kind::ProcId:
+    return syslog.procid;
+  case Kind::MsgId:
+    return syslog.msgid;
+  case Kind::Severity:
+  case Kind::Facility: {
+    int16_t number = kind == Kind::Severity ? syslog.severity : syslog.facility;
+    if (number < 0)
+      return {};
+    scratch = std::to_string(number);
+    return scratch;
+  }
+  case Kind::Field: {
+    std::string_view rest = record.raw;
+    for (size_t field = 1; field < index; ++field) {
+      size_t next = rest.find_first_not_of(' ', rest.find(' '));
+      if (next == std::string_view::npos)
+        return {};
+      rest.remove_prefix(next);
+    }
+    return rest.substr(0, rest.find_first_of(" \r\n"));
+  }
+  case Kind::KeyValue: {
+    // The name has to start a word, `xstatus=` is not `status=`
+    size_t at = 0;
+    while ((at = record.raw.find(pattern, at)) != std::string_view::npos) {
+      if (at == 0 || record.raw[at - 1] == ' ')
+        break;
+      at += pattern.size();
+    }
+    if (at == std::string_view::npos)
+      return {};
+    std::string_view value = record.raw.substr(at + pattern.size());
+    if (value.starts_with('"')) {
+      value.remove_prefix(1);
+      return value.substr(0, value.find('"'));
+    }
+    return value.substr(0, value.find_first_of(" \r\n"));
+  }
+  case Kind::Json:
+    return record.json.values[index];
+  }
+  return {};
+}
+
+Aggregator::Aggregator(const AggregateConfig &config, const std::string &tag)
+    : config(config), tag(tag),
+      table(std::bit_ceil(std::max<size_t>(config.max_groups, 1) * 2)),
+      mask(table.size() - 1),
+      buckets(config.value ? (config.max_groups + 1) * BUCKETS : 0),
+      records(StatsRegistry::instance().counter(
+          "dislog_aggregate_records_total", std::format("input=\"{}\"", tag))),
+      overflow_records(StatsRegistry::instance().counter(
+          "dislog_aggregate_overflow_records_total",
+          std::format("input=\"{}\"", tag))),
+      summaries(StatsRegistry::instance().counter(
+          "dislog_aggregate_summaries_total",
+          std::format("input=\"{}\"", tag))) {
+  constexpr std::string_view OVERFLOW_KEY = "overflow=true";
+  overflow.key_len = OVERFLOW_KEY.size();
+  std::copy(OVERFLOW_KEY.begin(), OVERFLOW_KEY.end(), overflow.key);
+  overflow.sketch = config.max_groups;
+  reset(Clock::now());
+}
+
+Aggregator::Group &Aggregator::find(std::string_view key, uint64_t hash) {
+  for (size_t slot = hash & mask;; slot = (slot + 1) & mask) {
+    Group &group = table[slot];
+    if (!group.used) {
+      // The table is twice `max_groups` so probing always ends here
+      if (groups == config.max_groups)
+        return overflow;
+      group.used = true;
+      group.hash = hash;
+      group.key_len = key.size();
+      std::copy(key.begin(), key.end(), group.key);
+      group.sketch = groups++;
+      return group;
+    }
+    if (group.hash == hash &&
+        std::string_view(group.key, group.key_len) == key)
+      return group;
+  }
+}
+
+void Aggregator::add(const Record &record) {
+  key_buf.clear();
+  for (const AggregateField &field : config.keys) {
+    std::string_view value = field.extract(record, scratch);
+    if (!key_buf.empty())
+      key_buf += ' ';
+    key_buf += field.name;
+    key_buf += '=';
+    key_buf += value.empty() ? "-" : value;
+  }
+  std::string_view key = std::string_view(key_buf).substr(0, KEY_MAX);
+
+  Group &group = find(key, std::hash<std::string_view>{}(key));
+  ++group.count;
+  records.fetch_add(1, std::memory_order_relaxed);
+  if (&group == &overflow)
+    overflow_records.fetch_add(1, std::memory_order_relaxed);
+
+  if (!config.value)
+    return;
+  std::string_view text = config.value->extract(record, scratch);
+  double value;
+  auto [end, ec] = std::from_chars(text.data(), text.data() + text.size(), value);
+  if (!text.empty() && ec == std::errc())
+    observe(group, value);
+}
+
+void Aggregator::observe(Group &group, double value) {
+  if (group.values == 0) {
+    group.min = value;
+    group.max = value;
+  } else {
+    group.min = std::min(group.min, value);
+    group.max = std::max(group.max, value);
+  }
+  ++group.values;
+  group.sum += value;
+
+  size_t bucket = 0;
+  if (value > MIN_VALUE) {
+    double index = std::ceil(std::log(value / MIN_VALUE) / std::log(GAMMA));
+    bucket = std::min<size_t>(static_cast<size_t>(index), BUCKETS - 1);
+  }
+  ++buckets[group.sketch * BUCKETS + bucket];
+}
+
+double Aggregator::quantile(const Group &group, double q) const {
+  uint64_t rank = static_cast<uint64_t>(q * (group.values - 1));
+  const uint32_t *sketch = &buckets[group.sketch * BUCKETS];
+  uint64_t seen = 0;
+  for (size_t bucket = 0; bucket < BUCKETS; ++bucket) {
+    seen += sketch[bucket];
+    if (seen > rank) {
+      if (bucket == 0)
+        return group.min;
+      // Middle of the bucket, the extremes are known exactly
+      double estimate =
+          MIN_VALUE * std::pow(GAMMA, bucket - 1) * (1 + GAMMA) / 2;
+      return std::clamp(estimate, group.min, group.max);
+    }
+  }
+  return group.max;
+}
+
+void Aggregator::summarize(const Group &group, std::string &out) {
+  if (group.count == 0)
+    return;
+
+  auto start = std::chrono::duration_cast<std::chrono::seconds>(
+      window_start.time_since_epoch());
+  out += std::format("dislog_aggregate input={} window_start={} window_ms={} ",
+                     tag, start.count(), config.window.count());
+  out.append(group.key, group.key_len);
+  out += std::format(" count={}", group.count);
+  if (group.values > 0) {
+    out += std::format(" sum={} min={} max={}", group.sum, group.min,
+                       group.max);
+    for (double q : config.quantiles)
+      out += std::format(" p{}={}", q * 100, quantile(group, q));
+  }
+  out += '\n';
+  summaries.fetch_add(1, std::memory_order_relaxed);
+}
+
+void Aggregator::reset(Clock::time_point now) {
+  for (Group &group : table) {
+    if (group.used && config.value)
+      std::fill_n(&buckets[group.sketch * BUCKETS], BUCKETS, 0);
+    group.used = false;
+    group.count = 0;
+    group.values = 0;
+    group.sum = 0;
+  }
+  if (config.value)
+    std::fill_n(&buckets[overflow.sketch * BUCKETS], BUCKETS, 0);
+  overflow.count = 0;
+  overflow.values = 0;
+  overflow.sum = 0;
+  groups = 0;
+
+  // Windows line up with the wall clock, e.g. on the minute
+  auto since_epoch = now.time_since_epoch();
+  window_start = Clock::time_point(since_epoch - since_epoch % config.window);
+  window_end = window_start + config.window;
+}
+
+int Aggregator::tick(Clock::time_point now, std::string &out) {
+  if (now >= window_end) {
+    for (const Group &group : table) {
+      if (group.used)
+        summarize(group, out);
+    }
+    summarize(overflow, out);
+    reset(now);
+  }
+  auto wait = std::chrono::ceil<std::chrono::milliseconds>(window_end - now);
+  return static_cast<int>(wait.count());
+}
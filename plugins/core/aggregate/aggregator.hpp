@@ -0,0 +1,178 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <pipeline/record.hpp>
+
+/**
+ * @brief Where the aggregation stage finds a key or value in a record
+ * @details Written in the config as `app_name` (or another syslog header
+ *          field, needs `"parse": "syslog"`), `field:N` for the Nth space
+ *          separated field of the record, `kv:name` for the value of a
+ *          `name=value` pair or `json:key` for one of the `json_keys` (needs
+ *          `"parse": "json"`).
+ */
+struct AggregateField {
+  enum class Kind { Hostname, AppName, ProcId, MsgId, Severity, Facility,
+                    Field, KeyValue, Json };
+
+  Kind kind;
+  /// Name of the key in the summary records
+  std::string name;
+  /// `name=` for `KeyValue`
+  std::string pattern;
+  /// 1 based field number for `Field`, position in `json_keys` for `Json`
+  size_t index = 0;
+
+  /**
+   * @brief Parse a field as written in the config
+   *
+   * @return Nothing if the spec is not valid
+   */
+  static std::optional<AggregateField> parse(std::string_view spec);
+
+  /**
+   * @brief Does the field need the syslog parse stage
+   */
+  bool needsSyslog() const { return kind < Kind::Field; }
+
+  /**
+   * @brief Does the field need the json parse stage
+   */
+  bool needsJson() const { return kind == Kind::Json; }
+
+  /**
+   * @brief Find the field in a record
+   *
+   * @param[in] record The record, with its parsed fields if any
+   * @param[out] scratch Holds the text of numeric syslog fields
+   * @return The value, empty if the record doesn't have it
+   */
+  std::string_view extract(const Record &record, std::string &scratch) const;
+};
+
+/**
+ * @brief `aggregate` block of an input source
+ */
+struct AggregateConfig {
+  bool enabled = false;
+
+  /// Summaries cover windows of this length, aligned to the wall clock
+  std::chrono::milliseconds window{60000};
+
+  /// Records are counted per distinct combination of these
+  std::vector<AggregateField> keys;
+
+  /// Numeric field whose distribution is summarized, if any
+  std::optional<AggregateField> value;
+
+  /// Quantiles of `value` reported per group
+  std::vector<double> quantiles{0.5, 0.9, 0.99};
+
+  /// Distinct groups tracked per window, the rest are counted as overflow
+  size_t max_groups = 1024;
+
+  /// Tag of the output the summaries are sent to
+  std::string output;
+
+  /// Don't forward the records which were aggregated
+  bool drop_raw = true;
+};
+
+/**
+ * @brief Turns records into per window counts and quantile summaries
+ * @details Groups live in a fixed size open addressed table and every group
+ *          has a fixed size log bucketed sketch of `value` (about 2% relative
+ *          error), so the memory used is set by `max_groups` alone. Once the
+ *          table is full, records of new groups go to a single overflow
+ *          group. At every window boundary each group becomes one summary
+ *          record and the table starts over.
+ * @note Not thread safe, owned by the service thread of the input
+ */
+class Aggregator {
+public:
+  using Clock = std::chrono::system_clock;
+
+  /**
+   * @brief Allocate the table and sketches and register the counters
+   *
+   * @param[in] config The `aggregate` block of the input
+   * @param[in] tag Tag of the input, used in summaries and as metric label
+   */
+  Aggregator(const AggregateConfig &config, const std::string &tag);
+
+  /**
+   * @brief Count a record in the current window
+   */
+  void add(const Record &record);
+
+  /**
+   * @brief Emit the summaries of the window once it is over
+   *
+   * @param[in] now Current time
+   * @param[out] out Summary records are appended to it
+   * @return Milliseconds until the current window is over
+   */
+  int tick(Clock::time_point now, std::string &out);
+
+  /**
+   * @brief Are aggregated records kept out of the raw stream
+   */
+  bool dropsRaw() const { return config.drop_raw; }
+
+private:
+  static constexpr size_t KEY_MAX = 128;
+  static constexpr size_t BUCKETS = 1024;
+
+  struct Group {
+    uint64_t hash = 0;
+    bool used = false;
+    uint16_t key_len = 0;
+    char key[KEY_MAX];
+    uint64_t count = 0;
+    /// Records which had a `value`
+    uint64_t values = 0;
+    double sum = 0;
+    double min = 0;
+    double max = 0;
+    /// Index of the group's sketch in `buckets`
+    size_t sketch = 0;
+  };
+
+  Group &find(std::string_view key, uint64_t hash);
+
+  void observe(Group &group, double value);
+
+  double quantile(const Group &group, double q) const;
+
+  void summarize(const Group &group, std::string &out);
+
+  void reset(Clock::time_point now);
+
+  AggregateConfig config;
+  std::string tag;
+
+  std::vector<Group> table;
+  size_t mask;
+  size_t groups = 0;
+  Group overflow;
+  /// `BUCKETS` counters per group plus the overflow group
+  std::vector<uint32_t> buckets;
+
+  Clock::time_point window_start;
+  Clock::time_point window_end;
+
+  /// Reused for every record so the steady state doesn't allocate
+  std::string key_buf;
+  std::string scratch;
+
+  std::atomic<uint64_t> &records;
+  std::atomic<uint64_t> &overflow_records;
+  std::atomic<uint64_t> &summaries;
+};
@@ -0,0 +1,61 @@
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <format>
+#include <iostream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "archive_index.hpp"
+
+/**
+ * @brief Print the records an archive received in a time range
+ * @details Usage: `archive_cat <dir> <prefix> <from_unix_s> <to_unix_s>`.
+ *          Segments are mapped and the index is used to skip to the start of
+ *          the range, the output may start up to `index_interval_bytes` early.
+ */
+int main(int argc, char **argv) {
+  if (argc != 5) {
+    std::cerr << "Usage: archive_cat <dir> <prefix> <from_unix_s> <to_unix_s>\n";
+    exit(EXIT_FAILURE);
+  }
+
+  std::string dir(argv[1]);
+  std::string prefix(argv[2]);
+  int64_t from_ns = std::atoll(argv[3]) * 1000000000;
+  int64_t to_ns = std::atoll(argv[4]) * 1000000000;
+
+  for (auto &segment :
+       ArchiveIndex::segmentsBetween(dir, prefix, from_ns, to_ns)) {
+    ArchiveIndex index(segment);
+    uint64_t begin = index.offsetFor(from_ns);
+    uint64_t end = UINT64_MAX;
+    for (auto &entry : index.entries()) {
+      if (entry.time_ns > to_ns) {
+        end = entry.offset;
+        break;
+      }
+    }
+
+    int fd = open(segment.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+      std::cerr << std::format("Couldn't open {}: {}\n", segment,
+                               std::strerror(errno));
+      continue;
+    }
+    struct stat st;
+    fstat(fd, &st);
+    end = std::min<uint64_t>(end, st.st_size);
+    if (begin < end) {
+      void *data = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+      if (data != MAP_FAILED) {
+        madvise(data, st.st_size, MADV_SEQUENTIAL);
+        std::cout.write(static_cast<const char *>(data) + begin, end - begin);
+        munmap(data, st.st_size);
+      }
+    }
+    close(fd);
+  }
+}
@@ -0,0 +1,83 @@
+#include "archive_index.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <filesystem>
+#include <format>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+ArchiveIndex::ArchiveIndex(const std::string &segment) {
+  std::string path = segment.substr(0, segment.rfind(".log")) + ".idx";
+  int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    throw std::runtime_error(
+        std::format("Couldn't open {}: {}", path, std::strerror(errno)));
+  }
+
+  struct stat st;
+  fstat(fd, &st);
+  // A torn last entry (writer crashed mid write) is ignored
+  map_size = st.st_size / sizeof(ArchiveIndexEntry) * sizeof(ArchiveIndexEntry);
+  if (map_size > 0) {
+    map = mmap(nullptr, map_size, PROT_READ, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED) {
+      close(fd);
+      throw std::runtime_error(
+          std::format("Couldn't map {}: {}", path, std::strerror(errno)));
+    }
+    index = std::span(static_cast<const ArchiveIndexEntry *>(map),
+                      map_size / sizeof(ArchiveIndexEntry));
+  }
+  close(fd);
+}
+
+ArchiveIndex::~ArchiveIndex() {
+  if (map != nullptr)
+    munmap(map, map_size);
+}
+
+uint64_t ArchiveIndex::offsetFor(int64_t time_ns) const {
+  // Last entry received before `time_ns`, data after it may be newer
+  auto after = std::upper_bound(
+      index.begin(), index.end(), time_ns,
+      [](int64_t time, const ArchiveIndexEntry &entry) {
+        return time <= entry.time_ns;
+      });
+  if (after == index.begin())
+    return 0;
+  return std::prev(after)->offset;
+}
+
+std::vector<std::string> ArchiveIndex::segmentsBetween(const std::string &dir,
+                                                       const std::string &prefix,
+                                                       int64_t from_ns,
+                                                       int64_t to_ns) {
+  // Segments are named after their start time
+  std::vector<std::pair<int64_t, std::string>> all;
+  std::error_code ec;
+  for (auto &entry : std::filesystem::directory_iterator(dir, ec)) {
+    std::string name = entry.path().filename();
+    if (!name.starts_with(prefix + "-") || !name.ends_with(".log"))
+      continue;
+    try {
+      int64_t start = std::stoll(name.substr(prefix.size() + 1));
+      all.emplace_back(start, entry.path());
+    } catch (std::exception &) {
+    }
+  }
+  std::sort(all.begin(), all.end());
+
+  std::vector<std::string> result;
+  for (size_t i = 0; i < all.size(); ++i) {
+    // A segment ends where the next one starts
+    int64_t end = i + 1 < all.size() ? all[i + 1].first : INT64_MAX;
+    if (all[i].first <= to_ns && end >= from_ns)
+      result.push_back(all[i].second);
+  }
+  return result;
+}
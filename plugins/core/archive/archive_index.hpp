@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "archive_writer.hpp"
+
+/**
+ * @brief Read only view of a segment's time index, mapped with `mmap`
+ */
+class ArchiveIndex {
+public:
+  /**
+   * @brief Map the index of a segment
+   * @note Throws `std::runtime_error` if it can't be mapped
+   *
+   * @param[in] segment Path of the `.log` segment
+   */
+  explicit ArchiveIndex(const std::string &segment);
+  ~ArchiveIndex();
+
+  ArchiveIndex(const ArchiveIndex &) = delete;
+  ArchiveIndex &operator=(const ArchiveIndex &) = delete;
+
+  /**
+   * @brief Where to start reading to see everything received at or after
+   *        `time_ns`
+   *
+   * @return Offset in the segment (0 if the segment starts later)
+   */
+  uint64_t offsetFor(int64_t time_ns) const;
+
+  std::span<const ArchiveIndexEntry> entries() const { return index; }
+
+  /**
+   * @brief Segments of an archive which may hold data in `[from_ns, to_ns]`
+   *
+   * @param[in] dir Directory of the archive
+   * @param[in] prefix Prefix of the segments
+   * @return Paths of the `.log` segments in time order
+   */
+  static std::vector<std::string> segmentsBetween(const std::string &dir,
+                                                  const std::string &prefix,
+                                                  int64_t from_ns,
+                                                  int64_t to_ns);
+
+private:
+  void *map = nullptr;
+  size_t map_size = 0;
+  std::span<const ArchiveIndexEntry> index;
+};
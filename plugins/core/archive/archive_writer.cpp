@@ -0,0 +1,230 @@
+#include "archive_writer.hpp"
+
+#include <affinity/affinity.hpp>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <filesystem>
+#include <format>
+#include <iostream>
+#include <stats/stats.hpp>
+#include <unistd.h>
+
+static constexpr size_t PAGE = 4096;
+
+/// Wait before trying again to open a segment which couldn't be opened
+static constexpr int64_t OPEN_RETRY_NS = 1000000000;
+
+static int64_t realtime_ns() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::system_clock::now().time_since_epoch())
+      .count();
+}
+
+static void *aligned_batch(size_t size) {
+  void *ptr = nullptr;
+  if (posix_memalign(&ptr, PAGE, size) != 0)
+    throw std::bad_alloc();
+  return ptr;
+}
+
+void ArchiveWriter::start(const FileSource &config) {
+  auto writer =
+      std::unique_ptr<ArchiveWriter>(new ArchiveWriter(config));
+  ArchiveWriter *raw = writer.get();
+  Output::add(config.tag, std::move(writer));
+  std::thread(&ArchiveWriter::run, raw).detach();
+}
+
+ArchiveWriter::ArchiveWriter(const FileSource &config)
+    : config(config), batch(nullptr, std::free),
+      bytes_written(StatsRegistry::instance().counter(
+          "dislog_archive_bytes_written_total",
+          std::format("output=\"{}\"", config.tag))),
+      segments(StatsRegistry::instance().counter(
+          "dislog_archive_segments_total",
+          std::format("output=\"{}\"", config.tag))),
+      dropped_bytes(StatsRegistry::instance().counter(
+          "dislog_archive_dropped_bytes_total",
+          std::format("output=\"{}\"", config.tag))) {
+  // Round the batch up to whole pages
+  this->config.write_batch_bytes =
+      (config.write_batch_bytes + PAGE - 1) / PAGE * PAGE;
+}
+
+void ArchiveWriter::append(std::string_view data) {
+  if (data.empty())
+    return;
+
+  MemoryGovernor &governor = MemoryGovernor::instance();
+  if (governor.pressure() == Pressure::Shed) {
+    dropped_bytes.fetch_add(data.size(), std::memory_order_relaxed);
+    governor.shed(data.size());
+    return;
+  }
+
+  std::lock_guard<std::mutex> guard(lock);
+  if (pending.size() + data.size() > config.max_pending_bytes) {
+    // The disk can't keep up, don't let the inputs stall
+    dropped_bytes.fetch_add(data.size(), std::memory_order_relaxed);
+    return;
+  }
+
+  pending_marks.emplace_back(pending.size(), realtime_ns());
+  pending.append(data);
+  pending_memory.set(pending.size());
+  if (pending.size() >= config.write_batch_bytes)
+    wakeup.notify_one();
+}
+
+void ArchiveWriter::rotate(int64_t now_ns) {
+  if (segment_fd >= 0) {
+    writeBatch();
+    // Give back what was preallocated but not used
+    if (ftruncate(segment_fd, segment_written) < 0) {
+      std::cerr << std::format("Couldn't trim segment of {}: {}\n", config.tag,
+                               std::strerror(errno));
+    }
+    fdatasync(segment_fd);
+    close(segment_fd);
+    close(index_fd);
+    segment_fd = index_fd = -1;
+  }
+
+  // A segment starts over even if it can't be opened, its data is dropped
+  segment_start_ns = now_ns;
+  segment_written = 0;
+  next_index_offset = 0;
+
+  std::string base =
+      std::format("{}/{}-{}", config.dir, config.prefix, now_ns);
+  segment_fd = open((base + ".log").c_str(),
+                    O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (segment_fd >= 0) {
+    index_fd = open((base + ".idx").c_str(),
+                    O_WRONLY | O_CREAT | O_TRUNC | O_APPEND | O_CLOEXEC, 0644);
+  }
+  if (segment_fd < 0 || index_fd < 0) {
+    std::cerr << std::format("Couldn't open segment {}: {}\n", base,
+                             std::strerror(errno));
+    if (segment_fd >= 0) {
+      close(segment_fd);
+      unlink((base + ".log").c_str());
+    }
+    segment_fd = index_fd = -1;
+    retry_ns = now_ns + OPEN_RETRY_NS;
+    return;
+  }
+
+  // Reserve the whole segment up front so it stays contiguous on disk,
+  // KEEP_SIZE so readers never see the unwritten tail
+  if (fallocate(segment_fd, FALLOC_FL_KEEP_SIZE, 0, config.segment_bytes) < 0 &&
+      errno != EOPNOTSUPP) {
+    std::cerr << std::format("Couldn't preallocate {}: {}\n", base,
+                             std::strerror(errno));
+  }
+  segments.fetch_add(1, std::memory_order_relaxed);
+}
+
+void ArchiveWriter::writeBatch() {
+  if (segment_fd < 0) {
+    // The segment couldn't be opened, `rotate` already complained
+    dropped_bytes.fetch_add(batch_used, std::memory_order_relaxed);
+    batch_used = 0;
+    return;
+  }
+
+  size_t done = 0;
+  while (done < batch_used) {
+    ssize_t ret = pwrite(segment_fd, batch.get() + done, batch_used - done,
+                         segment_written + done);
+    if (ret < 0) {
+      if (errno == EINTR)
+        continue;
+      std::cerr << std::format("Archive write failed for {}: {}\n", config.tag,
+                               std::strerror(errno));
+      dropped_bytes.fetch_add(batch_used - done, std::memory_order_relaxed);
+      break;
+    }
+    done += ret;
+  }
+  segment_written += done;
+  bytes_written.fetch_add(done, std::memory_order_relaxed);
+  batch_used = 0;
+}
+
+void ArchiveWriter::stage(std::string_view data) {
+  while (!data.empty()) {
+    size_t n = std::min(data.size(), config.write_batch_bytes - batch_used);
+    std::memcpy(batch.get() + batch_used, data.data(), n);
+    batch_used += n;
+    data.remove_prefix(n);
+    if (batch_used == config.write_batch_bytes)
+      writeBatch();
+  }
+}
+
+void ArchiveWriter::run() {
+  apply_affinity(config.affinity, config.tag);
+  batch.reset(static_cast<char *>(aligned_batch(config.write_batch_bytes)));
+
+  std::error_code ec;
+  std::filesystem::create_directories(config.dir, ec);
+
+  std::string data;
+  MemoryAccount data_memory;
+  std::vector<std::pair<size_t, int64_t>> marks;
+  auto flush_interval = std::chrono::milliseconds(config.flush_ms);
+
+  while (true) {
+    {
+      std::unique_lock<std::mutex> guard(lock);
+      wakeup.wait_for(guard, flush_interval, [&] {
+        return pending.size() >= config.write_batch_bytes;
+      });
+      data.swap(pending);
+      marks.swap(pending_marks);
+      pending_memory.set(0);
+    }
+    data_memory.set(data.size());
+
+    int64_t now_ns = realtime_ns();
+    for (size_t i = 0; i < marks.size(); ++i) {
+      auto [start, time_ns] = marks[i];
+      size_t end = i + 1 < marks.size() ? marks[i + 1].first : data.size();
+
+      // Only rotate between appends so a record isn't split across segments
+      int64_t age_ns = now_ns - segment_start_ns;
+      bool due =
+          segment_fd < 0
+              ? now_ns >= retry_ns
+              : segment_written + batch_used >= config.segment_bytes ||
+                    age_ns >= static_cast<int64_t>(config.segment_seconds) *
+                                  1000000000;
+      if (due)
+        rotate(now_ns);
+
+      uint64_t offset = segment_written + batch_used;
+      if (offset >= next_index_offset && index_fd >= 0) {
+        ArchiveIndexEntry entry{time_ns, offset};
+        if (::write(index_fd, &entry, sizeof(entry)) < 0) {
+          std::cerr << std::format("Archive index write failed for {}\n",
+                                   config.tag);
+        }
+        next_index_offset = offset + config.index_interval_bytes;
+      }
+
+      stage(std::string_view(data).substr(start, end - start));
+    }
+
+    // Nothing more arrived within `flush_ms`, write out the partial batch
+    if (data.size() < config.write_batch_bytes)
+      writeBatch();
+
+    data.clear();
+    data_memory.set(0);
+    marks.clear();
+  }
+}
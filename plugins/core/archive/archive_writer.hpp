@@ -0,0 +1,111 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <memory/memory_governor.hpp>
+#include <mutex>
+#include <output/output.hpp>
+#include <source/source.hpp>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <trace/trace_stamp.hpp>
+#include <vector>
+
+/**
+ * @brief One entry of a segment's time index (`{segment}.idx`)
+ * @details Entries are appended in time order, at most one every
+ *          `index_interval_bytes` of data. `offset` is where data received at
+ *          `time_ns` (CLOCK_REALTIME) starts in the segment.
+ */
+struct ArchiveIndexEntry {
+  int64_t time_ns;
+  uint64_t offset;
+};
+
+/**
+ * @brief Writes the data of a `FILE` output into rolling segment files
+ * @details Inputs only append to an in-memory queue. A dedicated writer
+ *          thread moves the queue into a batch buffer and writes it with
+ *          `pwrite` once full (or after `flush_ms`). Segments are
+ *          preallocated with `fallocate` and rotated by size and age. A
+ *          segment which can't be opened is retried once a second, its data
+ *          is dropped meanwhile.
+ */
+class ArchiveWriter : public Output {
+public:
+  /**
+   * @brief Create the writer of a `FILE` output, start its thread and
+   *        register it as the shared output of the tag
+   * @note Call before the services start, the registry isn't locked
+   *
+   * @param[in] config The output block
+   */
+  static void start(const FileSource &config);
+
+  /**
+   * @brief Queue data to be archived. Never blocks on disk I/O
+   *
+   * @param[in] data Data to append
+   */
+  void append(std::string_view data);
+
+  void send(int lane, const std::string &origin, uint32_t stream,
+            std::string_view data, const Trace *trace) override {
+    append(data);
+    // Counted as written once queued, the disk is not waited for
+    if (trace)
+      trace->latency->observe(trace->stamp, trace::monotonic_ns());
+  }
+
+private:
+  explicit ArchiveWriter(const FileSource &config);
+
+  /**
+   * @brief Body of the writer thread
+   */
+  void run();
+
+  /**
+   * @brief Close the current segment and open a new one
+   * @details On failure both files are closed and `retry_ns` set
+   */
+  void rotate(int64_t now_ns);
+
+  /**
+   * @brief Write the batch buffer out
+   */
+  void writeBatch();
+
+  /**
+   * @brief Copy data into the batch buffer, writing it out when full
+   */
+  void stage(std::string_view data);
+
+  FileSource config;
+
+  // Shared with the inputs
+  std::mutex lock;
+  std::condition_variable wakeup;
+  std::string pending;
+  MemoryAccount pending_memory;
+  /// (offset in `pending`, receive time) of every append
+  std::vector<std::pair<size_t, int64_t>> pending_marks;
+
+  // Owned by the writer thread
+  int segment_fd = -1;
+  int index_fd = -1;
+  int64_t segment_start_ns = 0;
+  uint64_t segment_written = 0;
+  uint64_t next_index_offset = 0;
+  /// No segment is open, when to try again
+  int64_t retry_ns = 0;
+  std::unique_ptr<char, void (*)(void *)> batch;
+  size_t batch_used = 0;
+
+  std::atomic<uint64_t> &bytes_written;
+  std::atomic<uint64_t> &segments;
+  std::atomic<uint64_t> &dropped_bytes;
+};
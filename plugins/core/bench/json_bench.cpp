@@ -0,0 +1,96 @@
+#include <chrono>
+#include <cstdlib>
+#include <format>
+#include <iostream>
+#include <nlohmann/json.hpp>
+#include <parse/json_extractor.hpp>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Time `fn` over every line, `iterations` times
+ *
+ * @return Seconds taken
+ */
+template <typename Fn>
+static double timeLines(const std::vector<std::string_view> &lines,
+                        size_t iterations, Fn fn) {
+  auto begin = std::chrono::steady_clock::now();
+  for (size_t it = 0; it < iterations; ++it) {
+    for (std::string_view line : lines)
+      fn(line);
+  }
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - begin;
+  return elapsed.count();
+}
+
+/**
+ * @brief Throughput of the json parse stage against a full nlohmann parse
+ * @details Usage: `json_bench [iterations]`. Both find the same keys in the
+ *          same lines, the checksums of the value lengths must agree.
+ */
+int main(int argc, char **argv) {
+  size_t iterations = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 20;
+
+  std::vector<std::string> templates = {
+      R"json({"ts":"2026-10-19T12:00:01.123Z","level":"info","service":"checkout","trace_id":"4bf92f3577b34da6a3ce929d0e0e4736","msg":"order placed","order":{"id":8812,"items":3,"total":"49.90"}})json"
+      "\n",
+      R"json({"time":1792411201,"level":"error","service":"payments","msg":"card declined: \"insufficient funds\"","err":{"code":"51","retryable":false},"trace_id":"0af7651916cd43dd8448eb211c80319c"})json"
+      "\n",
+      R"json({"level":"debug","msg":"cache lookup","service":"catalog","keys":["sku-1","sku-2","sku-3"],"hit_ratio":0.82,"latency_ms":0.41,"trace_id":"b7ad6b7169203331"})json"
+      "\n",
+      R"json({"@timestamp":"2026-10-19T12:00:02Z","log.level":"warn","service":"gateway","http":{"method":"GET","path":"/api/v1/items?page=2","status":429,"user_agent":"Mozilla/5.0 (X11; Linux x86_64)"},"msg":"rate limited"})json"
+      "\n",
+      "this line is not json at all and must pass through untouched\n",
+  };
+  std::vector<std::string> keys = {"level", "service", "trace_id"};
+
+  // A buffer of lines laid out back to back, like a receive buffer
+  std::string buffer;
+  std::vector<std::string_view> lines;
+  for (size_t i = 0; i < 4096; ++i)
+    buffer += templates[i % templates.size()];
+  for (size_t start = 0; start < buffer.size();) {
+    size_t end = buffer.find('\n', start) + 1;
+    lines.emplace_back(buffer.data() + start, end - start);
+    start = end;
+  }
+
+  JsonExtractor extractor(keys);
+  JsonFields fields;
+  size_t extractor_sum = 0;
+  double extractor_s = timeLines(lines, iterations, [&](std::string_view line) {
+    if (extractor.extract(line, fields)) {
+      for (size_t i = 0; i < keys.size(); ++i)
+        extractor_sum += fields.values[i].size();
+    }
+  });
+
+  size_t nlohmann_sum = 0;
+  double nlohmann_s = timeLines(lines, iterations, [&](std::string_view line) {
+    auto doc = nlohmann::json::parse(line, nullptr, false);
+    if (!doc.is_object())
+      return;
+    for (const std::string &key : keys) {
+      auto value = doc.find(key);
+      if (value == doc.end())
+        continue;
+      // Strings are compared by their raw length, none of them has escapes
+      nlohmann_sum += value->is_string() ? value->get_ref<const std::string &>().size()
+                                         : value->dump().size();
+    }
+  });
+
+  double total_lines = static_cast<double>(lines.size()) * iterations;
+  double total_bytes = static_cast<double>(buffer.size()) * iterations;
+  auto report = [&](std::string_view name, double seconds, size_t sum) {
+    std::cout << std::format("{}: {} Mlines/s, {} MB/s (checksum {})\n", name,
+                             total_lines / seconds / 1e6,
+                             total_bytes / seconds / 1e6, sum);
+  };
+  report("extractor", extractor_s, extractor_sum);
+  report("nlohmann ", nlohmann_s, nlohmann_sum);
+  std::cout << std::format("speedup: {}x\n", nlohmann_s / extractor_s);
+  return extractor_sum == nlohmann_sum ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,59 @@
+#include <chrono>
+#include <cstdlib>
+#include <format>
+#include <iostream>
+#include <parse/syslog_parser.hpp>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Throughput of the syslog parse stage on a mix of line formats
+ * @details Usage: `syslog_bench [iterations]`
+ */
+int main(int argc, char **argv) {
+  size_t iterations = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 200;
+
+  std::vector<std::string> templates = {
+      "<34>Oct 11 22:14:15 mymachine su[2211]: 'su root' failed for lonvick "
+      "on /dev/pts/8\n",
+      "Oct  9 07:01:22 web-03 nginx: 10.0.0.7 - - \"GET /healthz HTTP/1.1\" "
+      "200 2 \"-\" \"kube-probe/1.29\"\n",
+      "2026-10-19T12:00:01.123456+00:00 db-1 postgres[812]: LOG:  checkpoint "
+      "complete: wrote 1024 buffers\n",
+      "<165>1 2003-10-11T22:14:15.003Z mymachine.example.com evntslog - ID47 "
+      "[exampleSDID@32473 iut=\"3\" eventSource=\"Application\" "
+      "eventID=\"1011\"] An application event log entry...\n",
+      "<13>1 2026-10-19T12:00:02Z host app 42 - - plain message without "
+      "structured data\n",
+      "this line is not syslog at all and must pass through untouched\n",
+  };
+
+  // A buffer of lines laid out back to back, like a receive buffer
+  std::string buffer;
+  std::vector<std::string_view> lines;
+  for (size_t i = 0; i < 4096; ++i)
+    buffer += templates[i % templates.size()];
+  for (size_t start = 0; start < buffer.size();) {
+    size_t end = buffer.find('\n', start) + 1;
+    lines.emplace_back(buffer.data() + start, end - start);
+    start = end;
+  }
+
+  SyslogRecord record;
+  size_t valid = 0;
+  auto begin = std::chrono::steady_clock::now();
+  for (size_t it = 0; it < iterations; ++it) {
+    for (std::string_view line : lines) {
+      valid += parse_syslog(line, record);
+    }
+  }
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - begin;
+
+  double total_lines = static_cast<double>(lines.size()) * iterations;
+  double total_bytes = static_cast<double>(buffer.size()) * iterations;
+  std::cout << std::format("{} lines in {} s: {} Mlines/s, {} MB/s ({} valid)\n",
+                           total_lines, elapsed.count(),
+                           total_lines / elapsed.count() / 1e6,
+                           total_bytes / elapsed.count() / 1e6, valid);
+}
@@ -0,0 +1,119 @@
+#include <chrono>
+#include <cstdlib>
+#include <format>
+#include <iostream>
+#include <memory>
+#include <pipeline/pipeline.hpp>
+#include <poll.h>
+#include <source/source.hpp>
+#include <string>
+#include <thread>
+#include <transform/transform_pool.hpp>
+#include <vector>
+
+/**
+ * @brief Throughput of the parse and filter stages on 1 to N pool workers
+ * @details Usage: `transform_bench [iterations] [max workers]`. Batches of
+ *          4096 records are spread over 64 streams like reads of 64
+ *          connections, the stateful half of the pipeline runs on the
+ *          calling thread as it does on the service thread.
+ */
+int main(int argc, char **argv) {
+  size_t iterations = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 50;
+  size_t max_workers = argc > 2 ? std::strtoull(argv[2], nullptr, 10)
+                                : std::thread::hardware_concurrency();
+  constexpr uint32_t STREAMS = 64;
+  constexpr size_t BATCH = 4096;
+
+  std::vector<std::string> templates = {
+      "<34>Oct 11 22:14:15 mymachine su[2211]: 'su root' failed for lonvick "
+      "on /dev/pts/8\n",
+      "Oct  9 07:01:22 web-03 nginx: 10.0.0.7 - - \"GET /healthz HTTP/1.1\" "
+      "200 2 \"-\" \"kube-probe/1.29\"\n",
+      "2026-10-19T12:00:01.123456+00:00 db-1 postgres[812]: LOG:  checkpoint "
+      "complete: wrote 1024 buffers\n",
+      "<165>1 2003-10-11T22:14:15.003Z mymachine.example.com evntslog - ID47 "
+      "[exampleSDID@32473 iut=\"3\" eventSource=\"Application\" "
+      "eventID=\"1011\"] An application event log entry...\n",
+      "<13>1 2026-10-19T12:00:02Z host app 42 - - plain message without "
+      "structured data\n",
+      "this line is not syslog at all and must pass through untouched\n",
+  };
+
+  std::string buffer;
+  std::vector<std::string_view> lines;
+  for (size_t i = 0; i < BATCH; ++i)
+    buffer += templates[i % templates.size()];
+  for (size_t start = 0; start < buffer.size();) {
+    size_t end = buffer.find('\n', start) + 1;
+    lines.emplace_back(buffer.data() + start, end - start);
+    start = end;
+  }
+
+  UndefinedSource input;
+  input.tag = "bench";
+  input.parse = ParseFormat::Syslog;
+  input.filter.drop_if_contains = {"kube-probe", "not syslog at all"};
+
+  size_t batches = iterations * STREAMS;
+  double total_lines = static_cast<double>(lines.size()) * batches;
+  auto report = [&](std::string_view name, double seconds, size_t bytes) {
+    std::cout << std::format("{}: {} Mlines/s, {} MB/s out\n", name,
+                             total_lines / seconds / 1e6,
+                             bytes / seconds / 1e6);
+  };
+
+  // Everything on one thread, as with `transform_workers` 0
+  {
+    Pipeline pipeline(input);
+    std::string out;
+    size_t bytes = 0;
+    auto begin = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < batches; ++i) {
+      out.clear();
+      pipeline.run(lines, out);
+      bytes += out.size();
+    }
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - begin;
+    report("inline", elapsed.count(), bytes);
+  }
+
+  for (size_t workers = 1; workers <= max_workers; workers *= 2) {
+    Pipeline pipeline(input);
+    TransformPool pool(pipeline, workers, "bench");
+    std::vector<std::unique_ptr<TransformBatch>> done;
+    std::string out;
+    size_t bytes = 0;
+    size_t collected = 0;
+
+    auto drain = [&] {
+      pool.collect(done);
+      for (auto &batch : done) {
+        out.clear();
+        pipeline.finish(batch->prepared, out);
+        bytes += out.size();
+        pool.recycle(std::move(batch));
+      }
+      collected += done.size();
+      done.clear();
+    };
+
+    auto begin = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < batches; ++i) {
+      auto batch = pool.acquire();
+      batch->stream = i % STREAMS;
+      batch->add(lines);
+      pool.submit(std::move(batch));
+      drain();
+    }
+    while (collected < batches) {
+      pollfd ready{pool.eventFd(), POLLIN, 0};
+      poll(&ready, 1, 100);
+      drain();
+    }
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - begin;
+    report(std::format("{} workers", workers), elapsed.count(), bytes);
+  }
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+
+/**
+ * @brief File format of a traffic capture
+ * @details A capture is `MAGIC` followed by events, each an `EventHeader`
+ *          and, for `Data`, `length()` bytes exactly as they were read from
+ *          the client. Times are ns since the capture started, a
+ *          connection is identified by a number unique within the capture.
+ *          Shared by the core, which writes captures, and the replay tool.
+ */
+namespace capture {
+
+constexpr std::string_view MAGIC = "DLCAP001";
+
+enum class EventType : uint8_t { Open = 1, Data = 2, Close = 3 };
+
+/// `length()` fits in the low 24 bits of `info`
+constexpr uint32_t MAX_LENGTH = (1u << 24) - 1;
+
+struct EventHeader {
+  uint64_t time_ns;
+  uint32_t conn;
+  /// `type << 24 | length`
+  uint32_t info;
+
+  EventType type() const { return static_cast<EventType>(info >> 24); }
+  uint32_t length() const { return info & MAX_LENGTH; }
+
+  static EventHeader make(uint64_t time_ns, uint32_t conn, EventType type,
+                          uint32_t length) {
+    return {time_ns, conn, static_cast<uint32_t>(type) << 24 | length};
+  }
+};
+static_assert(sizeof(EventHeader) == 16);
+
+} // namespace capture
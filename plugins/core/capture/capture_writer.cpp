@@ -0,0 +1,153 @@
+#include "capture_writer.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <format>
+#include <iostream>
+#include <stdexcept>
+#include <trace/trace_stamp.hpp>
+#include <unistd.h>
+
+/// Events are written out in writes of about this size
+static constexpr size_t FLUSH_BYTES = 1 << 20;
+
+/// Events wait at most this long to be written out
+static constexpr int64_t FLUSH_NS = 1000000000;
+
+/// Full buffers which may wait for the disk
+static constexpr size_t MAX_PENDING = 8;
+
+CaptureWriter::CaptureWriter(const CaptureConfig &config)
+    : config(config), start_ns(trace::monotonic_ns()) {
+  fd = ::open(config.path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+              0640);
+  if (fd < 0) {
+    throw std::runtime_error(std::format("Couldn't create capture {}: {}",
+                                         config.path, std::strerror(errno)));
+  }
+  buf.reserve(FLUSH_BYTES);
+  buf.append(capture::MAGIC);
+  buffered_ns = start_ns;
+  writer = std::thread(&CaptureWriter::run, this);
+}
+
+CaptureWriter::~CaptureWriter() {
+  flush();
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    stopping = true;
+  }
+  wakeup.notify_one();
+  writer.join();
+  ::close(fd);
+}
+
+void CaptureWriter::open(uint32_t conn) {
+  event(conn, capture::EventType::Open, {});
+}
+
+void CaptureWriter::data(uint32_t conn, std::string_view bytes) {
+  // Reads are far below `MAX_LENGTH`, but don't corrupt the file if not
+  while (!bytes.empty()) {
+    std::string_view part = bytes.substr(0, capture::MAX_LENGTH);
+    event(conn, capture::EventType::Data, part);
+    bytes.remove_prefix(part.size());
+  }
+}
+
+void CaptureWriter::close(uint32_t conn) {
+  event(conn, capture::EventType::Close, {});
+}
+
+void CaptureWriter::event(uint32_t conn, capture::EventType type,
+                          std::string_view bytes) {
+  if (full || failed.load(std::memory_order_relaxed))
+    return;
+  size_t size = sizeof(capture::EventHeader) + bytes.size();
+  if (written + buf.size() + size > config.max_bytes) {
+    std::cerr << std::format("Capture {} reached {} bytes, stopped\n",
+                             config.path, config.max_bytes);
+    full = true;
+    return;
+  }
+
+  int64_t now_ns = trace::monotonic_ns();
+  if (buf.empty())
+    buffered_ns = now_ns;
+  auto header = capture::EventHeader::make(now_ns - start_ns, conn, type,
+                                           bytes.size());
+  buf.append(reinterpret_cast<const char *>(&header), sizeof(header));
+  buf.append(bytes);
+  if (buf.size() >= FLUSH_BYTES)
+    flush();
+}
+
+int CaptureWriter::tick() {
+  if (buf.empty())
+    return -1;
+  int64_t waited_ns = trace::monotonic_ns() - buffered_ns;
+  if (waited_ns >= FLUSH_NS) {
+    flush();
+    return -1;
+  }
+  return static_cast<int>((FLUSH_NS - waited_ns + 999999) / 1000000);
+}
+
+void CaptureWriter::flush() {
+  if (buf.empty())
+    return;
+
+  std::unique_lock<std::mutex> guard(lock);
+  if (pending.size() >= MAX_PENDING) {
+    guard.unlock();
+    std::cerr << std::format("Capture {} can't keep up with the input, "
+                             "stopped\n",
+                             config.path);
+    full = true;
+    buf.clear();
+    return;
+  }
+  written += buf.size();
+  pending.push_back(std::move(buf));
+  if (spare.empty()) {
+    buf = std::string();
+  } else {
+    buf = std::move(spare.back());
+    spare.pop_back();
+  }
+  guard.unlock();
+  wakeup.notify_one();
+  buf.clear();
+  buf.reserve(FLUSH_BYTES);
+}
+
+void CaptureWriter::run() {
+  std::unique_lock<std::mutex> guard(lock);
+  while (true) {
+    wakeup.wait(guard, [this] { return stopping || !pending.empty(); });
+    if (pending.empty())
+      return;
+    std::string out = std::move(pending.front());
+    pending.pop_front();
+    guard.unlock();
+
+    size_t done = 0;
+    while (!failed.load(std::memory_order_relaxed) && done < out.size()) {
+      ssize_t result = ::write(fd, out.data() + done, out.size() - done);
+      if (result < 0) {
+        if (errno == EINTR)
+          continue;
+        std::cerr << std::format("Capture {} write failed: {}\n",
+                                 config.path, std::strerror(errno));
+        failed.store(true, std::memory_order_relaxed);
+        break;
+      }
+      done += result;
+    }
+
+    out.clear();
+    guard.lock();
+    spare.push_back(std::move(out));
+  }
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <atomic>
+#include <capture/capture_format.hpp>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief Recording of what the clients of an input send
+ */
+struct CaptureConfig {
+  /// File the capture is written to, empty disables capturing
+  std::string path;
+
+  /// Capturing stops once the file is this big
+  uint64_t max_bytes = 1ull << 30;
+};
+
+/**
+ * @brief Writes the traffic of an input into a capture file
+ * @details See capture/capture_format.hpp for the format. Owned by the
+ *          service thread of the input. Events are gathered in a buffer
+ *          which is handed to the writer's own thread once it is full or a
+ *          second old, the data path only pays for a copy. If the disk falls
+ *          `MAX_PENDING` buffers behind, capturing stops rather than holding
+ *          up the input. Replay captures with the `replay` tool.
+ */
+class CaptureWriter {
+public:
+  /**
+   * @brief Create (or truncate) the capture file
+   * @throws std::runtime_error if the file can't be created
+   */
+  explicit CaptureWriter(const CaptureConfig &config);
+  ~CaptureWriter();
+
+  CaptureWriter(const CaptureWriter &) = delete;
+  CaptureWriter &operator=(const CaptureWriter &) = delete;
+
+  /**
+   * @brief A client connected, `conn` identifies it in later events
+   */
+  void open(uint32_t conn);
+
+  /**
+   * @brief Bytes read from a client
+   */
+  void data(uint32_t conn, std::string_view bytes);
+
+  /**
+   * @brief A client is gone
+   */
+  void close(uint32_t conn);
+
+  /**
+   * @brief Write out the buffered events if they have waited long enough
+   *
+   * @return Milliseconds until it should be called again, -1 if nothing is
+   *         buffered. Suitable as an `epoll_wait` timeout.
+   */
+  int tick();
+
+private:
+  void event(uint32_t conn, capture::EventType type, std::string_view bytes);
+
+  /**
+   * @brief Hand the buffered events to the writer thread
+   */
+  void flush();
+
+  /**
+   * @brief Body of the writer thread
+   */
+  void run();
+
+  CaptureConfig config;
+  int fd = -1;
+  int64_t start_ns;
+  /// Bytes handed to the writer thread
+  uint64_t written = 0;
+  bool full = false;
+  std::string buf;
+  /// When the first event in `buf` was added
+  int64_t buffered_ns = 0;
+
+  std::mutex lock;
+  std::condition_variable wakeup;
+  /// Full buffers, oldest first
+  std::deque<std::string> pending;
+  /// Written buffers, kept for reuse
+  std::vector<std::string> spare;
+  bool stopping = false;
+  /// Set by the writer thread when a write fails
+  std::atomic<bool> failed{false};
+  std::thread writer;
+};
@@ -0,0 +1,162 @@
+#include <cstdlib>
+#include <cstring>
+#include <format>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "columnar_format.hpp"
+
+using namespace columnar;
+
+namespace {
+
+/// Values of one column, one per row, as text
+using Values = std::vector<std::string>;
+
+bool decodeDeltas(std::string_view data, uint32_t rows, Values &values) {
+  size_t bitmap = (rows + 7) / 8;
+  if (data.size() < bitmap)
+    return false;
+  std::string_view valid = data.substr(0, bitmap);
+  data.remove_prefix(bitmap);
+  int64_t previous = 0;
+  for (uint32_t i = 0; i < rows; ++i) {
+    uint64_t delta;
+    if (!get_varint(data, delta))
+      return false;
+    if (valid[i / 8] & (1 << (i % 8))) {
+      previous += unzigzag(delta);
+      values.push_back(std::to_string(previous));
+    } else {
+      values.push_back("-");
+    }
+  }
+  return true;
+}
+
+bool decodeDictionary(std::string_view data, uint32_t rows, Values &values) {
+  uint64_t count;
+  if (!get_varint(data, count))
+    return false;
+  std::vector<std::string_view> dictionary;
+  for (uint64_t i = 0; i < count; ++i) {
+    uint64_t size;
+    if (!get_varint(data, size) || size > data.size())
+      return false;
+    dictionary.push_back(data.substr(0, size));
+    data.remove_prefix(size);
+  }
+  for (uint32_t i = 0; i < rows; ++i) {
+    uint64_t index;
+    if (!get_varint(data, index) || index >= dictionary.size())
+      return false;
+    values.emplace_back(dictionary[index]);
+  }
+  return true;
+}
+
+bool decodeStrings(std::string_view data, uint32_t rows, Values &values) {
+  std::vector<uint64_t> sizes(rows);
+  for (uint64_t &size : sizes) {
+    if (!get_varint(data, size))
+      return false;
+  }
+  for (uint64_t size : sizes) {
+    if (size > data.size())
+      return false;
+    values.emplace_back(data.substr(0, size));
+    data.remove_prefix(size);
+  }
+  return true;
+}
+
+bool decodeColumn(Encoding encoding, std::string_view data, uint32_t rows,
+                  Values &values) {
+  switch (encoding) {
+  case Encoding::DeltaVarint:
+    return decodeDeltas(data, rows, values);
+  case Encoding::Int8:
+    if (data.size() != rows)
+      return false;
+    for (char value : data)
+      values.push_back(std::to_string(static_cast<int8_t>(value)));
+    return true;
+  case Encoding::Dictionary:
+    return decodeDictionary(data, rows, values);
+  case Encoding::String:
+    return decodeStrings(data, rows, values);
+  }
+  return false;
+}
+
+} // namespace
+
+/**
+ * @brief Print the records of a `columnar` output stream as text
+ * @details Usage: `columnar_cat < stream`. Prints one tab separated line per
+ *          record: timestamp in microseconds, version, facility, severity,
+ *          hostname, app name, msgid, procid, structured data, message and
+ *          the timestamp text where the microseconds aren't exact (BSD or
+ *          unreadable timestamps). Missing values print as `-` or empty.
+ */
+int main() {
+  std::string stream((std::istreambuf_iterator<char>(std::cin)),
+                     std::istreambuf_iterator<char>());
+  std::string_view in(stream);
+  std::vector<Values> columns(static_cast<size_t>(Column::RawTimestamp) + 1);
+
+  while (in.size() >= sizeof(FrameHeader)) {
+    FrameHeader frame;
+    std::memcpy(&frame, in.data(), sizeof(frame));
+    if (std::memcmp(frame.magic, MAGIC, sizeof(MAGIC)) != 0 ||
+        frame.bytes < sizeof(frame) || frame.bytes > in.size()) {
+      std::cerr << "Not a columnar frame, stopping\n";
+      exit(EXIT_FAILURE);
+    }
+    std::string_view body = in.substr(sizeof(frame), frame.bytes - sizeof(frame));
+    in.remove_prefix(frame.bytes);
+
+    for (Values &values : columns)
+      values.clear();
+    for (uint16_t i = 0; i < frame.columns; ++i) {
+      ColumnHeader header;
+      if (body.size() < sizeof(header)) {
+        std::cerr << "Truncated column header\n";
+        exit(EXIT_FAILURE);
+      }
+      std::memcpy(&header, body.data(), sizeof(header));
+      body.remove_prefix(sizeof(header));
+      if (header.bytes > body.size()) {
+        std::cerr << "Truncated column\n";
+        exit(EXIT_FAILURE);
+      }
+      std::string_view data = body.substr(0, header.bytes);
+      body.remove_prefix(header.bytes);
+
+      // Columns from newer writers are skipped
+      size_t id = static_cast<size_t>(header.column);
+      if (id == 0 || id >= columns.size())
+        continue;
+      if (!decodeColumn(header.encoding, data, frame.rows, columns[id])) {
+        std::cerr << std::format("Bad column {}\n", id);
+        exit(EXIT_FAILURE);
+      }
+    }
+
+    for (uint32_t row = 0; row < frame.rows; ++row) {
+      std::string line;
+      for (size_t id = 1; id < columns.size(); ++id) {
+        if (id > 1)
+          line += '\t';
+        if (row < columns[id].size())
+          line += columns[id][row];
+      }
+      line += '\n';
+      std::cout << line;
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,252 @@
+#include "columnar_encoder.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <cstddef>
+#include <ctime>
+
+using namespace columnar;
+
+namespace {
+
+bool number(std::string_view text, size_t at, size_t size, int &value) {
+  if (at + size > text.size())
+    return false;
+  const char *begin = text.data() + at;
+  auto [end, ec] = std::from_chars(begin, begin + size, value);
+  return ec == std::errc() && end == begin + size;
+}
+
+int64_t epoch_micros(int year, int month, int day, int hour, int minute,
+                     int second) {
+  using namespace std::chrono;
+  sys_days date = std::chrono::year(year) / month / day;
+  auto time = date + hours(hour) + minutes(minute) + seconds(second);
+  return duration_cast<microseconds>(time.time_since_epoch()).count();
+}
+
+/// Microseconds since the epoch of a local time, resolving DST with the zone
+int64_t local_epoch_micros(int year, int month, int day, int hour, int minute,
+                           int second) {
+  struct tm local{};
+  local.tm_year = year - 1900;
+  local.tm_mon = month - 1;
+  local.tm_mday = day;
+  local.tm_hour = hour;
+  local.tm_min = minute;
+  local.tm_sec = second;
+  local.tm_isdst = -1;
+  return static_cast<int64_t>(mktime(&local)) * 1000000;
+}
+
+/// Text of the field, the whole line without its newline for non syslog
+std::string_view message(std::string_view line, const SyslogRecord &row) {
+  if (row.valid)
+    return row.msg;
+  while (line.ends_with('\n') || line.ends_with('\r'))
+    line.remove_suffix(1);
+  return line;
+}
+
+} // namespace
+
+bool ColumnarEncoder::parseTimestamp(std::string_view timestamp,
+                                     std::chrono::system_clock::time_point now,
+                                     int64_t &micros, bool &exact) {
+  int year, month, day, hour, minute, second;
+  exact = true;
+
+  // RFC 3339, `2026-10-19T12:00:01.123456+02:00`
+  if (timestamp.size() >= 20 && timestamp[4] == '-' && timestamp[10] == 'T') {
+    if (!number(timestamp, 0, 4, year) || !number(timestamp, 5, 2, month) ||
+        !number(timestamp, 8, 2, day) || !number(timestamp, 11, 2, hour) ||
+        !number(timestamp, 14, 2, minute) || !number(timestamp, 17, 2, second))
+      return false;
+    micros = epoch_micros(year, month, day, hour, minute, second);
+
+    size_t at = 19;
+    if (at < timestamp.size() && timestamp[at] == '.') {
+      int64_t fraction = 0;
+      int digits = 0;
+      for (++at; at < timestamp.size() && timestamp[at] >= '0' &&
+                 timestamp[at] <= '9';
+           ++at) {
+        if (digits++ < 6)
+          fraction = fraction * 10 + (timestamp[at] - '0');
+      }
+      for (; digits < 6; ++digits)
+        fraction *= 10;
+      micros += fraction;
+    }
+
+    std::string_view zone = timestamp.substr(std::min(at, timestamp.size()));
+    if (zone == "Z")
+      return true;
+    int zone_hours, zone_minutes;
+    if (zone.size() != 6 || (zone[0] != '+' && zone[0] != '-') ||
+        !number(zone, 1, 2, zone_hours) || !number(zone, 4, 2, zone_minutes))
+      return false;
+    int64_t offset = (zone_hours * 60 + zone_minutes) * 60 * 1000000LL;
+    micros -= zone[0] == '+' ? offset : -offset;
+    return true;
+  }
+
+  // BSD, `Oct  9 07:01:22`
+  static constexpr std::string_view MONTHS = "JanFebMarAprMayJunJulAugSepOctNovDec";
+  if (timestamp.size() != 15)
+    return false;
+  size_t name = MONTHS.find(timestamp.substr(0, 3));
+  if (name == std::string_view::npos || name % 3 != 0)
+    return false;
+  month = static_cast<int>(name / 3) + 1;
+  std::string_view day_text = timestamp.substr(4, 2);
+  if (day_text[0] == ' ')
+    day_text.remove_prefix(1);
+  if (!number(day_text, 0, day_text.size(), day) ||
+      !number(timestamp, 7, 2, hour) || !number(timestamp, 10, 2, minute) ||
+      !number(timestamp, 13, 2, second))
+    return false;
+
+  using namespace std::chrono;
+  year = static_cast<int>(
+      year_month_day(floor<days>(now)).year());
+  micros = local_epoch_micros(year, month, day, hour, minute, second);
+  int64_t limit =
+      duration_cast<microseconds>((now + hours(24)).time_since_epoch())
+          .count();
+  if (micros > limit)
+    micros = local_epoch_micros(year - 1, month, day, hour, minute, second);
+  exact = false;
+  return true;
+}
+
+void ColumnarEncoder::Dictionary::clear() {
+  index.clear();
+  values.clear();
+  rows.clear();
+}
+
+void ColumnarEncoder::Dictionary::add(std::string_view value) {
+  auto [entry, added] = index.try_emplace(value, values.size());
+  if (added)
+    values.push_back(value);
+  rows.push_back(entry->second);
+}
+
+void ColumnarEncoder::Dictionary::write(std::string &out) const {
+  put_varint(out, values.size());
+  for (std::string_view value : values) {
+    put_varint(out, value.size());
+    out += value;
+  }
+  for (uint32_t row : rows)
+    put_varint(out, row);
+}
+
+void ColumnarEncoder::putColumn(std::string &out, Column column,
+                                Encoding encoding, std::string_view data) {
+  ColumnHeader header{column, encoding, 0, static_cast<uint32_t>(data.size())};
+  out.append(reinterpret_cast<const char *>(&header), sizeof(header));
+  out += data;
+}
+
+void ColumnarEncoder::encode(std::string_view records, std::string &out) {
+  lines.clear();
+  rows.clear();
+  while (!records.empty()) {
+    size_t newline = records.find('\n');
+    std::string_view line =
+        newline == std::string_view::npos ? records
+                                          : records.substr(0, newline + 1);
+    records.remove_prefix(line.size());
+    lines.push_back(line);
+    rows.emplace_back();
+    parse_syslog(line, rows.back());
+  }
+
+  size_t frame_start = out.size();
+  FrameHeader header{};
+  std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+  header.rows = static_cast<uint32_t>(rows.size());
+  header.columns = 11;
+  out.append(reinterpret_cast<const char *>(&header), sizeof(header));
+
+  // Timestamps, deltas against the previous valid one
+  auto now = std::chrono::system_clock::now();
+  column.assign((rows.size() + 7) / 8, '\0');
+  deltas.clear();
+  inexact.assign(rows.size(), false);
+  int64_t previous = 0;
+  for (size_t i = 0; i < rows.size(); ++i) {
+    int64_t micros;
+    bool exact;
+    if (rows[i].valid &&
+        parseTimestamp(rows[i].timestamp, now, micros, exact)) {
+      column[i / 8] |= static_cast<char>(1 << (i % 8));
+      put_varint(deltas, zigzag(micros - previous));
+      previous = micros;
+      inexact[i] = !exact;
+    } else {
+      put_varint(deltas, 0);
+      inexact[i] = rows[i].valid;
+    }
+  }
+  column += deltas;
+  putColumn(out, Column::Timestamp, Encoding::DeltaVarint, column);
+
+  column.clear();
+  for (const SyslogRecord &row : rows)
+    column += static_cast<char>(row.valid ? row.version : NOT_SYSLOG);
+  putColumn(out, Column::Version, Encoding::Int8, column);
+
+  column.clear();
+  for (const SyslogRecord &row : rows)
+    column += static_cast<char>(row.valid ? row.facility : -1);
+  putColumn(out, Column::Facility, Encoding::Int8, column);
+
+  column.clear();
+  for (const SyslogRecord &row : rows)
+    column += static_cast<char>(row.valid ? row.severity : -1);
+  putColumn(out, Column::Severity, Encoding::Int8, column);
+
+  auto putDictionary = [&](Column id, std::string_view SyslogRecord::*field) {
+    dictionary.clear();
+    for (const SyslogRecord &row : rows)
+      dictionary.add(row.valid ? row.*field : std::string_view());
+    column.clear();
+    dictionary.write(column);
+    putColumn(out, id, Encoding::Dictionary, column);
+  };
+  putDictionary(Column::Hostname, &SyslogRecord::hostname);
+  putDictionary(Column::AppName, &SyslogRecord::app_name);
+  putDictionary(Column::MsgId, &SyslogRecord::msgid);
+
+  auto putStrings = [&](Column id, auto value) {
+    column.clear();
+    for (size_t i = 0; i < rows.size(); ++i)
+      put_varint(column, value(i).size());
+    for (size_t i = 0; i < rows.size(); ++i)
+      column += value(i);
+    putColumn(out, id, Encoding::String, column);
+  };
+  putStrings(Column::ProcId, [&](size_t i) {
+    return rows[i].valid ? rows[i].procid : std::string_view();
+  });
+  putStrings(Column::StructuredData, [&](size_t i) {
+    return rows[i].valid ? rows[i].structured_data : std::string_view();
+  });
+  putStrings(Column::Message,
+             [&](size_t i) { return message(lines[i], rows[i]); });
+
+  // BSD stamps repeat within a second, a dictionary keeps them small
+  dictionary.clear();
+  for (size_t i = 0; i < rows.size(); ++i)
+    dictionary.add(inexact[i] ? rows[i].timestamp : std::string_view());
+  column.clear();
+  dictionary.write(column);
+  putColumn(out, Column::RawTimestamp, Encoding::Dictionary, column);
+
+  uint32_t bytes = static_cast<uint32_t>(out.size() - frame_start);
+  std::memcpy(out.data() + frame_start + offsetof(FrameHeader, bytes), &bytes,
+              sizeof(bytes));
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include <columnar/columnar_format.hpp>
+#include <parse/syslog_parser.hpp>
+
+/**
+ * @brief Turns batches of newline separated records into columnar frames
+ * @details Every record is parsed as syslog and its header fields are laid
+ *          out column by column, see `columnar_format.hpp`. Timestamps are
+ *          delta encoded and the fields which repeat a lot (hosts, app names,
+ *          msgids) dictionary encoded, which is where most of the size goes
+ *          compared to text. The dictionaries are per frame so a consumer
+ *          can start reading at any frame.
+ * @note Not thread safe, owned by the writer thread of an output
+ */
+class ColumnarEncoder {
+public:
+  /**
+   * @brief Encode a batch of whole records as one frame
+   *
+   * @param[in] records Records, each ending with `\n`
+   * @param[out] out The frame is appended to it
+   */
+  void encode(std::string_view records, std::string &out);
+
+  /**
+   * @brief Microseconds since the epoch of a syslog timestamp
+   * @details RFC 3339 timestamps carry their offset, BSD ones are taken as
+   *          local time in the year which puts them at most a day after `now`
+   *
+   * @param[out] exact False for BSD timestamps, whose zone is a guess
+   * @return False if the timestamp can't be read
+   */
+  static bool parseTimestamp(std::string_view timestamp,
+                             std::chrono::system_clock::time_point now,
+                             int64_t &micros, bool &exact);
+
+private:
+  class Dictionary {
+  public:
+    void clear();
+    void add(std::string_view value);
+    void write(std::string &out) const;
+
+  private:
+    std::unordered_map<std::string_view, uint32_t> index;
+    std::vector<std::string_view> values;
+    std::vector<uint32_t> rows;
+  };
+
+  /**
+   * @brief Append a column, its header first
+   */
+  static void putColumn(std::string &out, columnar::Column column,
+                        columnar::Encoding encoding, std::string_view data);
+
+  /// Reused for every frame so the steady state doesn't allocate
+  std::vector<std::string_view> lines;
+  std::vector<SyslogRecord> rows;
+  Dictionary dictionary;
+  std::string column;
+  std::string deltas;
+  /// Rows whose timestamp goes in `RawTimestamp`
+  std::vector<bool> inexact;
+};
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+/**
+ * @brief Wire format of the `columnar` output format
+ * @details The stream is a sequence of frames. A frame is a `FrameHeader`
+ *          followed by `columns` columns, each a `ColumnHeader` and `bytes`
+ *          bytes of data holding one value for each of the `rows` records.
+ *          Integers are little endian. Encodings:
+ *
+ *          - `DeltaVarint`: a validity bitmap of `(rows + 7) / 8` bytes (bit
+ *            `i % 8` of byte `i / 8` set if row `i` has a value), then for
+ *            every row the zigzag varint difference to the previous valid
+ *            value (starting from 0). Rows without a value hold 0.
+ *          - `Int8`: one signed byte per row.
+ *          - `Dictionary`: a varint count of distinct values, each a varint
+ *            length and the bytes, then a varint index per row.
+ *          - `String`: a varint length per row, then all values back to back.
+ *
+ *          Records which aren't syslog have `Version` `NOT_SYSLOG`, the whole
+ *          line in `Message` and the other columns empty. A syslog timestamp
+ *          which couldn't be read, or a BSD one (no zone, taken as the core's
+ *          local time), is kept as text in `RawTimestamp` so the original is
+ *          never lost. Shared by the core,
+ *          which writes frames, and `columnar_cat`, which reads them.
+ */
+namespace columnar {
+
+constexpr char MAGIC[4] = {'D', 'L', 'C', '1'};
+
+enum class Column : uint8_t {
+  /// Microseconds since the epoch, `DeltaVarint`
+  Timestamp = 1,
+  /// RFC 5424 version, 0 for BSD lines, `Int8`
+  Version = 2,
+  /// -1 when the line has no `<PRI>`, `Int8`
+  Facility = 3,
+  Severity = 4,
+  /// `Dictionary`
+  Hostname = 5,
+  AppName = 6,
+  MsgId = 7,
+  /// `String`
+  ProcId = 8,
+  StructuredData = 9,
+  Message = 10,
+  /// Timestamp text where `Timestamp` isn't exact, else empty. `Dictionary`
+  RawTimestamp = 11,
+};
+
+enum class Encoding : uint8_t {
+  DeltaVarint = 1,
+  Int8 = 2,
+  Dictionary = 3,
+  String = 4,
+};
+
+constexpr int8_t NOT_SYSLOG = -1;
+
+struct FrameHeader {
+  char magic[4];
+  /// Of the whole frame, this header included
+  uint32_t bytes;
+  uint32_t rows;
+  uint16_t columns;
+  uint16_t reserved;
+};
+static_assert(sizeof(FrameHeader) == 16);
+
+struct ColumnHeader {
+  Column column;
+  Encoding encoding;
+  uint16_t reserved;
+  uint32_t bytes;
+};
+static_assert(sizeof(ColumnHeader) == 8);
+
+inline void put_varint(std::string &out, uint64_t value) {
+  while (value >= 0x80) {
+    out += static_cast<char>(value | 0x80);
+    value >>= 7;
+  }
+  out += static_cast<char>(value);
+}
+
+/**
+ * @brief Read a varint, advancing `in`
+ * @return False if `in` ends in the middle of it
+ */
+inline bool get_varint(std::string_view &in, uint64_t &value) {
+  value = 0;
+  for (int shift = 0; shift < 64 && !in.empty(); shift += 7) {
+    uint8_t byte = in.front();
+    in.remove_prefix(1);
+    value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+    if (!(byte & 0x80))
+      return true;
+  }
+  return false;
+}
+
+inline uint64_t zigzag(int64_t value) {
+  return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+}
+
+inline int64_t unzigzag(uint64_t value) {
+  return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+}
+
+} // namespace columnar
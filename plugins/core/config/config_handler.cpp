@@ -1,4 +1,6 @@
 #include "config_handler.hpp"
+#include <algorithm>
+#include <climits>
 #include <format>
 #include <fstream>
 #include <iostream>
@@ -7,6 +9,7 @@
 #include <source/source.hpp>
 #include <stdexcept>
 #include <string>
+#include <unistd.h>
 
 ConfigHandler::ConfigHandler(std::string filePath) {
   std::ifstream configStream(filePath);
@@ -73,6 +76,7 @@ std::vector<Source *> ConfigHandler::getSourceFromInputs() {
       }
 
       unix_src.output = outputs;
+      parseInputOptions(source, unix_src);
 
       result.emplace_back(unix_src.clone());
     } else if (comm_type == Source::IPV4_STRING) {
@@ -104,7 +108,68 @@ std::vector<Source *> ConfigHandler::getSourceFromInputs() {
       }
 
       ipv4source.output = outputs;
+      parseInputOptions(source, ipv4source);
       result.emplace_back(ipv4source.clone());
+    } else if (comm_type == Source::SHM_STRING) {
+      ShmSource shm_source = ShmSource(source);
+      shm_source.isInput = true;
+
+      if (sawTag.contains(shm_source.tag)) {
+        throw std::runtime_error(
+            std::format("Duplicate tags {}", shm_source.tag));
+      } else {
+        sawTag.insert(shm_source.tag);
+      }
+
+      if (!source.contains("output_to") || !source["output_to"].is_array()) {
+        throw std::runtime_error(
+            std::format("Output is not well defined for {}", shm_source.tag));
+      }
+
+      std::vector<std::string> outputs;
+      for (auto &outs : source["output_to"]) {
+        if (outs.is_string()) {
+          outputs.push_back(outs);
+        } else {
+          std::cerr << std::format(
+              "Skipping invalid out config due to type mismatch for {}",
+              shm_source.tag);
+        }
+      }
+
+      shm_source.output = outputs;
+      parseInputOptions(source, shm_source);
+      result.emplace_back(shm_source.clone());
+    } else if (comm_type == Source::RELAY_STRING) {
+      RelaySource relay_source = RelaySource(source);
+      relay_source.isInput = true;
+
+      if (sawTag.contains(relay_source.tag)) {
+        throw std::runtime_error(
+            std::format("Duplicate tags {}", relay_source.tag));
+      } else {
+        sawTag.insert(relay_source.tag);
+      }
+
+      if (!source.contains("output_to") || !source["output_to"].is_array()) {
+        throw std::runtime_error(
+            std::format("Output is not well defined for {}", relay_source.tag));
+      }
+
+      std::vector<std::string> outputs;
+      for (auto &outs : source["output_to"]) {
+        if (outs.is_string()) {
+          outputs.push_back(outs);
+        } else {
+          std::cerr << std::format(
+              "Skipping invalid out config due to type mismatch for {}",
+              relay_source.tag);
+        }
+      }
+
+      relay_source.output = outputs;
+      parseInputOptions(source, relay_source);
+      result.emplace_back(relay_source.clone());
     } else {
       result.push_back(UndefinedSource().clone());
     }
@@ -143,6 +208,7 @@ std::vector<Source *> ConfigHandler::getSourceForOutputs() {
       } else {
         sawTag.insert(unix_src.tag);
       }
+      parseOutputOptions(source, unix_src);
       result.emplace_back(unix_src.clone());
     } else if (comm_type == Source::IPV4_STRING) {
       IPv4Source ipv4_source = IPv4Source(source);
@@ -153,7 +219,30 @@ std::vector<Source *> ConfigHandler::getSourceForOutputs() {
       } else {
         sawTag.insert(ipv4_source.tag);
       }
+      parseOutputOptions(source, ipv4_source);
       result.emplace_back(ipv4_source.clone());
+    } else if (comm_type == Source::FILE_STRING) {
+      FileSource file_source = FileSource(source);
+      file_source.isOutput = true;
+      if (sawTag.contains(file_source.tag)) {
+        throw std::runtime_error(
+            std::format("Duplicate tags {}\n", file_source.tag));
+      } else {
+        sawTag.insert(file_source.tag);
+      }
+      parseOutputOptions(source, file_source);
+      result.emplace_back(file_source.clone());
+    } else if (comm_type == Source::RELAY_STRING) {
+      RelaySource relay_source = RelaySource(source);
+      relay_source.isOutput = true;
+      if (sawTag.contains(relay_source.tag)) {
+        throw std::runtime_error(
+            std::format("Duplicate tags {}\n", relay_source.tag));
+      } else {
+        sawTag.insert(relay_source.tag);
+      }
+      parseOutputOptions(source, relay_source);
+      result.emplace_back(relay_source.clone());
     } else {
       std::cout << std::format("Undefined {}\n", COMM_TYPE);
       // result.push_back(UndefinedSource());
@@ -161,3 +250,775 @@ std::vector<Source *> ConfigHandler::getSourceForOutputs() {
   }
   return result;
 }
+
+void ConfigHandler::parseInputOptions(json &sourceBlock, Source &source) {
+  std::string_view RATE_LIMIT = "rate_limit";
+  if (sourceBlock.contains(RATE_LIMIT)) {
+    source.rate_limit = parseRateLimit(sourceBlock[RATE_LIMIT], source.tag);
+  }
+
+  std::string_view DROP_IF_CONTAINS = "drop_if_contains";
+  if (sourceBlock.contains(DROP_IF_CONTAINS)) {
+    source.filter.drop_if_contains = parsePatterns(
+        sourceBlock[DROP_IF_CONTAINS], DROP_IF_CONTAINS, source.tag);
+  }
+
+  std::string_view KEEP_IF_CONTAINS = "keep_if_contains";
+  if (sourceBlock.contains(KEEP_IF_CONTAINS)) {
+    source.filter.keep_if_contains = parsePatterns(
+        sourceBlock[KEEP_IF_CONTAINS], KEEP_IF_CONTAINS, source.tag);
+  }
+
+  std::string_view PARSE = "parse";
+  if (sourceBlock.contains(PARSE)) {
+    if (!sourceBlock[PARSE].is_string()) {
+      throw std::runtime_error(
+          std::format("parse is not a string for {}", source.tag));
+    }
+    std::string parse = sourceBlock[PARSE].get<std::string>();
+    if (parse == "syslog") {
+      source.parse = ParseFormat::Syslog;
+    } else if (parse == "json") {
+      source.parse = ParseFormat::Json;
+    } else if (parse != "none") {
+      throw std::runtime_error(
+          std::format("Unknown parse format {} for {}", parse, source.tag));
+    }
+  }
+
+  std::string_view JSON_KEYS = "json_keys";
+  if (sourceBlock.contains(JSON_KEYS)) {
+    source.json_keys =
+        parsePatterns(sourceBlock[JSON_KEYS], JSON_KEYS, source.tag);
+  }
+  if (source.parse == ParseFormat::Json &&
+      (source.json_keys.empty() ||
+       source.json_keys.size() > JsonFields::MAX_KEYS)) {
+    throw std::runtime_error(
+        std::format("\"parse\": \"json\" needs 1 to {} json_keys for {}",
+                    JsonFields::MAX_KEYS, source.tag));
+  }
+  if (source.parse != ParseFormat::Json && !source.json_keys.empty()) {
+    throw std::runtime_error(std::format(
+        "json_keys needs \"parse\": \"json\" for {}", source.tag));
+  }
+
+  std::string_view CAPTURE = "capture";
+  if (sourceBlock.contains(CAPTURE)) {
+    source.capture = parseCapture(sourceBlock[CAPTURE], source.tag);
+  }
+
+  std::string_view TRANSFORM_PLUGINS = "transform_plugins";
+  if (sourceBlock.contains(TRANSFORM_PLUGINS)) {
+    if (!sourceBlock[TRANSFORM_PLUGINS].is_array()) {
+      throw std::runtime_error(std::format("{} is not a list for {}",
+                                           TRANSFORM_PLUGINS, source.tag));
+    }
+    for (auto &block : sourceBlock[TRANSFORM_PLUGINS]) {
+      source.transform_plugins.push_back(
+          parseTransformPlugin(block, source.tag));
+    }
+  }
+
+  std::string_view AGGREGATE = "aggregate";
+  if (sourceBlock.contains(AGGREGATE)) {
+    source.aggregate =
+        parseAggregate(sourceBlock[AGGREGATE], source.tag, source.parse,
+                       source.json_keys);
+  }
+
+  std::string_view DEDUP = "dedup";
+  if (sourceBlock.contains(DEDUP)) {
+    source.dedup = parseDedup(sourceBlock[DEDUP], source.tag);
+  }
+
+  std::string_view AFFINITY = "affinity";
+  if (sourceBlock.contains(AFFINITY)) {
+    source.affinity = parseAffinity(sourceBlock[AFFINITY], source.tag);
+  }
+
+  std::string_view SOCKET = "socket";
+  if (sourceBlock.contains(SOCKET)) {
+    source.socket_options = parseSocketOptions(sourceBlock[SOCKET], source.tag);
+  }
+
+  std::string_view BUSY_POLL = "busy_poll";
+  if (sourceBlock.contains(BUSY_POLL)) {
+    source.busy_poll = parseBusyPoll(sourceBlock[BUSY_POLL], source.tag);
+  }
+
+  std::string_view READ_BUDGET = "read_budget_bytes";
+  if (sourceBlock.contains(READ_BUDGET)) {
+    if (!sourceBlock[READ_BUDGET].is_number_unsigned() ||
+        sourceBlock[READ_BUDGET].get<size_t>() == 0) {
+      throw std::runtime_error(std::format(
+          "{} is not a positive integer for {}", READ_BUDGET, source.tag));
+    }
+    source.read_budget = sourceBlock[READ_BUDGET].get<size_t>();
+  }
+
+  std::string_view TRANSFORM_WORKERS = "transform_workers";
+  if (sourceBlock.contains(TRANSFORM_WORKERS)) {
+    if (!sourceBlock[TRANSFORM_WORKERS].is_number_unsigned() ||
+        sourceBlock[TRANSFORM_WORKERS].get<size_t>() > 256) {
+      throw std::runtime_error(
+          std::format("{} is not an integer in [0, 256] for {}",
+                      TRANSFORM_WORKERS, source.tag));
+    }
+    source.transform_workers = sourceBlock[TRANSFORM_WORKERS].get<size_t>();
+  }
+
+  std::string_view PRIORITY = "priority";
+  if (sourceBlock.contains(PRIORITY)) {
+    if (!sourceBlock[PRIORITY].is_number_unsigned() ||
+        sourceBlock[PRIORITY].get<uint32_t>() == 0 ||
+        sourceBlock[PRIORITY].get<uint32_t>() > 1000) {
+      throw std::runtime_error(std::format(
+          "{} is not an integer in [1, 1000] for {}", PRIORITY, source.tag));
+    }
+    source.priority = sourceBlock[PRIORITY].get<uint32_t>();
+  }
+}
+
+void ConfigHandler::parseOutputOptions(json &sourceBlock, Source &source) {
+  std::string_view LANE_QUEUE_BYTES = "lane_queue_bytes";
+  if (sourceBlock.contains(LANE_QUEUE_BYTES)) {
+    if (!sourceBlock[LANE_QUEUE_BYTES].is_number_unsigned() ||
+        sourceBlock[LANE_QUEUE_BYTES].get<uint64_t>() == 0) {
+      throw std::runtime_error(std::format(
+          "{} is not a positive integer for {}", LANE_QUEUE_BYTES, source.tag));
+    }
+    source.lane_queue_bytes = sourceBlock[LANE_QUEUE_BYTES].get<uint64_t>();
+  }
+
+  std::string_view KEEP_TRACE_STAMPS = "keep_trace_stamps";
+  if (sourceBlock.contains(KEEP_TRACE_STAMPS)) {
+    if (!sourceBlock[KEEP_TRACE_STAMPS].is_boolean()) {
+      throw std::runtime_error(std::format("{} is not a boolean for {}",
+                                           KEEP_TRACE_STAMPS, source.tag));
+    }
+    source.keep_trace_stamps = sourceBlock[KEEP_TRACE_STAMPS].get<bool>();
+  }
+
+  std::string_view SOCKET = "socket";
+  if (sourceBlock.contains(SOCKET)) {
+    source.socket_options = parseSocketOptions(sourceBlock[SOCKET], source.tag);
+  }
+
+  std::string_view FORMAT = "format";
+  if (sourceBlock.contains(FORMAT)) {
+    if (!sourceBlock[FORMAT].is_string()) {
+      throw std::runtime_error(
+          std::format("{} is not a string for {}", FORMAT, source.tag));
+    }
+    std::string format = sourceBlock[FORMAT].get<std::string>();
+    if (format == "columnar") {
+      if (dynamic_cast<FileSource *>(&source) ||
+          dynamic_cast<RelaySource *>(&source)) {
+        throw std::runtime_error(std::format(
+            "Columnar format needs a UNIX_SOCK or IPv4 output for {}",
+            source.tag));
+      }
+      source.format = OutputFormat::Columnar;
+    } else if (format != "text") {
+      throw std::runtime_error(
+          std::format("Unknown format {} for {}", format, source.tag));
+    }
+  }
+
+  std::string_view METADATA_HEADER = "metadata_header";
+  if (sourceBlock.contains(METADATA_HEADER)) {
+    if (!sourceBlock[METADATA_HEADER].is_boolean()) {
+      throw std::runtime_error(std::format("{} is not a boolean for {}",
+                                           METADATA_HEADER, source.tag));
+    }
+    source.metadata_header = sourceBlock[METADATA_HEADER].get<bool>();
+    if (source.metadata_header &&
+        (dynamic_cast<FileSource *>(&source) ||
+         dynamic_cast<RelaySource *>(&source) ||
+         source.format == OutputFormat::Columnar)) {
+      throw std::runtime_error(std::format(
+          "{} needs a UNIX_SOCK or IPv4 output in text format for {}",
+          METADATA_HEADER, source.tag));
+    }
+  }
+
+  std::string_view PERSISTENT_QUEUES = "persistent_queues";
+  if (sourceBlock.contains(PERSISTENT_QUEUES)) {
+    if (!sourceBlock[PERSISTENT_QUEUES].is_boolean()) {
+      throw std::runtime_error(std::format("{} is not a boolean for {}",
+                                           PERSISTENT_QUEUES, source.tag));
+    }
+    source.persistent_queues = sourceBlock[PERSISTENT_QUEUES].get<bool>();
+    if (source.persistent_queues && (dynamic_cast<FileSource *>(&source) ||
+                                     dynamic_cast<RelaySource *>(&source))) {
+      throw std::runtime_error(
+          std::format("{} needs a UNIX_SOCK or IPv4 output for {}",
+                      PERSISTENT_QUEUES, source.tag));
+    }
+  }
+
+  // Every output has its own writer thread
+  std::string_view AFFINITY = "affinity";
+  if (sourceBlock.contains(AFFINITY)) {
+    source.affinity = parseAffinity(sourceBlock[AFFINITY], source.tag);
+  }
+}
+
+SocketOptions ConfigHandler::parseSocketOptions(json &block,
+                                                const std::string &tag) {
+  if (!block.is_object()) {
+    throw std::runtime_error(std::format("socket is not an object for {}", tag));
+  }
+
+  auto unsignedField = [&](std::string_view key, uint32_t max) {
+    if (!block[key].is_number_unsigned() || block[key].get<uint64_t>() > max) {
+      throw std::runtime_error(std::format(
+          "socket.{} is not an integer in [0, {}] for {}", key, max, tag));
+    }
+    return block[key].get<uint32_t>();
+  };
+  auto booleanField = [&](std::string_view key) {
+    if (!block[key].is_boolean()) {
+      throw std::runtime_error(
+          std::format("socket.{} is not a boolean for {}", key, tag));
+    }
+    return block[key].get<bool>();
+  };
+
+  // The kernel doubles the buffer sizes and caps them at its own limits
+  constexpr uint32_t MAX_BUFFER = 1U << 30;
+  constexpr uint32_t MAX_KEEPALIVE = 32767;
+
+  SocketOptions options;
+  if (block.contains("send_buffer_bytes"))
+    options.send_buffer_bytes = unsignedField("send_buffer_bytes", MAX_BUFFER);
+  if (block.contains("receive_buffer_bytes")) {
+    options.receive_buffer_bytes =
+        unsignedField("receive_buffer_bytes", MAX_BUFFER);
+  }
+  if (block.contains("tcp_nodelay"))
+    options.tcp_nodelay = booleanField("tcp_nodelay");
+  if (block.contains("tcp_cork"))
+    options.tcp_cork = booleanField("tcp_cork");
+  if (block.contains("keepalive"))
+    options.keepalive = booleanField("keepalive");
+  if (block.contains("keepalive_idle_s")) {
+    options.keepalive_idle_s = unsignedField("keepalive_idle_s", MAX_KEEPALIVE);
+  }
+  if (block.contains("keepalive_interval_s")) {
+    options.keepalive_interval_s =
+        unsignedField("keepalive_interval_s", MAX_KEEPALIVE);
+  }
+  if (block.contains("keepalive_count"))
+    options.keepalive_count = unsignedField("keepalive_count", 127);
+  if (block.contains("zerocopy"))
+    options.zerocopy = booleanField("zerocopy");
+  if (block.contains("zerocopy_min_bytes")) {
+    options.zerocopy_min_bytes =
+        unsignedField("zerocopy_min_bytes", MAX_BUFFER);
+  }
+  return options;
+}
+
+BusyPollConfig ConfigHandler::parseBusyPoll(json &block,
+                                            const std::string &tag) {
+  if (!block.is_object()) {
+    throw std::runtime_error(
+        std::format("busy_poll is not an object for {}", tag));
+  }
+
+  auto unsignedField = [&](std::string_view key, uint32_t max) {
+    if (!block[key].is_number_unsigned() || block[key].get<uint64_t>() > max) {
+      throw std::runtime_error(std::format(
+          "busy_poll.{} is not an integer in [0, {}] for {}", key, max, tag));
+    }
+    return block[key].get<uint32_t>();
+  };
+
+  BusyPollConfig config;
+  config.enabled = true;
+  if (block.contains("spin_us"))
+    config.spin = std::chrono::microseconds(unsignedField("spin_us", 1000000));
+  if (block.contains("socket_busy_poll_us"))
+    config.socket_busy_poll_us = unsignedField("socket_busy_poll_us", 1000000);
+  if (block.contains("socket_budget"))
+    config.socket_budget = unsignedField("socket_budget", 65535);
+  if (block.contains("prefer_busy_poll")) {
+    if (!block["prefer_busy_poll"].is_boolean()) {
+      throw std::runtime_error(std::format(
+          "busy_poll.prefer_busy_poll is not a boolean for {}", tag));
+    }
+    config.prefer_busy_poll = block["prefer_busy_poll"].get<bool>();
+  }
+  return config;
+}
+
+AffinityConfig ConfigHandler::parseAffinity(json &block,
+                                            const std::string &tag) {
+  if (!block.is_object()) {
+    throw std::runtime_error(
+        std::format("affinity is not an object for {}", tag));
+  }
+
+  AffinityConfig config;
+  if (!block.contains("cpus") || !block["cpus"].is_string()) {
+    throw std::runtime_error(
+        std::format("affinity.cpus is not a cpu list for {}", tag));
+  }
+  config.cpus = parse_cpu_list(block["cpus"].get<std::string>());
+
+  if (block.contains("numa_local")) {
+    if (!block["numa_local"].is_boolean()) {
+      throw std::runtime_error(
+          std::format("affinity.numa_local is not a boolean for {}", tag));
+    }
+    config.numa_local = block["numa_local"].get<bool>();
+  }
+
+  if (block.contains("irq_interface")) {
+    if (!block["irq_interface"].is_string()) {
+      throw std::runtime_error(
+          std::format("affinity.irq_interface is not a string for {}", tag));
+    }
+    config.irq_interface = block["irq_interface"].get<std::string>();
+    // Each source would steer the IRQs to its own cpus, the last one wins
+    auto [steered, added] = irq_steered.try_emplace(config.irq_interface, tag);
+    if (!added && steered->second != tag) {
+      throw std::runtime_error(std::format(
+          "affinity.irq_interface {} of {} is already steered by {}",
+          config.irq_interface, tag, steered->second));
+    }
+  }
+  return config;
+}
+
+CaptureConfig ConfigHandler::parseCapture(json &block,
+                                          const std::string &tag) {
+  if (!block.is_object()) {
+    throw std::runtime_error(
+        std::format("capture is not an object for {}", tag));
+  }
+
+  CaptureConfig config;
+  if (!block.contains("path") || !block["path"].is_string()) {
+    throw std::runtime_error(
+        std::format("capture.path is not defined for {}", tag));
+  }
+  config.path = block["path"].get<std::string>();
+
+  if (block.contains("max_bytes")) {
+    if (!block["max_bytes"].is_number_unsigned()) {
+      throw std::runtime_error(
+          std::format("capture.max_bytes is not a positive number for {}", tag));
+    }
+    config.max_bytes = block["max_bytes"].get<uint64_t>();
+  }
+  return config;
+}
+
+TransformPluginConfig ConfigHandler::parseTransformPlugin(json &block,
+                                                        const std::string &tag) {
+  if (!block.is_object()) {
+    throw std::runtime_error(
+        std::format("transform_plugins entry is not an object for {}", tag));
+  }
+
+  TransformPluginConfig config;
+  if (!block.contains("path") || !block["path"].is_string()) {
+    throw std::runtime_error(
+        std::format("transform_plugins.path is not a string for {}", tag));
+  }
+  config.path = block["path"].get<std::string>();
+
+  // Handed over as text, the plugin parses its own config
+  if (block.contains("config"))
+    config.config = block["config"].dump();
+
+  if (block.contains("routes")) {
+    if (!block["routes"].is_array()) {
+      throw std::runtime_error(std::format(
+          "transform_plugins.routes is not a list of output tags for {}",
+          tag));
+    }
+    for (auto &route : block["routes"]) {
+      if (!route.is_string()) {
+        throw std::runtime_error(std::format(
+            "transform_plugins.routes is not a list of output tags for {}",
+            tag));
+      }
+      config.routes.push_back(route.get<std::string>());
+    }
+  }
+  return config;
+}
+
+AggregateConfig ConfigHandler::parseAggregate(json &block,
+                                              const std::string &tag,
+                                              ParseFormat parse,
+                                              const std::vector<std::string> &json_keys) {
+  if (!block.is_object()) {
+    throw std::runtime_error(
+        std::format("aggregate is not an object for {}", tag));
+  }
+
+  auto parseField = [&](const json &spec, std::string_view key) {
+    std::optional<AggregateField> field;
+    if (spec.is_string())
+      field = AggregateField::parse(spec.get<std::string>());
+    if (!field) {
+      throw std::runtime_error(std::format(
+          "aggregate.{} is not a syslog field, field:N, kv:name or json:key "
+          "for {}",
+          key,
+          tag));
+    }
+    if (field->needsSyslog() && parse != ParseFormat::Syslog) {
+      throw std::runtime_error(std::format(
+          "aggregate.{} {} needs \"parse\": \"syslog\" for {}", key,
+          field->name, tag));
+    }
+    if (field->needsJson()) {
+      auto found =
+          std::find(json_keys.begin(), json_keys.end(), field->name);
+      if (found == json_keys.end()) {
+        throw std::runtime_error(std::format(
+            "aggregate.{} json:{} is not one of the json_keys for {}", key,
+            field->name, tag));
+      }
+      field->index = found - json_keys.begin();
+    }
+    return *field;
+  };
+
+  AggregateConfig config;
+  config.enabled = true;
+
+  if (!block.contains("keys") || !block["keys"].is_array() ||
+      block["keys"].empty()) {
+    throw std::runtime_error(
+        std::format("aggregate.keys is not a list of fields for {}", tag));
+  }
+  for (auto &spec : block["keys"])
+    config.keys.push_back(parseField(spec, "keys"));
+
+  if (block.contains("value"))
+    config.value = parseField(block["value"], "value");
+
+  if (!block.contains("output") || !block["output"].is_string()) {
+    throw std::runtime_error(
+        std::format("aggregate.output is not an output tag for {}", tag));
+  }
+  config.output = block["output"].get<std::string>();
+
+  if (block.contains("window_ms")) {
+    if (!block["window_ms"].is_number_unsigned() ||
+        block["window_ms"].get<uint64_t>() == 0) {
+      throw std::runtime_error(std::format(
+          "aggregate.window_ms is not a positive integer for {}", tag));
+    }
+    config.window = std::chrono::milliseconds(block["window_ms"].get<uint64_t>());
+  }
+
+  if (block.contains("max_groups")) {
+    if (!block["max_groups"].is_number_unsigned() ||
+        block["max_groups"].get<uint64_t>() == 0) {
+      throw std::runtime_error(std::format(
+          "aggregate.max_groups is not a positive integer for {}", tag));
+    }
+    config.max_groups = block["max_groups"].get<uint64_t>();
+  }
+
+  if (block.contains("quantiles")) {
+    if (!block["quantiles"].is_array()) {
+      throw std::runtime_error(
+          std::format("aggregate.quantiles is not a list for {}", tag));
+    }
+    config.quantiles.clear();
+    for (auto &q : block["quantiles"]) {
+      if (!q.is_number() || q.get<double>() < 0 || q.get<double>() > 1) {
+        throw std::runtime_error(std::format(
+            "aggregate.quantiles has a value outside [0, 1] for {}", tag));
+      }
+      config.quantiles.push_back(q.get<double>());
+    }
+  }
+
+  if (block.contains("drop_raw")) {
+    if (!block["drop_raw"].is_boolean()) {
+      throw std::runtime_error(
+          std::format("aggregate.drop_raw is not a boolean for {}", tag));
+    }
+    config.drop_raw = block["drop_raw"].get<bool>();
+  }
+  return config;
+}
+
+DedupConfig ConfigHandler::parseDedup(json &block, const std::string &tag) {
+  if (!block.is_object()) {
+    throw std::runtime_error(std::format("dedup is not an object for {}", tag));
+  }
+
+  auto parseCount = [&](std::string_view key, uint64_t fallback) {
+    if (!block.contains(key))
+      return fallback;
+    if (!block[key].is_number_unsigned()) {
+      throw std::runtime_error(std::format(
+          "dedup.{} is not a positive integer for {}", key, tag));
+    }
+    return block[key].get<uint64_t>();
+  };
+
+  DedupConfig config;
+  config.enabled = true;
+  config.window = std::chrono::milliseconds(
+      parseCount("window_ms", config.window.count()));
+  config.table_size = parseCount("table_size", config.table_size);
+  config.ignore_prefix_bytes =
+      parseCount("ignore_prefix_bytes", config.ignore_prefix_bytes);
+  config.ignore_prefix_fields =
+      parseCount("ignore_prefix_fields", config.ignore_prefix_fields);
+
+  if (config.window.count() == 0 || config.table_size == 0) {
+    throw std::runtime_error(std::format(
+        "dedup.window_ms and dedup.table_size must be non zero for {}", tag));
+  }
+  return config;
+}
+
+std::vector<std::string> ConfigHandler::parsePatterns(json &block,
+                                                      std::string_view key,
+                                                      const std::string &tag) {
+  if (!block.is_array()) {
+    throw std::runtime_error(std::format("{} is not an array for {}", key, tag));
+  }
+
+  std::vector<std::string> patterns;
+  for (auto &pattern : block) {
+    if (!pattern.is_string() || pattern.get<std::string>().empty()) {
+      throw std::runtime_error(
+          std::format("{} has an empty or non string pattern for {}", key, tag));
+    }
+    patterns.push_back(pattern.get<std::string>());
+  }
+  return patterns;
+}
+
+RateLimitConfig ConfigHandler::parseRateLimit(json &block,
+                                              const std::string &tag) {
+  if (!block.is_object()) {
+    throw std::runtime_error(
+        std::format("rate_limit is not an object for {}", tag));
+  }
+
+  auto parseRates = [&](std::string_view scope) {
+    BucketRates rates;
+    if (!block.contains(scope))
+      return rates;
+
+    auto &rates_j = block[scope];
+    for (auto [key, value] :
+         {std::pair{"bytes_per_sec", &rates.bytes_per_sec},
+          std::pair{"records_per_sec", &rates.records_per_sec}}) {
+      if (!rates_j.contains(key))
+        continue;
+      if (!rates_j[key].is_number() || rates_j[key].get<double>() < 0) {
+        throw std::runtime_error(std::format(
+            "rate_limit.{}.{} is not a positive number for {}", scope, key,
+            tag));
+      }
+      *value = rates_j[key].get<double>();
+    }
+    return rates;
+  };
+
+  RateLimitConfig config;
+  config.enabled = true;
+  config.input = parseRates("input");
+  config.client = parseRates("client");
+
+  if (block.contains("burst_seconds")) {
+    if (!block["burst_seconds"].is_number() ||
+        block["burst_seconds"].get<double>() <= 0) {
+      throw std::runtime_error(std::format(
+          "rate_limit.burst_seconds is not a positive number for {}", tag));
+    }
+    config.burst_seconds = block["burst_seconds"].get<double>();
+  }
+
+  if (block.contains("policy")) {
+    if (!block["policy"].is_string()) {
+      throw std::runtime_error(
+          std::format("rate_limit.policy is not a string for {}", tag));
+    }
+    std::string policy = block["policy"].get<std::string>();
+    if (policy == "delay") {
+      config.policy = OverLimitPolicy::Delay;
+    } else if (policy == "drop") {
+      config.policy = OverLimitPolicy::Drop;
+    } else if (policy == "sample") {
+      config.policy = OverLimitPolicy::Sample;
+    } else {
+      throw std::runtime_error(
+          std::format("Unknown rate_limit.policy {} for {}", policy, tag));
+    }
+  }
+
+  if (block.contains("sample_n")) {
+    if (!block["sample_n"].is_number_unsigned() ||
+        block["sample_n"].get<uint32_t>() == 0) {
+      throw std::runtime_error(std::format(
+          "rate_limit.sample_n is not a positive integer for {}", tag));
+    }
+    config.sample_n = block["sample_n"].get<uint32_t>();
+  }
+
+  return config;
+}
+
+StatsConfig ConfigHandler::getStatsConfig() {
+  std::string_view STATS = "stats";
+  StatsConfig config;
+  if (!configData.contains(STATS)) {
+    return config;
+  }
+
+  auto &stats_j = configData[STATS];
+  if (!stats_j.contains("path") || !stats_j["path"].is_string()) {
+    throw std::runtime_error("stats.path is not defined");
+  }
+  config.path = stats_j["path"].get<std::string>();
+
+  if (stats_j.contains("interval_ms")) {
+    if (!stats_j["interval_ms"].is_number_unsigned() ||
+        stats_j["interval_ms"].get<uint64_t>() == 0) {
+      throw std::runtime_error("stats.interval_ms is not a positive integer");
+    }
+    config.interval =
+        std::chrono::milliseconds(stats_j["interval_ms"].get<uint64_t>());
+  }
+  return config;
+}
+
+TailConfig ConfigHandler::getTailConfig() {
+  std::string_view TAIL = "tail";
+  TailConfig config;
+  if (!configData.contains(TAIL)) {
+    return config;
+  }
+
+  auto &tail_j = configData[TAIL];
+  if (!tail_j.contains("socket_path") || !tail_j["socket_path"].is_string() ||
+      tail_j["socket_path"].get<std::string>().empty()) {
+    throw std::runtime_error("tail.socket_path is not defined");
+  }
+  config.socket_path = tail_j["socket_path"].get<std::string>();
+
+  if (tail_j.contains("ring_bytes")) {
+    if (!tail_j["ring_bytes"].is_number_unsigned() ||
+        tail_j["ring_bytes"].get<uint64_t>() == 0) {
+      throw std::runtime_error("tail.ring_bytes is not a positive number");
+    }
+    config.ring_bytes = tail_j["ring_bytes"].get<uint64_t>();
+  }
+  return config;
+}
+
+ProfileConfig ConfigHandler::getProfileConfig() {
+  std::string_view PROFILE = "profile";
+  ProfileConfig config;
+  if (!configData.contains(PROFILE)) {
+    return config;
+  }
+
+  auto &profile_j = configData[PROFILE];
+  if (!profile_j.contains("path") || !profile_j["path"].is_string() ||
+      profile_j["path"].get<std::string>().empty()) {
+    throw std::runtime_error("profile.path is not defined");
+  }
+  config.path = profile_j["path"].get<std::string>();
+
+  if (profile_j.contains("events_per_thread")) {
+    if (!profile_j["events_per_thread"].is_number_unsigned() ||
+        profile_j["events_per_thread"].get<uint64_t>() == 0) {
+      throw std::runtime_error(
+          "profile.events_per_thread is not a positive number");
+    }
+    config.events_per_thread = profile_j["events_per_thread"].get<uint64_t>();
+  }
+  return config;
+}
+
+std::string ConfigHandler::getCoreTag() {
+  std::string_view CORE_TAG = "core_tag";
+  if (configData.contains(CORE_TAG)) {
+    if (!configData[CORE_TAG].is_string() ||
+        configData[CORE_TAG].get<std::string>().empty()) {
+      throw std::runtime_error("core_tag is not a non empty string");
+    }
+    return configData[CORE_TAG].get<std::string>();
+  }
+
+  char host[HOST_NAME_MAX + 1] = "";
+  if (gethostname(host, sizeof(host)) != 0 || host[0] == '\0')
+    return "dislog";
+  return host;
+}
+
+MemoryConfig ConfigHandler::getMemoryConfig() {
+  std::string_view MEMORY = "memory";
+  MemoryConfig config;
+  if (!configData.contains(MEMORY)) {
+    return config;
+  }
+
+  auto &memory_j = configData[MEMORY];
+  if (!memory_j.contains("budget_bytes") ||
+      !memory_j["budget_bytes"].is_number_unsigned() ||
+      memory_j["budget_bytes"].get<uint64_t>() == 0) {
+    throw std::runtime_error("memory.budget_bytes is not a positive number");
+  }
+  config.budget_bytes = memory_j["budget_bytes"].get<uint64_t>();
+
+  for (auto [key, value] : {std::pair{"throttle_at", &config.throttle_at},
+                            std::pair{"spill_at", &config.spill_at},
+                            std::pair{"shed_at", &config.shed_at}}) {
+    if (!memory_j.contains(key))
+      continue;
+    if (!memory_j[key].is_number() || memory_j[key].get<double>() <= 0 ||
+        memory_j[key].get<double>() > 1) {
+      throw std::runtime_error(
+          std::format("memory.{} is not a fraction in (0, 1]", key));
+    }
+    *value = memory_j[key].get<double>();
+  }
+  if (config.throttle_at > config.spill_at ||
+      config.spill_at > config.shed_at) {
+    throw std::runtime_error(
+        "memory thresholds must be throttle_at <= spill_at <= shed_at");
+  }
+
+  if (memory_j.contains("protected_priority")) {
+    if (!memory_j["protected_priority"].is_number_unsigned()) {
+      throw std::runtime_error(
+          "memory.protected_priority is not a positive number");
+    }
+    config.protected_priority = memory_j["protected_priority"].get<uint32_t>();
+  }
+
+  if (memory_j.contains("spill_dir")) {
+    if (!memory_j["spill_dir"].is_string()) {
+      throw std::runtime_error("memory.spill_dir is not a string");
+    }
+    config.spill_dir = memory_j["spill_dir"].get<std::string>();
+  }
+
+  if (memory_j.contains("max_spill_bytes")) {
+    if (!memory_j["max_spill_bytes"].is_number_unsigned()) {
+      throw std::runtime_error(
+          "memory.max_spill_bytes is not a positive number");
+    }
+    config.max_spill_bytes = memory_j["max_spill_bytes"].get<uint64_t>();
+  }
+  return config;
+}
@@ -1,7 +1,12 @@
 #pragma once
 
+#include <map>
 #include <nlohmann/json.hpp>
 #include <source/source.hpp>
+#include <memory/memory_governor.hpp>
+#include <stats/stats.hpp>
+#include <tail/tail_ring.hpp>
+#include <trace/profile_zone.hpp>
 
 /**
  * @brief ConfigHandling duties for the Core
@@ -11,6 +16,105 @@ private:
   using json = nlohmann::json;
   json configData;
 
+  /// Tag of the source steering the IRQs of each interface
+  std::map<std::string, std::string> irq_steered;
+
+  /**
+   * @brief Parse the options shared by every kind of input block
+   *
+   * @param[in] sourceBlock The json block of the input
+   * @param[out] source Source to populate
+   */
+  void parseInputOptions(json &sourceBlock, Source &source);
+
+  /**
+   * @brief Parse the options shared by every kind of output block
+   *
+   * @param[in] sourceBlock The json block of the output
+   * @param[out] source Source to populate
+   */
+  void parseOutputOptions(json &sourceBlock, Source &source);
+
+  /**
+   * @brief Parse a `rate_limit` block
+   *
+   * @param[in] block The `rate_limit` json block
+   * @param[in] tag Tag of the input, used for error messages
+   */
+  RateLimitConfig parseRateLimit(json &block, const std::string &tag);
+
+  /**
+   * @brief Parse a list of non empty filter patterns
+   *
+   * @param[in] block The json array of patterns
+   * @param[in] key Name of the list, used for error messages
+   * @param[in] tag Tag of the input, used for error messages
+   */
+  std::vector<std::string> parsePatterns(json &block, std::string_view key,
+                                         const std::string &tag);
+
+  /**
+   * @brief Parse a `dedup` block
+   *
+   * @param[in] block The `dedup` json block
+   * @param[in] tag Tag of the input, used for error messages
+   */
+  DedupConfig parseDedup(json &block, const std::string &tag);
+
+  /**
+   * @brief Parse an entry of `transform_plugins`
+   *
+   * @param[in] block The json block of the plugin
+   * @param[in] tag Tag of the input, used for error messages
+   */
+  TransformPluginConfig parseTransformPlugin(json &block,
+                                             const std::string &tag);
+
+  /**
+   * @brief Parse an `aggregate` block
+   *
+   * @param[in] block The `aggregate` json block
+   * @param[in] tag Tag of the input, used for error messages
+   * @param[in] parse Parse stage of the input, syslog keys need it
+   * @param[in] json_keys Keys the json parse stage extracts, `json:` keys
+   *            must be among them
+   */
+  AggregateConfig parseAggregate(json &block, const std::string &tag,
+                                 ParseFormat parse,
+                                 const std::vector<std::string> &json_keys);
+
+  /**
+   * @brief Parse a `capture` block
+   *
+   * @param[in] block The `capture` json block
+   * @param[in] tag Tag of the input, used for error messages
+   */
+  CaptureConfig parseCapture(json &block, const std::string &tag);
+
+  /**
+   * @brief Parse an `affinity` block
+   *
+   * @param[in] block The `affinity` json block
+   * @param[in] tag Tag of the source, used for error messages
+   */
+  AffinityConfig parseAffinity(json &block, const std::string &tag);
+
+  /**
+   * @brief Parse a `socket` block
+   *
+   * @param[in] block The `socket` json block
+   * @param[in] tag Tag of the source, used for error messages
+   */
+  SocketOptions parseSocketOptions(json &block, const std::string &tag);
+
+  /**
+   * @brief Parse a `busy_poll` block
+   *
+   * @param[in] block The `busy_poll` json block
+   * @param[in] tag Tag of the input, used for error messages
+   */
+  BusyPollConfig parseBusyPoll(json &block, const std::string &tag);
+
 public:
   /**
    * @brief Construct ConfigHandler
@@ -30,4 +134,39 @@ public:
    *
    */
   std::vector<Source* > getSourceForOutputs();
+
+  /**
+   * @brief Return where the counters should be exported
+   * @note The `stats` block is optional, without it nothing is exported
+   *
+   */
+  StatsConfig getStatsConfig();
+
+  /**
+   * @brief Return where live tails are served
+   * @note The `tail` block is optional, without it live tailing is off
+   *
+   */
+  TailConfig getTailConfig();
+
+  /**
+   * @brief Return where timing zones are dumped
+   * @note The `profile` block is optional, without it zones are off
+   *
+   */
+  ProfileConfig getProfileConfig();
+
+  /**
+   * @brief Return the name of the core in metadata headers
+   * @note `core_tag` is optional, the host name is used without it
+   *
+   */
+  std::string getCoreTag();
+
+  /**
+   * @brief Return the memory budget of the core
+   * @note The `memory` block is optional, without it memory is not bounded
+   *
+   */
+  MemoryConfig getMemoryConfig();
 };
@@ -1,5 +1,15 @@
+#include "archive/archive_writer.hpp"
+#include "relay/relay_client.hpp"
 #include "config/config_handler.hpp"
+#include "memory/memory_governor.hpp"
+#include "output/socket_output.hpp"
 #include "service/service.hpp"
+#include "session/session.hpp"
+#include "stats/stats.hpp"
+#include "tail/tail_server.hpp"
+#include "trace/profile_zone.hpp"
+#include <algorithm>
+#include <csignal>
 #include <cstdlib>
 #include <format>
 #include <iostream>
@@ -12,9 +22,25 @@ int main(int argc, char **argv) {
     exit(EXIT_FAILURE);
   }
 
+  // Broken connections are noticed through write errors and reconnected
+  signal(SIGPIPE, SIG_IGN);
+
   std::string filePath(argv[1]);
   ConfigHandler Config(filePath);
 
+  // Outputs and services consult the budget from their first byte
+  MemoryGovernor::instance().configure(Config.getMemoryConfig());
+  Session::setCoreTag(Config.getCoreTag());
+
+  ProfileConfig profileConfig = Config.getProfileConfig();
+  if (!profileConfig.path.empty()) {
+    if (Profiler::compiledIn())
+      Profiler::start(profileConfig);
+    else
+      std::cerr << "Ignoring the profile block, the core was built without "
+                   "DISLOG_PROFILE_ZONES\n";
+  }
+
   std::vector<Source *> inputs = Config.getSourceFromInputs();
   std::vector<Source *> outputs = Config.getSourceForOutputs();
 
@@ -22,12 +48,44 @@ int main(int argc, char **argv) {
   for (auto &source : outputs) {
     if (!source->tag.empty())
       tag_output_match[source->tag] = source;
+
+    // Every output is shared by the inputs routed to it
+    if (auto *file_source = dynamic_cast<FileSource *>(source))
+      ArchiveWriter::start(*file_source);
+    else if (auto *relay_source = dynamic_cast<RelaySource *>(source))
+      RelayClient::start(*relay_source);
+    else
+      SocketOutput::start(*source);
+  }
+
+  StatsConfig statsConfig = Config.getStatsConfig();
+  if (!statsConfig.path.empty()) {
+    std::thread(&StatsRegistry::exportLoop, &StatsRegistry::instance(),
+                statsConfig)
+        .detach();
+  }
+
+  TailConfig tailConfig = Config.getTailConfig();
+  if (!tailConfig.socket_path.empty()) {
+    for (auto &input : inputs)
+      TailRing::add(input->tag, tailConfig.ring_bytes);
+    TailServer::start(tailConfig);
   }
 
   std::vector<std::thread> service_able;
   for (auto &input : inputs) {
+    // A relay input also needs the outputs of its routes
+    std::vector<std::string> output_tags = input->output;
+    if (auto *relay_source = dynamic_cast<RelaySource *>(input)) {
+      for (auto &[origin, route] : relay_source->routes)
+        for (auto &tag : route)
+          if (std::find(output_tags.begin(), output_tags.end(), tag) ==
+              output_tags.end())
+            output_tags.push_back(tag);
+    }
+
     std::vector<Source *> outputSources;
-    for (const std::string &out_tags : input->output) {
+    for (const std::string &out_tags : output_tags) {
       if (tag_output_match.contains(out_tags)) {
         outputSources.emplace_back(tag_output_match[out_tags]);
       } else {
@@ -0,0 +1,84 @@
+#include "deduplicator.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <format>
+#include <functional>
+#include <stats/stats.hpp>
+
+Deduplicator::Deduplicator(const DedupConfig &config, const std::string &tag)
+    : config(config), table(std::bit_ceil(std::max<size_t>(config.table_size, 1))),
+      mask(table.size() - 1),
+      suppressed_records(StatsRegistry::instance().counter(
+          "dislog_dedup_suppressed_records_total",
+          std::format("input=\"{}\"", tag))),
+      summaries(StatsRegistry::instance().counter(
+          "dislog_dedup_summaries_total", std::format("input=\"{}\"", tag))) {}
+
+std::string_view Deduplicator::body(const Record &record) const {
+  // Parsed syslog already tells us where the timestamp is
+  if (record.syslog.valid) {
+    const char *start = record.syslog.hostname.data();
+    if (start == nullptr)
+      start = record.syslog.msg.data();
+    if (start != nullptr)
+      return std::string_view(start,
+                              record.raw.data() + record.raw.size() - start);
+  }
+
+  std::string_view rest = record.raw;
+  rest.remove_prefix(std::min(config.ignore_prefix_bytes, rest.size()));
+  for (size_t field = 0; field < config.ignore_prefix_fields; ++field) {
+    // `Oct  9` has two spaces between the fields
+    size_t next = rest.find_first_not_of(' ', rest.find(' '));
+    if (next == std::string_view::npos)
+      break;
+    rest.remove_prefix(next);
+  }
+  return rest;
+}
+
+void Deduplicator::summarize(Slot &slot, std::string &out) {
+  if (slot.suppressed > 0) {
+    std::string_view snippet(slot.snippet, slot.snippet_len);
+    if (snippet.ends_with('\n'))
+      snippet.remove_suffix(1);
+    out += std::format("dislog: last message repeated {} times: {}\n",
+                       slot.suppressed, snippet);
+    summaries.fetch_add(1, std::memory_order_relaxed);
+  }
+  slot.used = false;
+  slot.suppressed = 0;
+}
+
+bool Deduplicator::keep(const Record &record, Clock::time_point now,
+                        std::string &out) {
+  std::string_view key = body(record);
+  uint64_t hash = std::hash<std::string_view>{}(key);
+  Slot &slot = table[hash & mask];
+
+  if (slot.used && slot.hash == hash &&
+      now - slot.window_start < config.window) {
+    ++slot.suppressed;
+    suppressed_records.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+
+  // Window is over or the slot belongs to another record
+  if (slot.used)
+    summarize(slot, out);
+
+  slot.used = true;
+  slot.hash = hash;
+  slot.window_start = now;
+  slot.snippet_len = std::min(record.raw.size(), SNIPPET);
+  std::copy_n(record.raw.data(), slot.snippet_len, slot.snippet);
+  return true;
+}
+
+void Deduplicator::tick(Clock::time_point now, std::string &out) {
+  for (Slot &slot : table) {
+    if (slot.used && now - slot.window_start >= config.window)
+      summarize(slot, out);
+  }
+}
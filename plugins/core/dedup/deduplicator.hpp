@@ -0,0 +1,100 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <pipeline/record.hpp>
+
+/**
+ * @brief `dedup` block of an input source
+ */
+struct DedupConfig {
+  bool enabled = false;
+
+  /// Repeats within this window are collapsed
+  std::chrono::milliseconds window{10000};
+
+  /// Number of distinct records tracked, rounded up to a power of two
+  size_t table_size = 4096;
+
+  /// Bytes at the start of a record left out of the comparison
+  size_t ignore_prefix_bytes = 0;
+
+  /// Space separated fields at the start of a record left out of the
+  /// comparison, applied after `ignore_prefix_bytes`
+  size_t ignore_prefix_fields = 0;
+};
+
+/**
+ * @brief Collapses repeated records into one record plus a summary
+ * @details Records are hashed into a fixed size, direct mapped table so the
+ *          memory used doesn't depend on the traffic. The first occurrence of
+ *          a record is forwarded, repeats within the window are suppressed and
+ *          reported by a "last message repeated N times" record once the
+ *          window is over or the slot is taken by another record.
+ * @note Not thread safe, owned by the service thread of the input
+ */
+class Deduplicator {
+public:
+  using Clock = std::chrono::steady_clock;
+
+  /**
+   * @brief Allocate the table and register the counters
+   *
+   * @param[in] config The `dedup` block of the input
+   * @param[in] tag Tag of the input, used as the metric label
+   */
+  Deduplicator(const DedupConfig &config, const std::string &tag);
+
+  /**
+   * @brief Should the record be forwarded
+   *
+   * @param[in] record The record, with its parsed fields if any
+   * @param[in] now Time the batch was received
+   * @param[out] out Summaries of evicted records are appended to it
+   */
+  bool keep(const Record &record, Clock::time_point now, std::string &out);
+
+  /**
+   * @brief Emit the summaries of windows which are over
+   *
+   * @param[in] now Current time
+   * @param[out] out Summaries are appended to it
+   */
+  void tick(Clock::time_point now, std::string &out);
+
+  /**
+   * @brief How often `tick` should be called
+   */
+  Clock::duration tickInterval() const { return config.window / 4; }
+
+private:
+  static constexpr size_t SNIPPET = 160;
+
+  struct Slot {
+    uint64_t hash = 0;
+    Clock::time_point window_start;
+    uint32_t suppressed = 0;
+    bool used = false;
+    uint16_t snippet_len = 0;
+    char snippet[SNIPPET];
+  };
+
+  /**
+   * @brief The part of the record that is compared
+   */
+  std::string_view body(const Record &record) const;
+
+  void summarize(Slot &slot, std::string &out);
+
+  DedupConfig config;
+  std::vector<Slot> table;
+  size_t mask;
+
+  std::atomic<uint64_t> &suppressed_records;
+  std::atomic<uint64_t> &summaries;
+};
@@ -0,0 +1,147 @@
+#include "pattern_matcher.hpp"
+
+#include <queue>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define DISLOG_HAVE_SHUFTI 1
+#endif
+
+PatternMatcher::PatternMatcher(const std::vector<std::string> &patternList)
+    : patterns(patternList.size()) {
+  // Compress the alphabet, a pattern set rarely uses more than a few dozen
+  // distinct bytes which keeps the DFA small
+  for (auto &pattern : patternList) {
+    for (unsigned char c : pattern) {
+      if (byte_class[c] == 0)
+        byte_class[c] = classes++;
+    }
+  }
+
+  // Build the trie
+  std::vector<std::vector<int32_t>> trie(1, std::vector<int32_t>(classes, -1));
+  accept.assign(1, -1);
+  for (size_t id = 0; id < patternList.size(); ++id) {
+    uint32_t state = 0;
+    for (unsigned char c : patternList[id]) {
+      uint32_t cls = byte_class[c];
+      if (trie[state][cls] < 0) {
+        trie[state][cls] = trie.size();
+        trie.emplace_back(classes, -1);
+        accept.push_back(-1);
+      }
+      state = trie[state][cls];
+    }
+    if (accept[state] < 0)
+      accept[state] = id;
+  }
+
+  // Fill in the failure transitions breadth first to get a full DFA
+  size_t states = trie.size();
+  transitions.assign(states * classes, 0);
+  std::vector<uint32_t> fail(states, 0);
+  std::queue<uint32_t> pending;
+
+  for (uint32_t cls = 0; cls < classes; ++cls) {
+    if (trie[0][cls] > 0) {
+      transitions[cls] = trie[0][cls];
+      pending.push(trie[0][cls]);
+    }
+  }
+
+  while (!pending.empty()) {
+    uint32_t state = pending.front();
+    pending.pop();
+    if (accept[state] < 0)
+      accept[state] = accept[fail[state]];
+
+    for (uint32_t cls = 0; cls < classes; ++cls) {
+      uint32_t fallback = transitions[fail[state] * classes + cls];
+      if (trie[state][cls] > 0) {
+        uint32_t next = trie[state][cls];
+        fail[next] = fallback;
+        transitions[state * classes + cls] = next;
+        pending.push(next);
+      } else {
+        transitions[state * classes + cls] = fallback;
+      }
+    }
+  }
+
+  // Shufti prefilter. A byte is put in bucket `(hi_nibble & 7)`, it is a
+  // candidate when `lo_nibble[lo] & hi_nibble[hi]` is non zero. The only
+  // false positives are bytes whose high nibble differs in the top bit.
+  for (auto &pattern : patternList) {
+    if (pattern.empty())
+      continue;
+    unsigned char c = pattern[0];
+    start_byte[c] = true;
+    uint8_t bucket = 1 << ((c >> 4) & 7);
+    lo_nibble[c & 0xf] |= bucket;
+    hi_nibble[c >> 4] |= bucket;
+  }
+
+#ifdef DISLOG_HAVE_SHUFTI
+  use_simd = __builtin_cpu_supports("ssse3");
+#endif
+}
+
+#ifdef DISLOG_HAVE_SHUFTI
+__attribute__((target("ssse3"))) static size_t
+shufti_scan(const uint8_t *text, size_t pos, size_t len, const uint8_t *lo,
+            const uint8_t *hi) {
+  const __m128i lo_table = _mm_load_si128((const __m128i *)lo);
+  const __m128i hi_table = _mm_load_si128((const __m128i *)hi);
+  const __m128i low_mask = _mm_set1_epi8(0x0f);
+  const __m128i zero = _mm_setzero_si128();
+
+  while (pos + 16 <= len) {
+    __m128i chunk = _mm_loadu_si128((const __m128i *)(text + pos));
+    __m128i lo_bits = _mm_shuffle_epi8(lo_table, _mm_and_si128(chunk, low_mask));
+    __m128i hi_bits = _mm_shuffle_epi8(
+        hi_table, _mm_and_si128(_mm_srli_epi16(chunk, 4), low_mask));
+    __m128i hit = _mm_cmpeq_epi8(_mm_and_si128(lo_bits, hi_bits), zero);
+    uint32_t mask = ~_mm_movemask_epi8(hit) & 0xffff;
+    if (mask != 0)
+      return pos + __builtin_ctz(mask);
+    pos += 16;
+  }
+  return pos;
+}
+#endif
+
+size_t PatternMatcher::nextCandidate(const uint8_t *text, size_t pos,
+                                     size_t len) const {
+#ifdef DISLOG_HAVE_SHUFTI
+  if (use_simd) {
+    // A false positive is harmless, the automaton just stays in its root
+    pos = shufti_scan(text, pos, len, lo_nibble.data(), hi_nibble.data());
+    if (pos + 16 <= len)
+      return pos;
+  }
+#endif
+  while (pos < len && !start_byte[text[pos]])
+    ++pos;
+  return pos;
+}
+
+int PatternMatcher::find(std::string_view text) const {
+  if (patterns == 0)
+    return -1;
+
+  const uint8_t *data = reinterpret_cast<const uint8_t *>(text.data());
+  size_t len = text.size();
+  uint32_t state = 0;
+
+  for (size_t pos = 0; pos < len;) {
+    if (state == 0) {
+      pos = nextCandidate(data, pos, len);
+      if (pos == len)
+        break;
+    }
+    state = transitions[state * classes + byte_class[data[pos++]]];
+    if (accept[state] >= 0)
+      return accept[state];
+  }
+  return -1;
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * @brief Multi pattern substring matcher (Aho-Corasick)
+ * @details The patterns are compiled once into a DFA over a compressed
+ *          alphabet, so scanning costs one table lookup per byte no matter
+ *          how many patterns there are. While the automaton sits in its root
+ *          state a SIMD prefilter skips over bytes which can't start any
+ *          pattern.
+ */
+class PatternMatcher {
+public:
+  /**
+   * @brief Compile the patterns
+   *
+   * @param[in] patterns Non empty patterns, matched byte for byte
+   */
+  explicit PatternMatcher(const std::vector<std::string> &patterns);
+
+  /**
+   * @brief Find the first pattern occurring in `text`
+   *
+   * @param[in] text Text to scan
+   * @return Index of the pattern which ends first in `text`, -1 if none
+   */
+  int find(std::string_view text) const;
+
+  /**
+   * @brief Number of patterns compiled in
+   */
+  size_t size() const { return patterns; }
+
+private:
+  /**
+   * @brief Skip to the next byte which may start a pattern
+   *
+   * @return Position of the candidate or `len` if there is none
+   */
+  size_t nextCandidate(const uint8_t *text, size_t pos, size_t len) const;
+
+  size_t patterns = 0;
+
+  /// Maps a byte to its equivalence class. Bytes not used by any pattern
+  /// share class 0
+  std::array<uint8_t, 256> byte_class{};
+  uint32_t classes = 1;
+
+  /// `transitions[state * classes + class]` is the next state
+  std::vector<uint32_t> transitions;
+
+  /// Pattern matched on reaching a state, -1 if none
+  std::vector<int32_t> accept;
+
+  /// Bytes which can start a pattern
+  std::array<bool, 256> start_byte{};
+
+  /// Nibble tables of the shufti prefilter, see `PatternMatcher()`
+  alignas(16) std::array<uint8_t, 16> lo_nibble{};
+  alignas(16) std::array<uint8_t, 16> hi_nibble{};
+  bool use_simd = false;
+};
@@ -0,0 +1,65 @@
+#include "record_filter.hpp"
+
+#include <format>
+#include <stats/stats.hpp>
+
+/**
+ * @brief Escape a pattern so it can be used as a label value
+ */
+static std::string escape_label(std::string_view value) {
+  std::string out;
+  for (char c : value) {
+    if (c == '\\' || c == '"') {
+      out += '\\';
+      out += c;
+    } else if (c == '\n') {
+      out += "\\n";
+    } else {
+      out += c;
+    }
+  }
+  return out;
+}
+
+RecordFilter::RecordFilter(const FilterConfig &config, const std::string &tag)
+    : drop_matcher(config.drop_if_contains),
+      keep_matcher(config.keep_if_contains),
+      drop_hits(registerHits(config.drop_if_contains, "drop", tag)),
+      keep_hits(registerHits(config.keep_if_contains, "keep", tag)),
+      dropped_records(StatsRegistry::instance().counter(
+          "dislog_filter_dropped_records_total",
+          std::format("input=\"{}\"", tag))) {}
+
+std::vector<std::atomic<uint64_t> *>
+RecordFilter::registerHits(const std::vector<std::string> &patterns,
+                           const std::string &list, const std::string &tag) {
+  std::vector<std::atomic<uint64_t> *> hits;
+  for (auto &pattern : patterns) {
+    hits.push_back(&StatsRegistry::instance().counter(
+        "dislog_filter_pattern_hits_total",
+        std::format("input=\"{}\",list=\"{}\",pattern=\"{}\"", tag, list,
+                    escape_label(pattern))));
+  }
+  return hits;
+}
+
+bool RecordFilter::keep(std::string_view record) const {
+  if (keep_matcher.size() > 0) {
+    int hit = keep_matcher.find(record);
+    if (hit < 0) {
+      dropped_records.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+    keep_hits[hit]->fetch_add(1, std::memory_order_relaxed);
+  }
+
+  if (drop_matcher.size() > 0) {
+    int hit = drop_matcher.find(record);
+    if (hit >= 0) {
+      drop_hits[hit]->fetch_add(1, std::memory_order_relaxed);
+      dropped_records.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+  }
+  return true;
+}
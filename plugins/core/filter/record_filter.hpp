@@ -0,0 +1,60 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "pattern_matcher.hpp"
+
+/**
+ * @brief `drop_if_contains` / `keep_if_contains` lists of an input source
+ */
+struct FilterConfig {
+  /// Records containing any of these are dropped
+  std::vector<std::string> drop_if_contains;
+
+  /// If not empty only records containing one of these are kept
+  std::vector<std::string> keep_if_contains;
+
+  bool enabled() const {
+    return !drop_if_contains.empty() || !keep_if_contains.empty();
+  }
+};
+
+/**
+ * @brief Decides which records of an input are forwarded
+ * @details `keep_if_contains` is applied first, then `drop_if_contains`.
+ *          Every pattern has a hit counter, a record counts towards the
+ *          first pattern found in it. Thread safe, the counters are atomic.
+ */
+class RecordFilter {
+public:
+  /**
+   * @brief Compile the patterns and register the counters
+   *
+   * @param[in] config The filter lists of the input
+   * @param[in] tag Tag of the input, used as the metric label
+   */
+  RecordFilter(const FilterConfig &config, const std::string &tag);
+
+  /**
+   * @brief Should the record be forwarded
+   */
+  bool keep(std::string_view record) const;
+
+private:
+  /**
+   * @brief Register one counter per pattern
+   */
+  static std::vector<std::atomic<uint64_t> *>
+  registerHits(const std::vector<std::string> &patterns,
+               const std::string &list, const std::string &tag);
+
+  PatternMatcher drop_matcher;
+  PatternMatcher keep_matcher;
+  std::vector<std::atomic<uint64_t> *> drop_hits;
+  std::vector<std::atomic<uint64_t> *> keep_hits;
+  std::atomic<uint64_t> &dropped_records;
+};
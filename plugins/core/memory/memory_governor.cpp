@@ -0,0 +1,52 @@
+#include "memory_governor.hpp"
+
+#include <stats/stats.hpp>
+
+MemoryGovernor &MemoryGovernor::instance() {
+  static MemoryGovernor governor;
+  return governor;
+}
+
+MemoryGovernor::MemoryGovernor()
+    : used(StatsRegistry::instance().gauge("dislog_memory_used_bytes")),
+      level(StatsRegistry::instance().gauge("dislog_memory_pressure")),
+      shed_bytes(
+          StatsRegistry::instance().counter("dislog_memory_shed_bytes_total")) {}
+
+void MemoryGovernor::configure(const MemoryConfig &config) {
+  settings = config;
+  double budget = static_cast<double>(config.budget_bytes);
+  throttle_bytes = static_cast<uint64_t>(budget * config.throttle_at);
+  spill_bytes = static_cast<uint64_t>(budget * config.spill_at);
+  shed_limit = static_cast<uint64_t>(budget * config.shed_at);
+  StatsRegistry::instance()
+      .gauge("dislog_memory_budget_bytes")
+      .store(config.budget_bytes, std::memory_order_relaxed);
+  update(used.load(std::memory_order_relaxed));
+}
+
+void MemoryGovernor::charge(size_t bytes) {
+  update(used.fetch_add(bytes, std::memory_order_relaxed) + bytes);
+}
+
+void MemoryGovernor::release(size_t bytes) {
+  update(used.fetch_sub(bytes, std::memory_order_relaxed) - bytes);
+}
+
+void MemoryGovernor::update(uint64_t now) {
+  Pressure pressure = Pressure::Normal;
+  if (settings.budget_bytes != 0) {
+    if (now >= shed_limit)
+      pressure = Pressure::Shed;
+    else if (now >= spill_bytes)
+      pressure = Pressure::Spill;
+    else if (now >= throttle_bytes)
+      pressure = Pressure::Throttle;
+  }
+
+  // Racing updates may briefly publish a stale level, the next charge or
+  // release corrects it
+  uint64_t value = static_cast<uint64_t>(pressure);
+  if (level.load(std::memory_order_relaxed) != value)
+    level.store(value, std::memory_order_relaxed);
+}
@@ -0,0 +1,146 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/**
+ * @brief Budget of the memory the core's queues and buffers may hold
+ */
+struct MemoryConfig {
+  /// Bytes of the whole core, 0 disables the governor
+  size_t budget_bytes = 0;
+
+  /// Fraction of the budget at which low priority inputs stop being read
+  double throttle_at = 0.70;
+  /// Fraction of the budget at which output lanes spill to disk
+  double spill_at = 0.85;
+  /// Fraction of the budget beyond which new data is dropped
+  double shed_at = 0.95;
+
+  /// Inputs with a `priority` below this are paused under pressure
+  uint32_t protected_priority = 2;
+
+  /// Directory the spill files are created in, empty disables spilling
+  std::string spill_dir;
+  /// Bytes a lane may spill before it sheds
+  size_t max_spill_bytes = 1ull << 30;
+};
+
+/**
+ * @brief How close the core is to its memory budget, escalating in order
+ */
+enum class Pressure : uint8_t { Normal, Throttle, Spill, Shed };
+
+/**
+ * @brief Process wide accounting of the bytes held on the data path
+ * @details Every queue and buffer which grows with the traffic charges what
+ *          it holds and releases it when done. The governor turns the total
+ *          into a `Pressure` the holders act on: services stop reading low
+ *          priority inputs, output lanes spill to disk, and in the end new
+ *          data is shed. Charging is a relaxed atomic add, the pressure is
+ *          recomputed on every change so reading it is a relaxed load.
+ *
+ *          Usage and pressure are exported as `dislog_memory_used_bytes`,
+ *          `dislog_memory_budget_bytes` and `dislog_memory_pressure` (0 to 3).
+ */
+class MemoryGovernor {
+public:
+  /**
+   * @brief Get the governor shared by the whole core
+   */
+  static MemoryGovernor &instance();
+
+  /**
+   * @brief Set the budget and thresholds
+   * @note Call before the services and outputs start
+   */
+  void configure(const MemoryConfig &config);
+
+  const MemoryConfig &config() const { return settings; }
+
+  /**
+   * @brief Account for bytes a buffer now holds
+   */
+  void charge(size_t bytes);
+
+  /**
+   * @brief Account for bytes a buffer gave back
+   */
+  void release(size_t bytes);
+
+  Pressure pressure() const {
+    return static_cast<Pressure>(level.load(std::memory_order_relaxed));
+  }
+
+  /**
+   * @brief Should an input of `priority` be read at the current pressure
+   */
+  bool admitsReads(uint32_t priority) const {
+    return pressure() < Pressure::Throttle ||
+           priority >= settings.protected_priority;
+  }
+
+  /**
+   * @brief Count data dropped because of the budget
+   */
+  void shed(size_t bytes) {
+    shed_bytes.fetch_add(bytes, std::memory_order_relaxed);
+  }
+
+private:
+  MemoryGovernor();
+
+  /**
+   * @brief Recompute the pressure after `used` changed to `now`
+   */
+  void update(uint64_t now);
+
+  MemoryConfig settings;
+  uint64_t throttle_bytes = 0;
+  uint64_t spill_bytes = 0;
+  uint64_t shed_limit = 0;
+
+  std::atomic<uint64_t> &used;
+  std::atomic<uint64_t> &level;
+  std::atomic<uint64_t> &shed_bytes;
+};
+
+/**
+ * @brief The bytes one buffer has charged to the governor
+ * @details Set it to the size of the buffer whenever that changes, the
+ *          difference is charged or released. Whatever is left is released
+ *          when it goes away.
+ */
+class MemoryAccount {
+public:
+  MemoryAccount() = default;
+  MemoryAccount(const MemoryAccount &) = delete;
+  MemoryAccount &operator=(const MemoryAccount &) = delete;
+  MemoryAccount(MemoryAccount &&other) noexcept : held(other.held) {
+    other.held = 0;
+  }
+  MemoryAccount &operator=(MemoryAccount &&other) noexcept {
+    if (this != &other) {
+      set(0);
+      held = other.held;
+      other.held = 0;
+    }
+    return *this;
+  }
+  ~MemoryAccount() { set(0); }
+
+  void set(size_t bytes) {
+    if (bytes > held)
+      MemoryGovernor::instance().charge(bytes - held);
+    else if (bytes < held)
+      MemoryGovernor::instance().release(held - bytes);
+    held = bytes;
+  }
+
+  size_t get() const { return held; }
+
+private:
+  size_t held = 0;
+};
@@ -0,0 +1,39 @@
+#include "socket_options.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <format>
+#include <iostream>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+void apply_socket_options(int fd, const SocketOptions &options, bool tcp,
+                          const std::string &tag) {
+  auto set = [&](int level, int option, const char *name, int value) {
+    if (setsockopt(fd, level, option, &value, sizeof(value)) < 0) {
+      std::cerr << std::format("Couldn't set {} for tag {}: {}\n", name, tag,
+                               std::strerror(errno));
+    }
+  };
+
+  if (options.send_buffer_bytes > 0)
+    set(SOL_SOCKET, SO_SNDBUF, "SO_SNDBUF", options.send_buffer_bytes);
+  if (options.receive_buffer_bytes > 0)
+    set(SOL_SOCKET, SO_RCVBUF, "SO_RCVBUF", options.receive_buffer_bytes);
+  if (!tcp)
+    return;
+
+  if (options.tcp_nodelay)
+    set(IPPROTO_TCP, TCP_NODELAY, "TCP_NODELAY", 1);
+  if (options.keepalive) {
+    set(SOL_SOCKET, SO_KEEPALIVE, "SO_KEEPALIVE", 1);
+    if (options.keepalive_idle_s > 0)
+      set(IPPROTO_TCP, TCP_KEEPIDLE, "TCP_KEEPIDLE", options.keepalive_idle_s);
+    if (options.keepalive_interval_s > 0)
+      set(IPPROTO_TCP, TCP_KEEPINTVL, "TCP_KEEPINTVL",
+          options.keepalive_interval_s);
+    if (options.keepalive_count > 0)
+      set(IPPROTO_TCP, TCP_KEEPCNT, "TCP_KEEPCNT", options.keepalive_count);
+  }
+}
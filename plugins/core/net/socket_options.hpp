@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/**
+ * @brief `socket` block of a source, kernel defaults where unset
+ * @details The TCP options only apply to `IPv4` and `RELAY` sources.
+ */
+struct SocketOptions {
+  /// `SO_SNDBUF` and `SO_RCVBUF`, 0 for the kernel default. Set on the
+  /// listening socket of an input so accepted clients inherit them
+  uint32_t send_buffer_bytes = 0;
+  uint32_t receive_buffer_bytes = 0;
+
+  /// `TCP_NODELAY`, send small writes right away
+  bool tcp_nodelay = false;
+
+  /// Outputs hold `TCP_CORK` while writing a batch so it leaves in full
+  /// segments and the tail goes out when the batch is done
+  bool tcp_cork = false;
+
+  /// `SO_KEEPALIVE` with these `TCP_KEEPIDLE`, `TCP_KEEPINTVL` and
+  /// `TCP_KEEPCNT`, 0 for the kernel defaults
+  bool keepalive = false;
+  uint32_t keepalive_idle_s = 0;
+  uint32_t keepalive_interval_s = 0;
+  uint32_t keepalive_count = 0;
+
+  /// Outputs send batches of at least `zerocopy_min_bytes` with
+  /// `MSG_ZEROCOPY`. Plain (not TLS) `IPv4` outputs only
+  bool zerocopy = false;
+  size_t zerocopy_min_bytes = 32 * 1024;
+};
+
+/**
+ * @brief Set the options of a socket
+ * @details Best effort, a failure is logged and the rest still applied
+ *
+ * @param[in] fd The socket, not connected yet for the buffer sizes to be
+ *               used for the TCP window scale
+ * @param[in] options What to set
+ * @param[in] tcp Is it a TCP socket
+ * @param[in] tag Tag of the source, used for logging
+ */
+void apply_socket_options(int fd, const SocketOptions &options, bool tcp,
+                          const std::string &tag);
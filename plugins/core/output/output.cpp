@@ -0,0 +1,15 @@
+#include "output.hpp"
+
+#include <unordered_map>
+
+// Filled before the services start and only read afterwards
+static std::unordered_map<std::string, std::unique_ptr<Output>> shared_outputs;
+
+void Output::add(const std::string &tag, std::unique_ptr<Output> output) {
+  shared_outputs[tag] = std::move(output);
+}
+
+Output *Output::get(const std::string &tag) {
+  auto output = shared_outputs.find(tag);
+  return output == shared_outputs.end() ? nullptr : output->second.get();
+}
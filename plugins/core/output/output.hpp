@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <session/session.hpp>
+#include <string>
+#include <string_view>
+#include <trace/route_latency.hpp>
+
+/**
+ * @brief An output shared by every input routed to it
+ * @details Unlike socket outputs, which every input connects on its own, a
+ *          shared output is created once by the core and does its I/O on its
+ *          own thread(s). Inputs only hand it data, which must never block.
+ */
+class Output {
+public:
+  virtual ~Output() = default;
+
+  /**
+   * @brief Register an input routed to the output
+   * @details Outputs which schedule across inputs give every input a lane of
+   *          its own, the others return 0 for everyone.
+   *
+   * @param[in] input Tag of the input
+   * @param[in] kind Tells the lanes of one input apart: empty for its
+   *                 records, `summary` for its aggregates and `route<i>` for
+   *                 the `i`th plugin route
+   * @param[in] weight Share of the output the input gets when it is saturated
+   * @return The lane to pass to `send`
+   */
+  virtual int openLane(const std::string &input, const std::string &kind,
+                       uint32_t weight) {
+    return 0;
+  }
+
+  /**
+   * @brief Queue data for the output
+   *
+   * @param[in] lane Lane of the input handing the data over
+   * @param[in] origin Tag of the input the data entered the core through
+   * @param[in] stream Client connection the data came from, unique within
+   *                   the core. 0 for data generated by the core itself
+   * @param[in] data The data, only valid for the duration of the call
+   * @param[in] trace Set if the data is a sampled batch, the output reports
+   *                  its latency once written. Only valid during the call
+   */
+  virtual void send(int lane, const std::string &origin, uint32_t stream,
+                    std::string_view data, const Trace *trace) = 0;
+
+  /**
+   * @brief A client connection `stream` was accepted
+   * @details Called before any data of the stream is sent. Streams of the
+   *          core itself (0) are never opened.
+   */
+  virtual void openStream(uint32_t stream, const Session &session) {}
+
+  /**
+   * @brief The client connection `stream` is gone
+   */
+  virtual void closeStream(uint32_t stream) {}
+
+  /**
+   * @brief Register the shared output of a tag
+   * @note Call before the services start, the registry isn't locked
+   */
+  static void add(const std::string &tag, std::unique_ptr<Output> output);
+
+  /**
+   * @brief Get the shared output of a tag
+   *
+   * @return The output or nullptr if the tag is not a shared output
+   */
+  static Output *get(const std::string &tag);
+};
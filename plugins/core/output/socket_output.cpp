@@ -0,0 +1,777 @@
+#include "socket_output.hpp"
+
+#include <affinity/affinity.hpp>
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <fcntl.h>
+#include <format>
+#include <iostream>
+#include <linux/errqueue.h>
+#include <net/socket_options.hpp>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <thread>
+#include <trace/probes.hpp>
+#include <trace/profile_zone.hpp>
+#include <trace/trace_stamp.hpp>
+#include <unistd.h>
+
+/// A batch is written once it holds this much
+static constexpr size_t BATCH_BYTES = 64 * 1024;
+
+// Older headers lack zero copy sends (Linux 4.14)
+#ifndef SO_ZEROCOPY
+#define SO_ZEROCOPY 60
+#endif
+#ifndef MSG_ZEROCOPY
+#define MSG_ZEROCOPY 0x4000000
+#endif
+
+/// Precedes every chunk in a spill file
+struct SpillHeader {
+  /// `SocketOutput::Clock` ticks when the chunk was queued
+  int64_t enqueued;
+  uint64_t size;
+  /// For the metadata header
+  int64_t received_ns;
+  uint32_t stream;
+};
+
+/**
+ * @brief Name of the persistent queue of a lane
+ * @details Letters and digits are kept, every other byte becomes `_XX` (hex)
+ *          so the parts never contain the `-` between them and no two lanes
+ *          share a name
+ */
+static std::string queueName(const std::string &output,
+                             const std::string &input,
+                             const std::string &kind) {
+  static constexpr char HEX[] = "0123456789abcdef";
+  auto encode = [](std::string &name, const std::string &part) {
+    name += '-';
+    for (unsigned char c : part) {
+      if (std::isalnum(c)) {
+        name += static_cast<char>(c);
+      } else {
+        name += '_';
+        name += HEX[c >> 4];
+        name += HEX[c & 0xf];
+      }
+    }
+  };
+  std::string name = "/dislog";
+  encode(name, output);
+  encode(name, input);
+  if (!kind.empty())
+    encode(name, kind);
+  return name;
+}
+
+void SocketOutput::start(Source &config) {
+  auto output = std::unique_ptr<SocketOutput>(new SocketOutput(config));
+  SocketOutput *raw = output.get();
+  Output::add(config.tag, std::move(output));
+  std::thread(&SocketOutput::run, raw).detach();
+  if (!MemoryGovernor::instance().config().spill_dir.empty())
+    std::thread(&SocketOutput::runSpill, raw).detach();
+}
+
+SocketOutput::SocketOutput(Source &config)
+    : config(config.clone()),
+      zerocopy_sends(&StatsRegistry::instance().counter(
+          "dislog_output_zerocopy_sends_total",
+          std::format("output=\"{}\"", config.tag))),
+      zerocopy_copied(&StatsRegistry::instance().counter(
+          "dislog_output_zerocopy_copied_sends_total",
+          std::format("output=\"{}\"", config.tag))) {}
+
+int SocketOutput::openLane(const std::string &input, const std::string &kind,
+                           uint32_t weight) {
+  auto lane = std::make_unique<Lane>();
+  lane->weight = weight;
+  std::string labels =
+      std::format("output=\"{}\",input=\"{}\"", config->tag, input);
+  StatsRegistry &stats = StatsRegistry::instance();
+  lane->queued_bytes = &stats.gauge("dislog_output_lane_queued_bytes", labels);
+  lane->spilled_bytes =
+      &stats.gauge("dislog_output_lane_spilled_bytes", labels);
+  lane->dropped_bytes =
+      &stats.counter("dislog_output_lane_dropped_bytes_total", labels);
+  lane->written_bytes =
+      &stats.counter("dislog_output_lane_written_bytes_total", labels);
+  lane->latency = &stats.histogram("dislog_output_lane_latency_seconds", labels);
+  if (config->metadata_header) {
+    lane->header = std::make_shared<const std::string>(
+        Session{input, "-"}.header());
+  }
+
+  if (config->persistent_queues) {
+    std::string name = queueName(config->tag, input, kind);
+    // Room for a full lane and the batch taken out of it
+    lane->queue = shm::Queue::attach(name, 2 * config->lane_queue_bytes);
+    if (!lane->queue) {
+      std::cerr << std::format(
+          "Couldn't attach the queue {} of {}, queueing in memory: {}\n",
+          name, config->tag, std::strerror(errno));
+    } else {
+      for (const shm::Queue::Entry &entry : lane->queue->restored()) {
+        lane->chunks.push_back({entry.data.size(), Clock::now(),
+                                Trace{{}, nullptr}, lane->header,
+                                entry.received_ns});
+        lane->queued += entry.data.size();
+      }
+      if (lane->queued > 0) {
+        std::cerr << std::format(
+            "Resuming {} bytes left in {} (generation {})\n", lane->queued,
+            name, lane->queue->generation());
+      }
+      lane->memory.set(lane->queued);
+      lane->queued_bytes->store(lane->queued, std::memory_order_relaxed);
+    }
+  }
+
+  std::lock_guard<std::mutex> guard(lock);
+  int lane_id = static_cast<int>(lanes.size());
+  lane->id = lane_id;
+  if (!lane->chunks.empty()) {
+    lane->active = true;
+    active.push_back(lane_id);
+    wakeup.notify_one();
+  }
+  lanes.push_back(std::move(lane));
+  return lane_id;
+}
+
+void SocketOutput::send(int lane_id, const std::string &origin,
+                        uint32_t stream, std::string_view data,
+                        const Trace *trace) {
+  if (data.empty())
+    return;
+
+  MemoryGovernor &governor = MemoryGovernor::instance();
+  Pressure pressure = governor.pressure();
+  int64_t received_ns = 0;
+  if (config->metadata_header) {
+    received_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                      std::chrono::system_clock::now().time_since_epoch())
+                      .count();
+  }
+
+  std::lock_guard<std::mutex> guard(lock);
+  Lane &lane = *lanes[lane_id];
+  // Once a lane spills it keeps spilling until the file is drained, so its
+  // chunks stay in order
+  if (lane.spilled > 0 ||
+      (pressure >= Pressure::Spill && !governor.config().spill_dir.empty() &&
+       !spill_broken)) {
+    size_t size = sizeof(SpillHeader) + data.size();
+    if (spill_broken ||
+        lane.spilled + size > governor.config().max_spill_bytes ||
+        lane.spill_pending.size() + size > config->lane_queue_bytes) {
+      lane.dropped_bytes->fetch_add(data.size(), std::memory_order_relaxed);
+      governor.shed(data.size());
+      return;
+    }
+    // Written by the spill thread, which queues the lane once it read the
+    // chunks back
+    SpillHeader header{Clock::now().time_since_epoch().count(), data.size(),
+                       received_ns, stream};
+    lane.spill_pending.append(reinterpret_cast<const char *>(&header),
+                              sizeof(header));
+    lane.spill_pending.append(data);
+    lane.spill_memory.set(lane.spill_pending.size());
+    lane.spilled += size;
+    lane.spilled_bytes->store(lane.spilled, std::memory_order_relaxed);
+    DISLOG_PROBE(enqueue, config->tag.c_str(), lane_id, data.size(),
+                 lane.queued);
+    spill_work = true;
+    spill_wakeup.notify_one();
+    return;
+  } else if (pressure == Pressure::Shed) {
+    lane.dropped_bytes->fetch_add(data.size(), std::memory_order_relaxed);
+    governor.shed(data.size());
+    return;
+  } else if (lane.queued + data.size() > config->lane_queue_bytes) {
+    // The output can't keep up, don't let the input stall
+    lane.dropped_bytes->fetch_add(data.size(), std::memory_order_relaxed);
+    return;
+  } else if (lane.queue && !lane.queue->push(data, received_ns)) {
+    // Written chunks of a broken connection still hold their room
+    lane.dropped_bytes->fetch_add(data.size(), std::memory_order_relaxed);
+    return;
+  } else {
+    if (!lane.queue)
+      lane.buf.append(data);
+    lane.chunks.push_back({data.size(), Clock::now(),
+                           trace ? *trace : Trace{{}, nullptr},
+                           config->metadata_header ? streamHeader(lane, stream)
+                                                   : nullptr,
+                           received_ns});
+    lane.queued += data.size();
+    lane.memory.set(lane.queued);
+    lane.queued_bytes->store(lane.queued, std::memory_order_relaxed);
+  }
+  DISLOG_PROBE(enqueue, config->tag.c_str(), lane_id, data.size(), lane.queued);
+
+  if (!lane.active) {
+    lane.active = true;
+    active.push_back(lane_id);
+    wakeup.notify_one();
+  }
+}
+
+void SocketOutput::openStream(uint32_t stream, const Session &session) {
+  if (!config->metadata_header)
+    return;
+  auto header = std::make_shared<const std::string>(session.header());
+  std::lock_guard<std::mutex> guard(lock);
+  sessions[stream] = std::move(header);
+}
+
+void SocketOutput::closeStream(uint32_t stream) {
+  if (!config->metadata_header)
+    return;
+  // Queued chunks of the stream hold on to their header
+  std::lock_guard<std::mutex> guard(lock);
+  sessions.erase(stream);
+}
+
+std::shared_ptr<const std::string>
+SocketOutput::streamHeader(const Lane &lane, uint32_t stream) const {
+  auto session = sessions.find(stream);
+  return session == sessions.end() ? lane.header : session->second;
+}
+
+void SocketOutput::runSpill() {
+  apply_affinity(config->affinity, config->tag);
+
+  std::string data;
+  std::vector<Lane *> work;
+  while (true) {
+    {
+      std::unique_lock<std::mutex> guard(lock);
+      spill_wakeup.wait(guard, [&] { return spill_work; });
+      spill_work = false;
+      work.clear();
+      for (auto &lane : lanes)
+        work.push_back(lane.get());
+    }
+
+    for (Lane *lane : work) {
+      bool load;
+      {
+        std::lock_guard<std::mutex> guard(lock);
+        data.swap(lane->spill_pending);
+        lane->spill_memory.set(0);
+      }
+      if (!data.empty())
+        spill(*lane, data);
+      data.clear();
+
+      // Only this thread adds chunks while the lane spills
+      {
+        std::lock_guard<std::mutex> guard(lock);
+        load = lane->chunks.empty();
+      }
+      if (load && lane->spill_read < lane->spill_write)
+        unspill(*lane);
+    }
+  }
+}
+
+void SocketOutput::spill(Lane &lane, std::string_view data) {
+  const MemoryConfig &memory = MemoryGovernor::instance().config();
+  if (lane.spill_fd < 0) {
+    // Nobody else needs to see the file, it goes away with the descriptor
+    lane.spill_fd =
+        open(memory.spill_dir.c_str(), O_TMPFILE | O_RDWR | O_CLOEXEC, 0600);
+    if (lane.spill_fd < 0) {
+      std::cerr << std::format(
+          "Couldn't create a spill file for {} in {}: {}\n", config->tag,
+          memory.spill_dir, std::strerror(errno));
+      std::lock_guard<std::mutex> guard(lock);
+      spill_broken = true;
+      dropSpilled(lane, data);
+      return;
+    }
+  }
+
+  size_t done = 0;
+  while (done < data.size()) {
+    ssize_t ret = pwrite(lane.spill_fd, data.data() + done, data.size() - done,
+                         lane.spill_write + done);
+    if (ret < 0 && errno == EINTR)
+      continue;
+    if (ret <= 0) {
+      std::cerr << std::format("Couldn't spill for {}: {}\n", config->tag,
+                               std::strerror(errno));
+      // Whatever made it is overwritten by the next spill
+      std::lock_guard<std::mutex> guard(lock);
+      dropSpilled(lane, data);
+      return;
+    }
+    done += ret;
+  }
+  lane.spill_write += data.size();
+}
+
+void SocketOutput::unspill(Lane &lane) {
+  spill_buf.clear();
+  size_t loaded = 0;
+  bool lost = false;
+  while (lane.spill_read < lane.spill_write &&
+         loaded < QUANTUM * lane.weight) {
+    SpillHeader header;
+    size_t at = spill_buf.size();
+    bool read_back =
+        pread(lane.spill_fd, &header, sizeof(header), lane.spill_read) ==
+        sizeof(header);
+    if (read_back) {
+      spill_buf.resize(at + sizeof(header) + header.size);
+      std::memcpy(spill_buf.data() + at, &header, sizeof(header));
+      read_back = pread(lane.spill_fd, spill_buf.data() + at + sizeof(header),
+                        header.size, lane.spill_read + sizeof(header)) ==
+                  static_cast<ssize_t>(header.size);
+    }
+    if (!read_back) {
+      std::cerr << std::format("Lost the spill file of {}: {}\n", config->tag,
+                               std::strerror(errno));
+      spill_buf.resize(at);
+      lost = true;
+      break;
+    }
+    lane.spill_read += sizeof(header) + header.size;
+    loaded += header.size;
+  }
+  uint64_t lost_bytes = lost ? lane.spill_write - lane.spill_read : 0;
+  if (lost || lane.spill_read == lane.spill_write) {
+    // Drained, start the file over
+    ftruncate(lane.spill_fd, 0);
+    lane.spill_read = lane.spill_write = 0;
+  }
+
+  std::lock_guard<std::mutex> guard(lock);
+  if (lane.chunks.empty()) {
+    lane.buf.clear();
+    lane.head = 0;
+  }
+  std::string_view chunks(spill_buf);
+  while (!chunks.empty()) {
+    SpillHeader header;
+    std::memcpy(&header, chunks.data(), sizeof(header));
+    std::string_view data = chunks.substr(sizeof(header), header.size);
+    chunks.remove_prefix(sizeof(header) + header.size);
+    lane.spilled -= sizeof(header) + header.size;
+    if (lane.queue && !lane.queue->push(data, header.received_ns)) {
+      lane.dropped_bytes->fetch_add(header.size, std::memory_order_relaxed);
+      continue;
+    }
+    if (!lane.queue)
+      lane.buf.append(data);
+
+    // A stream closed by now gets the header of the core's own records
+    lane.chunks.push_back({header.size,
+                           Clock::time_point(Clock::duration(header.enqueued)),
+                           Trace{{}, nullptr},
+                           config->metadata_header
+                               ? streamHeader(lane, header.stream)
+                               : nullptr,
+                           header.received_ns});
+    lane.queued += header.size;
+  }
+  if (lost) {
+    lane.dropped_bytes->fetch_add(lost_bytes, std::memory_order_relaxed);
+    lane.spilled -= lost_bytes;
+  }
+  lane.memory.set(lane.queued);
+  lane.queued_bytes->store(lane.queued, std::memory_order_relaxed);
+  lane.spilled_bytes->store(lane.spilled, std::memory_order_relaxed);
+
+  if (!lane.chunks.empty() && !lane.active) {
+    lane.active = true;
+    active.push_back(lane.id);
+    wakeup.notify_one();
+  }
+}
+
+void SocketOutput::dropSpilled(Lane &lane, std::string_view data) {
+  while (!data.empty()) {
+    SpillHeader header;
+    std::memcpy(&header, data.data(), sizeof(header));
+    data.remove_prefix(sizeof(header) + header.size);
+    lane.spilled -= sizeof(header) + header.size;
+    lane.dropped_bytes->fetch_add(header.size, std::memory_order_relaxed);
+  }
+  lane.spilled_bytes->store(lane.spilled, std::memory_order_relaxed);
+}
+
+void SocketOutput::fillBatch() {
+  DISLOG_ZONE("fill_batch");
+  while (batch.size() < BATCH_BYTES && !active.empty()) {
+    int lane_id = active.front();
+    active.pop_front();
+    Lane &lane = *lanes[lane_id];
+    lane.deficit += QUANTUM * lane.weight;
+
+    while (!lane.chunks.empty() && lane.chunks.front().size <= lane.deficit) {
+      Chunk &chunk = lane.chunks.front();
+      if (lane.queue) {
+        shm::Queue::Entry entry;
+        lane.queue->next(entry);
+        batch.append(entry.data);
+      } else {
+        batch.append(lane.buf, lane.head, chunk.size);
+        lane.head += chunk.size;
+      }
+      batch_chunks.emplace_back(&lane, chunk);
+      lane.deficit -= chunk.size;
+      lane.queued -= chunk.size;
+      lane.chunks.pop_front();
+    }
+    lane.memory.set(lane.queued);
+    lane.queued_bytes->store(lane.queued, std::memory_order_relaxed);
+
+    if (lane.chunks.empty()) {
+      // An idle lane doesn't bank credit
+      lane.active = false;
+      lane.deficit = 0;
+      lane.buf.clear();
+      lane.head = 0;
+      if (lane.spilled > 0) {
+        // Its next chunks are on disk, the spill thread queues it again
+        spill_work = true;
+        spill_wakeup.notify_one();
+      }
+    } else {
+      if (lane.head > BATCH_BYTES && lane.head * 2 > lane.buf.size()) {
+        lane.buf.erase(0, lane.head);
+        lane.head = 0;
+      }
+      active.push_back(lane_id);
+    }
+  }
+  batch_memory.set(batch.size());
+}
+
+bool SocketOutput::writeBatch() {
+  DISLOG_ZONE("write_batch");
+  const SocketOptions &options = config->socket_options;
+  bool columnar = config->format == OutputFormat::Columnar;
+  if (columnar && frame.empty())
+    encoder.encode(batch, frame);
+  // Frames are short lived, only the text batches are sent without copying.
+  // Neither are the metadata headers, which are reused right away
+  std::string &wire = columnar ? frame : batch;
+  batch_memory.set(batch.size() + frame.size());
+  bool headers = config->metadata_header;
+
+  bool cork = options.tcp_cork && config->getTypeOfSocket() == AF_INET;
+  bool use_zerocopy = zerocopy && !columnar && !headers &&
+                      batch.size() >= options.zerocopy_min_bytes;
+  uint32_t first_send = zerocopy_sent;
+  int on = 1;
+  if (cork)
+    setsockopt(fd, IPPROTO_TCP, TCP_CORK, &on, sizeof(on));
+
+  size_t written = headers ? writeWithHeaders() : 0;
+  while (!headers && written < wire.size()) {
+    int flags = MSG_NOSIGNAL | (use_zerocopy ? MSG_ZEROCOPY : 0);
+    ssize_t result =
+        tls ? tls->write(wire.data() + written, wire.size() - written)
+            : ::send(fd, wire.data() + written, wire.size() - written,
+                     flags);
+    if (result >= 0 && use_zerocopy) {
+      ++zerocopy_sent;
+      zerocopy_sends->fetch_add(1, std::memory_order_relaxed);
+    }
+    if (result < 0) {
+      if (errno == EINTR)
+        continue;
+      if (errno == ENOBUFS && use_zerocopy) {
+        // Out of option memory for the notifications, copy instead
+        use_zerocopy = false;
+        continue;
+      }
+      std::cerr << std::format("Write error for {}: {}\n", config->tag,
+                               std::strerror(errno));
+      break;
+    }
+    written += result;
+  }
+
+  if (cork) {
+    // Uncorking pushes out the partial segment at the end of the batch
+    int off = 0;
+    setsockopt(fd, IPPROTO_TCP, TCP_CORK, &off, sizeof(off));
+  }
+
+  // Account for the chunks which made it, keep the rest for the next
+  // connection. A chunk cut short is sent again in full.
+  if (columnar) {
+    if (written < frame.size())
+      return false;
+    written = batch.size();
+    frame.clear();
+  }
+  Clock::time_point now = Clock::now();
+  size_t done = 0;
+  size_t kept = 0;
+  for (auto &[lane, chunk] : batch_chunks) {
+    if (done + chunk.size > written)
+      break;
+    done += chunk.size;
+    ++kept;
+    if (lane->queue)
+      lane->queue->release();
+    lane->written_bytes->fetch_add(chunk.size, std::memory_order_relaxed);
+    lane->latency->observe(
+        std::chrono::duration<double>(now - chunk.enqueued).count());
+    if (chunk.trace.latency)
+      chunk.trace.latency->observe(chunk.trace.stamp, trace::monotonic_ns());
+  }
+  batch_chunks.erase(batch_chunks.begin(), batch_chunks.begin() + kept);
+  DISLOG_PROBE(write, config->tag.c_str(), fd, done, kept);
+
+  if (zerocopy_sent != first_send && done == batch.size()) {
+    // The kernel reads the batch until the sends complete, fill another
+    zerocopy_pending.emplace_back(zerocopy_sent - 1, std::move(batch));
+    zerocopy_memory.set(zerocopy_memory.get() + done);
+    batch.clear();
+    if (!spare_batches.empty()) {
+      batch = std::move(spare_batches.back());
+      spare_batches.pop_back();
+    }
+  } else {
+    // Cut short only if the connection broke, it never sends from it again
+    batch.erase(0, done);
+  }
+  batch_memory.set(batch.size());
+  return batch.empty();
+}
+
+size_t SocketOutput::writeWithHeaders() {
+  // The per chunk parts go first so the iovecs can point into them
+  header_tails.clear();
+  wire_sizes.clear();
+  for (auto &[lane, chunk] : batch_chunks) {
+    size_t start = header_tails.size();
+    header_tails +=
+        std::format(" received={} bytes={}\n", chunk.received_ns, chunk.size);
+    wire_sizes.push_back(chunk.header->size() + header_tails.size() - start +
+                         chunk.size);
+  }
+
+  iov.clear();
+  size_t tail = 0;
+  size_t offset = 0;
+  for (auto &[lane, chunk] : batch_chunks) {
+    size_t tail_end = header_tails.find('\n', tail) + 1;
+    iov.push_back({const_cast<char *>(chunk.header->data()),
+                   chunk.header->size()});
+    iov.push_back({header_tails.data() + tail, tail_end - tail});
+    iov.push_back({batch.data() + offset, chunk.size});
+    tail = tail_end;
+    offset += chunk.size;
+  }
+
+  size_t sent = 0;
+  if (tls && !tls->kernelTx()) {
+    // OpenSSL encrypts from one buffer, kTLS takes the iovecs on the fd
+    staged.clear();
+    for (const iovec &part : iov)
+      staged.append(static_cast<const char *>(part.iov_base), part.iov_len);
+    while (sent < staged.size()) {
+      ssize_t result = tls->write(staged.data() + sent, staged.size() - sent);
+      if (result < 0) {
+        if (errno == EINTR)
+          continue;
+        std::cerr << std::format("Write error for {}: {}\n", config->tag,
+                                 std::strerror(errno));
+        break;
+      }
+      sent += result;
+    }
+  } else {
+    size_t first = 0;
+    while (first < iov.size()) {
+      msghdr msg{};
+      msg.msg_iov = iov.data() + first;
+      msg.msg_iovlen = std::min<size_t>(iov.size() - first, IOV_MAX);
+      ssize_t result = sendmsg(fd, &msg, MSG_NOSIGNAL);
+      if (result < 0) {
+        if (errno == EINTR)
+          continue;
+        std::cerr << std::format("Write error for {}: {}\n", config->tag,
+                                 std::strerror(errno));
+        break;
+      }
+      sent += result;
+      // Skip what went out, the first iovec left may be cut short
+      size_t left = result;
+      while (first < iov.size() && left >= iov[first].iov_len)
+        left -= iov[first++].iov_len;
+      if (left > 0) {
+        iov[first].iov_base = static_cast<char *>(iov[first].iov_base) + left;
+        iov[first].iov_len -= left;
+      }
+    }
+  }
+
+  size_t done = 0;
+  for (size_t i = 0; i < wire_sizes.size() && wire_sizes[i] <= sent; ++i) {
+    sent -= wire_sizes[i];
+    done += batch_chunks[i].second.size;
+  }
+  return done;
+}
+
+void SocketOutput::enableZerocopy() {
+  for (auto &[last_send, pending] : zerocopy_pending) {
+    if (spare_batches.size() < ZEROCOPY_PENDING) {
+      pending.clear();
+      spare_batches.push_back(std::move(pending));
+    }
+  }
+  zerocopy_pending.clear();
+  zerocopy_memory.set(0);
+  zerocopy_sent = zerocopy_done = 0;
+
+  zerocopy = false;
+  if (!config->socket_options.zerocopy || tls ||
+      config->getTypeOfSocket() != AF_INET)
+    return;
+  int on = 1;
+  if (setsockopt(fd, SOL_SOCKET, SO_ZEROCOPY, &on, sizeof(on)) == 0) {
+    zerocopy = true;
+  } else if (!zerocopy_warned) {
+    zerocopy_warned = true;
+    std::cerr << std::format("Zero copy sends unavailable for tag {}: {}\n",
+                             config->tag, std::strerror(errno));
+  }
+}
+
+void SocketOutput::reapZerocopy(size_t keep) {
+  while (!zerocopy_pending.empty()) {
+    char control[CMSG_SPACE(sizeof(sock_extended_err)) * 4];
+    msghdr msg{};
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    if (recvmsg(fd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0) {
+      if (errno == EINTR)
+        continue;
+      if (errno != EAGAIN || zerocopy_pending.size() <= keep)
+        break;
+      // The error queue always reports as POLLERR
+      pollfd ready{fd, 0, 0};
+      if (poll(&ready, 1, 1000) <= 0)
+        break;
+      continue;
+    }
+
+    for (cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); cmsg;
+         cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+      if (cmsg->cmsg_level != SOL_IP || cmsg->cmsg_type != IP_RECVERR)
+        continue;
+      auto *error = reinterpret_cast<sock_extended_err *>(CMSG_DATA(cmsg));
+      if (error->ee_errno != 0 || error->ee_origin != SO_EE_ORIGIN_ZEROCOPY)
+        continue;
+      // Sends `[ee_info, ee_data]` completed, TCP completes them in order
+      zerocopy_done = error->ee_data + 1;
+      if (error->ee_code & SO_EE_CODE_ZEROCOPY_COPIED) {
+        zerocopy_copied->fetch_add(error->ee_data - error->ee_info + 1,
+                                   std::memory_order_relaxed);
+      }
+    }
+
+    while (!zerocopy_pending.empty() &&
+           static_cast<int32_t>(zerocopy_done -
+                                zerocopy_pending.front().first) > 0) {
+      std::string &pending = zerocopy_pending.front().second;
+      zerocopy_memory.set(zerocopy_memory.get() - pending.size());
+      if (spare_batches.size() < ZEROCOPY_PENDING) {
+        pending.clear();
+        spare_batches.push_back(std::move(pending));
+      }
+      zerocopy_pending.pop_front();
+    }
+  }
+}
+
+void SocketOutput::connectOutput() {
+  std::chrono::milliseconds backoff(100);
+  for (uint32_t attempt = 1;; ++attempt) {
+    struct sockaddr_storage addr;
+    socklen_t len = config->constructSock(&addr);
+    fd = socket(config->getTypeOfSocket(), SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd >= 0) {
+      apply_socket_options(fd, config->socket_options,
+                           config->getTypeOfSocket() == AF_INET, config->tag);
+    }
+    if (fd >= 0 && len != 0 &&
+        connect(fd, (struct sockaddr *)&addr, len) == 0) {
+      if (!tls_context)
+        return;
+      tls = std::make_unique<TlsSession>(*tls_context, fd);
+      if (tls->handshake() == TlsSession::Handshake::Done) {
+        if (!tls->kernelTx()) {
+          std::cerr << std::format(
+              "kTLS unavailable for tag {}, encrypting in user space\n",
+              config->tag);
+        }
+        return;
+      }
+      std::cerr << std::format("TLS handshake failed for tag {}\n",
+                               config->tag);
+      tls.reset();
+    } else {
+      std::cerr << std::format("Couldn't connect to tag {} {}\n", config->tag,
+                               std::strerror(errno));
+    }
+
+    if (fd >= 0)
+      close(fd);
+    fd = -1;
+    DISLOG_PROBE(reconnect, config->tag.c_str(), attempt, backoff.count());
+    std::this_thread::sleep_for(backoff);
+    backoff = std::min(backoff * 2, std::chrono::milliseconds(5000));
+  }
+}
+
+void SocketOutput::run() {
+  apply_affinity(config->affinity, config->tag);
+
+  if (const TlsConfig *tls_config = config->getTls()) {
+    try {
+      tls_context = std::make_unique<TlsContext>(*tls_config, false,
+                                                 config->tag);
+    } catch (std::exception &e) {
+      std::cerr << e.what() << '\n';
+      return;
+    }
+  }
+
+  connectOutput();
+  enableZerocopy();
+  while (true) {
+    if (zerocopy)
+      reapZerocopy(ZEROCOPY_PENDING);
+    if (batch.empty()) {
+      std::unique_lock<std::mutex> guard(lock);
+      wakeup.wait(guard, [&] { return !active.empty(); });
+      fillBatch();
+    }
+
+    if (!writeBatch()) {
+      tls.reset();
+      close(fd);
+      connectOutput();
+      enableZerocopy();
+    }
+  }
+}
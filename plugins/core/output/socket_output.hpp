@@ -0,0 +1,285 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <columnar/columnar_encoder.hpp>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <memory/memory_governor.hpp>
+#include <mutex>
+#include <output/output.hpp>
+#include <shm/shm_queue.hpp>
+#include <source/source.hpp>
+#include <stats/stats.hpp>
+#include <string>
+#include <sys/uio.h>
+#include <tls/tls_session.hpp>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief A `UNIX_SOCK` or `IPv4` output shared by every input routed to it
+ * @details Every input gets a lane (a queue of its own). A writer thread owns
+ *          the connection and drains the lanes with deficit round robin: on
+ *          each turn a lane earns `QUANTUM * weight` bytes of credit and sends
+ *          whole chunks while the credit lasts. A saturated output is thus
+ *          shared by weight and a high priority input never waits behind the
+ *          backlog of a bulk one. Chunks are never split so records of
+ *          different inputs don't interleave on the wire.
+ *
+ *          Queued chunks are charged to the `MemoryGovernor`. Under spill
+ *          pressure new chunks of a lane are handed to the spill thread of
+ *          the output instead, which appends them to a file of the lane and
+ *          reads them back once its queue in memory has drained. Inputs never
+ *          wait for the disk, a lane only holds up to `lane_queue_bytes` not
+ *          written out yet. Under shed pressure new chunks are dropped.
+ *
+ *          With `zerocopy` set, large batches are sent with `MSG_ZEROCOPY`.
+ *          The kernel then reads the batch until the peer acknowledged it,
+ *          so a written batch is set aside until the completion shows up on
+ *          the error queue of the socket and the next one is filled in a
+ *          spare buffer.
+ *
+ *          A `columnar` output encodes each batch into a frame just before
+ *          writing it. A frame cut short by a broken connection is sent
+ *          again in full on the next one.
+ *
+ *          With `metadata_header` set, every chunk goes out behind a line
+ *          naming where it came from:
+ *
+ *              @dislog core=<core> input=<input> peer=<peer> received=<ns> bytes=<n>
+ *
+ *          followed by the `n` bytes of records. The part up to the peer is
+ *          formatted once per stream when it is opened, the rest per chunk,
+ *          and both go out as iovecs of their own next to the records so the
+ *          batch is never copied to make room for them. Only TLS without
+ *          kernel offload (kTLS) copies them into one buffer. `received` is the
+ *          wall clock in nanoseconds when the input handed the chunk over,
+ *          right after reading it.
+ *
+ *          With `persistent_queues` set, every lane queues its chunks in a
+ *          `shm::Queue` named `/dislog-<output>-<input>[-<kind>]` instead of
+ *          the heap.
+ *          A chunk leaves the queue once it was written, so a core which
+ *          restarts after a crash or an upgrade sends what the previous one
+ *          left, the batch in flight possibly twice. Spill files are not
+ *          kept, neither are the peers of the chunks: they come back with the
+ *          metadata header of the core's own records.
+ */
+class SocketOutput : public Output {
+public:
+  using Clock = std::chrono::steady_clock;
+
+  /// Credit a lane of weight 1 earns per turn
+  static constexpr size_t QUANTUM = 16 * 1024;
+
+  /// Batches waiting for their zero copy completion before the writer waits
+  static constexpr size_t ZEROCOPY_PENDING = 8;
+
+  /**
+   * @brief Create the output, start its writer thread and register it as the
+   *        shared output of the tag
+   * @note Call before the services start, the registry isn't locked
+   *
+   * @param[in] config The output block
+   */
+  static void start(Source &config);
+
+  int openLane(const std::string &input, const std::string &kind,
+               uint32_t weight) override;
+
+  void send(int lane, const std::string &origin, uint32_t stream,
+            std::string_view data, const Trace *trace) override;
+
+  void openStream(uint32_t stream, const Session &session) override;
+
+  void closeStream(uint32_t stream) override;
+
+private:
+  struct Chunk {
+    size_t size;
+    Clock::time_point enqueued;
+    /// Set (`trace.latency` non null) for sampled batches
+    Trace trace;
+    /// Start of the metadata header, for `metadata_header` outputs
+    std::shared_ptr<const std::string> header;
+    /// Wall clock nanoseconds when the chunk was handed over
+    int64_t received_ns = 0;
+  };
+
+  struct Lane {
+    int id;
+    uint32_t weight;
+    /// Queued chunks back to back, the first `head` bytes are already sent
+    std::string buf;
+    size_t head = 0;
+    std::deque<Chunk> chunks;
+    size_t queued = 0;
+    size_t deficit = 0;
+    bool active = false;
+    /// Bytes of `chunks` charged to the governor
+    MemoryAccount memory;
+
+    /// Chunks for the spill thread to write out, each a `SpillHeader` and
+    /// its bytes
+    std::string spill_pending;
+    MemoryAccount spill_memory;
+    /// Bytes of `spill_pending` and of the spill file not read back yet. New
+    /// chunks are spilled while there are any, so they stay in order
+    uint64_t spilled = 0;
+
+    // Owned by the spill thread
+    /// Chunks spilled to disk, `[spill_read, spill_write)` is still to send
+    int spill_fd = -1;
+    uint64_t spill_read = 0;
+    uint64_t spill_write = 0;
+
+    /// Metadata header of the records the core generates (stream 0)
+    std::shared_ptr<const std::string> header;
+
+    /// Holds the chunks instead of `buf`, for `persistent_queues` outputs
+    std::unique_ptr<shm::Queue> queue;
+
+    std::atomic<uint64_t> *queued_bytes;
+    std::atomic<uint64_t> *spilled_bytes;
+    std::atomic<uint64_t> *dropped_bytes;
+    std::atomic<uint64_t> *written_bytes;
+    Histogram *latency;
+  };
+
+  explicit SocketOutput(Source &config);
+
+  /**
+   * @brief Body of the writer thread
+   */
+  void run();
+
+  /**
+   * @brief Connect (and handshake) with backoff until it works
+   */
+  void connectOutput();
+
+  /**
+   * @brief Move whole chunks from the lanes into `batch`, in DRR order
+   * @note Call with `lock` held
+   */
+  void fillBatch();
+
+  /**
+   * @brief Body of the spill thread, only started with a `spill_dir`
+   */
+  void runSpill();
+
+  /**
+   * @brief Append chunks taken from `spill_pending` to the spill file
+   * @note Call from the spill thread without `lock`
+   */
+  void spill(Lane &lane, std::string_view data);
+
+  /**
+   * @brief Read about a turn's worth of spilled chunks back into the queue
+   * @note Call from the spill thread without `lock`, with the queue of the
+   *       lane empty
+   */
+  void unspill(Lane &lane);
+
+  /**
+   * @brief Count spilled chunks which are lost as dropped
+   * @note Call with `lock` held
+   *
+   * @param[in] data Chunks as in a spill file
+   */
+  void dropSpilled(Lane &lane, std::string_view data);
+
+  /**
+   * @brief Write `batch` out
+   *
+   * @return False if the connection broke
+   */
+  bool writeBatch();
+
+  /**
+   * @brief Write `batch` out with the metadata header of every chunk
+   *
+   * @return Bytes of `batch` taken by the chunks which were sent in full
+   */
+  size_t writeWithHeaders();
+
+  /**
+   * @brief Metadata header of a stream
+   * @note Call with `lock` held
+   */
+  std::shared_ptr<const std::string> streamHeader(const Lane &lane,
+                                                  uint32_t stream) const;
+
+  /**
+   * @brief Turn `MSG_ZEROCOPY` on for a new connection if configured
+   * @details Batches pending on the previous connection are let go, its
+   *          socket is closed and never sends them again
+   */
+  void enableZerocopy();
+
+  /**
+   * @brief Let go of the batches whose zero copy sends completed
+   *
+   * @param[in] keep Wait for completions while more batches than this are
+   *                 pending
+   */
+  void reapZerocopy(size_t keep);
+
+  std::unique_ptr<Source> config;
+
+  // Owned by the spill thread
+  std::string spill_buf;
+
+  // Shared with the inputs
+  std::mutex lock;
+  std::condition_variable wakeup;
+  std::vector<std::unique_ptr<Lane>> lanes;
+  /// Lanes with queued chunks, in DRR order
+  std::deque<int> active;
+  /// Spill files can't be created, don't retry on every chunk
+  bool spill_broken = false;
+  /// Lanes have chunks to spill or to read back
+  std::condition_variable spill_wakeup;
+  bool spill_work = false;
+  /// Metadata headers of the open streams, for `metadata_header` outputs
+  std::unordered_map<uint32_t, std::shared_ptr<const std::string>> sessions;
+
+  // Owned by the writer thread
+  int fd = -1;
+  std::unique_ptr<TlsContext> tls_context;
+  std::unique_ptr<TlsSession> tls;
+  std::string batch;
+  MemoryAccount batch_memory;
+  /// Lane of every chunk in `batch`
+  std::vector<std::pair<Lane *, Chunk>> batch_chunks;
+
+  /// Per chunk part of the metadata headers, the iovecs of the batch and
+  /// the size of every chunk on the wire
+  std::string header_tails;
+  std::vector<iovec> iov;
+  std::vector<size_t> wire_sizes;
+  /// The batch with its headers, for TLS in user space which can't take
+  /// iovecs
+  std::string staged;
+
+  /// `batch` as a columnar frame, for `columnar` outputs
+  std::string frame;
+  ColumnarEncoder encoder;
+
+  /// `MSG_ZEROCOPY` is on for the current connection
+  bool zerocopy = false;
+  bool zerocopy_warned = false;
+  /// Zero copy sends made and completed on the current connection
+  uint32_t zerocopy_sent = 0;
+  uint32_t zerocopy_done = 0;
+  /// Written batches the kernel may still read, with their last send
+  std::deque<std::pair<uint32_t, std::string>> zerocopy_pending;
+  std::vector<std::string> spare_batches;
+  MemoryAccount zerocopy_memory;
+  std::atomic<uint64_t> *zerocopy_sends;
+  std::atomic<uint64_t> *zerocopy_copied;
+};
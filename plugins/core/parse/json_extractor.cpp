@@ -0,0 +1,205 @@
+#include "json_extractor.hpp"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define DISLOG_HAVE_SSE2 1
+#endif
+
+static constexpr size_t NOT_FOUND = std::string_view::npos;
+
+static bool is_space(char c) {
+  return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+static size_t skip_space(const char *text, size_t pos, size_t len) {
+  while (pos < len && is_space(text[pos]))
+    ++pos;
+  return pos;
+}
+
+/**
+ * @brief Position of the first `"` or `\` at or after `pos`
+ *
+ * @return The position or `len` if there is none
+ */
+static size_t find_quote(const char *text, size_t pos, size_t len) {
+#ifdef DISLOG_HAVE_SSE2
+  const __m128i quote = _mm_set1_epi8('"');
+  const __m128i backslash = _mm_set1_epi8('\\');
+  while (pos + 16 <= len) {
+    __m128i chunk = _mm_loadu_si128((const __m128i *)(text + pos));
+    __m128i hit = _mm_or_si128(_mm_cmpeq_epi8(chunk, quote),
+                               _mm_cmpeq_epi8(chunk, backslash));
+    uint32_t mask = _mm_movemask_epi8(hit);
+    if (mask != 0)
+      return pos + __builtin_ctz(mask);
+    pos += 16;
+  }
+#endif
+  while (pos < len && text[pos] != '"' && text[pos] != '\\')
+    ++pos;
+  return pos;
+}
+
+/**
+ * @brief Position of the first `"`, `{`, `}`, `[` or `]` at or after `pos`
+ * @details Setting bit 5 turns `[` into `{` and `]` into `}`, and no other
+ *          byte into either, so two compares find all four brackets
+ *
+ * @return The position or `len` if there is none
+ */
+static size_t find_nesting(const char *text, size_t pos, size_t len) {
+#ifdef DISLOG_HAVE_SSE2
+  const __m128i quote = _mm_set1_epi8('"');
+  const __m128i open = _mm_set1_epi8('{');
+  const __m128i close = _mm_set1_epi8('}');
+  const __m128i fold = _mm_set1_epi8(0x20);
+  while (pos + 16 <= len) {
+    __m128i chunk = _mm_loadu_si128((const __m128i *)(text + pos));
+    __m128i folded = _mm_or_si128(chunk, fold);
+    __m128i hit = _mm_or_si128(
+        _mm_cmpeq_epi8(chunk, quote),
+        _mm_or_si128(_mm_cmpeq_epi8(folded, open),
+                     _mm_cmpeq_epi8(folded, close)));
+    uint32_t mask = _mm_movemask_epi8(hit);
+    if (mask != 0)
+      return pos + __builtin_ctz(mask);
+    pos += 16;
+  }
+#endif
+  for (; pos < len; ++pos) {
+    char folded = text[pos] | 0x20;
+    if (text[pos] == '"' || folded == '{' || folded == '}')
+      break;
+  }
+  return pos;
+}
+
+/**
+ * @brief End of the string whose opening quote is just before `pos`
+ *
+ * @return Position of the closing quote, `NOT_FOUND` if unterminated
+ */
+static size_t skip_string(const char *text, size_t pos, size_t len) {
+  while (true) {
+    pos = find_quote(text, pos, len);
+    if (pos >= len)
+      return NOT_FOUND;
+    if (text[pos] == '"')
+      return pos;
+    pos += 2; // Skip the escaped character
+  }
+}
+
+/**
+ * @brief End of the object or array which starts at `pos`
+ * @note Mismatched brackets aren't noticed, only the depth is tracked
+ *
+ * @return Position just past the closing bracket, `NOT_FOUND` if unterminated
+ */
+static size_t skip_nested(const char *text, size_t pos, size_t len) {
+  size_t depth = 0;
+  while (true) {
+    pos = find_nesting(text, pos, len);
+    if (pos >= len)
+      return NOT_FOUND;
+    char c = text[pos];
+    if (c == '"') {
+      pos = skip_string(text, pos + 1, len);
+      if (pos == NOT_FOUND)
+        return NOT_FOUND;
+    } else if (c == '{' || c == '[') {
+      ++depth;
+    } else if (--depth == 0) {
+      return pos + 1;
+    }
+    ++pos;
+  }
+}
+
+JsonExtractor::JsonExtractor(const std::vector<std::string> &keys)
+    : keys(keys) {}
+
+bool JsonExtractor::extract(std::string_view line, JsonFields &out) const {
+  out.valid = false;
+  out.values.fill({});
+  auto fail = [&] {
+    out.values.fill({});
+    return false;
+  };
+
+  const char *text = line.data();
+  size_t len = line.size();
+  size_t pos = skip_space(text, 0, len);
+  if (pos >= len || text[pos] != '{')
+    return false;
+
+  size_t missing = keys.size();
+  pos = skip_space(text, pos + 1, len);
+  if (missing == 0 || (pos < len && text[pos] == '}')) {
+    out.valid = true;
+    return true;
+  }
+
+  while (true) {
+    if (pos >= len || text[pos] != '"')
+      return fail();
+    size_t key_end = skip_string(text, pos + 1, len);
+    if (key_end == NOT_FOUND)
+      return fail();
+    std::string_view key(text + pos + 1, key_end - pos - 1);
+
+    pos = skip_space(text, key_end + 1, len);
+    if (pos >= len || text[pos] != ':')
+      return fail();
+    pos = skip_space(text, pos + 1, len);
+    if (pos >= len)
+      return fail();
+
+    std::string_view value;
+    size_t start = pos;
+    if (text[pos] == '"') {
+      size_t end = skip_string(text, pos + 1, len);
+      if (end == NOT_FOUND)
+        return fail();
+      value = std::string_view(text + start + 1, end - start - 1);
+      pos = end + 1;
+    } else if (text[pos] == '{' || text[pos] == '[') {
+      pos = skip_nested(text, pos, len);
+      if (pos == NOT_FOUND)
+        return fail();
+      value = std::string_view(text + start, pos - start);
+    } else {
+      // Numbers, `true`, `false` and `null`
+      while (pos < len && text[pos] != ',' && text[pos] != '}' &&
+             !is_space(text[pos]))
+        ++pos;
+      if (pos == start)
+        return fail();
+      value = std::string_view(text + start, pos - start);
+    }
+
+    // The first occurrence of a key wins
+    for (size_t i = 0; i < keys.size(); ++i) {
+      if (out.values[i].data() == nullptr && keys[i] == key) {
+        out.values[i] = value;
+        if (--missing == 0) {
+          out.valid = true;
+          return true;
+        }
+        break;
+      }
+    }
+
+    pos = skip_space(text, pos, len);
+    if (pos >= len)
+      return fail();
+    if (text[pos] == '}') {
+      out.valid = true;
+      return true;
+    }
+    if (text[pos] != ',')
+      return fail();
+    pos = skip_space(text, pos + 1, len);
+  }
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * @brief Values of the configured keys of a JSON line
+ * @details Every value is a view into the line that was scanned, nothing is
+ *          copied. String values are given without their quotes and with
+ *          their escapes left as they are, other values (numbers, `true`,
+ *          objects, ...) as their JSON text. Keys missing from the line are
+ *          empty.
+ */
+struct JsonFields {
+  /// Most keys an input can extract
+  static constexpr size_t MAX_KEYS = 8;
+
+  /// False when the line is not a JSON object. The values are then unset
+  bool valid = false;
+
+  /// In the order of the `json_keys` of the input
+  std::array<std::string_view, MAX_KEYS> values{};
+};
+
+/**
+ * @brief Finds the values of a few top level keys in JSON lines
+ * @details An on demand scan, no DOM is built: the top level object is
+ *          walked key by key, nested values and strings are skipped with
+ *          SIMD scans for the bytes which can end them, and the scan stops
+ *          once every key has been found. Only as much of the line is
+ *          validated as is walked.
+ */
+class JsonExtractor {
+public:
+  /**
+   * @brief Set the keys to look for
+   *
+   * @param[in] keys Top level keys, at most `JsonFields::MAX_KEYS`, compared
+   *            with the raw (escaped) text of the keys in the lines
+   */
+  explicit JsonExtractor(const std::vector<std::string> &keys);
+
+  /**
+   * @brief Find the keys in a line
+   * @note Never allocates, thread safe
+   *
+   * @param[in] line One record, a trailing `\n` / `\r\n` is ignored
+   * @param[out] out Populated on success
+   * @return True if the line is a JSON object, as far as it was scanned
+   */
+  bool extract(std::string_view line, JsonFields &out) const;
+
+private:
+  std::vector<std::string> keys;
+};
@@ -0,0 +1,197 @@
+#include "syslog_parser.hpp"
+
+static bool is_digit(char c) { return c >= '0' && c <= '9'; }
+
+/**
+ * @brief Consume a token terminated by a space (or the end of the line)
+ *
+ * @param[in,out] rest Remaining line, the token and the space are removed
+ * @return The token
+ */
+static std::string_view next_token(std::string_view &rest) {
+  size_t end = rest.find(' ');
+  std::string_view token = rest.substr(0, end);
+  rest = end == std::string_view::npos ? std::string_view() : rest.substr(end + 1);
+  return token;
+}
+
+/**
+ * @brief RFC 5424 uses `-` for a missing value
+ */
+static std::string_view nil_to_empty(std::string_view value) {
+  return value == "-" ? std::string_view() : value;
+}
+
+/**
+ * @brief Parse `<PRI>`
+ *
+ * @param[in,out] rest Remaining line, the PRI is removed on success
+ * @return PRI value or -1 if there is none
+ */
+static int parse_pri(std::string_view &rest) {
+  if (rest.size() < 3 || rest[0] != '<')
+    return -1;
+
+  int pri = 0;
+  size_t pos = 1;
+  for (; pos < rest.size() && pos <= 3 && is_digit(rest[pos]); ++pos)
+    pri = pri * 10 + (rest[pos] - '0');
+
+  if (pos == 1 || pos >= rest.size() || rest[pos] != '>' || pri > 191)
+    return -1;
+  rest.remove_prefix(pos + 1);
+  return pri;
+}
+
+/**
+ * @brief Length of the `STRUCTURED-DATA` field at the start of `rest`
+ *
+ * @return Length or 0 if malformed
+ */
+static size_t structured_data_length(std::string_view rest) {
+  if (rest.starts_with('-'))
+    return 1;
+
+  size_t pos = 0;
+  while (pos < rest.size() && rest[pos] == '[') {
+    bool quoted = false;
+    for (++pos; pos < rest.size(); ++pos) {
+      char c = rest[pos];
+      if (quoted && c == '\\') {
+        ++pos; // Skip the escaped character
+      } else if (c == '"') {
+        quoted = !quoted;
+      } else if (!quoted && c == ']') {
+        break;
+      }
+    }
+    if (pos >= rest.size())
+      return 0; // Unterminated element
+    ++pos;
+  }
+  return pos;
+}
+
+static bool parse_rfc5424(std::string_view rest, SyslogRecord &out) {
+  out.version = 1;
+  out.timestamp = nil_to_empty(next_token(rest));
+  out.hostname = nil_to_empty(next_token(rest));
+  out.app_name = nil_to_empty(next_token(rest));
+  out.procid = nil_to_empty(next_token(rest));
+  out.msgid = nil_to_empty(next_token(rest));
+
+  size_t sd_len = structured_data_length(rest);
+  if (sd_len == 0)
+    return false;
+  out.structured_data = nil_to_empty(rest.substr(0, sd_len));
+  rest.remove_prefix(sd_len);
+
+  if (!rest.empty()) {
+    if (rest[0] != ' ')
+      return false;
+    rest.remove_prefix(1);
+  }
+  // Drop the UTF-8 BOM the RFC allows in front of MSG
+  if (rest.starts_with("\xEF\xBB\xBF"))
+    rest.remove_prefix(3);
+  out.msg = rest;
+  return true;
+}
+
+/**
+ * @brief Is `rest` starting with a `Mmm dd hh:mm:ss` timestamp
+ */
+static bool is_bsd_timestamp(std::string_view rest) {
+  return rest.size() >= 16 && rest[3] == ' ' && rest[6] == ' ' &&
+         rest[9] == ':' && rest[12] == ':' && rest[15] == ' ' &&
+         (rest[4] == ' ' || is_digit(rest[4])) && is_digit(rest[5]) &&
+         is_digit(rest[7]) && is_digit(rest[8]) && is_digit(rest[10]) &&
+         is_digit(rest[11]) && is_digit(rest[13]) && is_digit(rest[14]);
+}
+
+/**
+ * @brief Is `rest` starting with an RFC 3339 timestamp, as written by
+ *        rsyslog and journald with high precision timestamps enabled
+ */
+static bool is_rfc3339_timestamp(std::string_view rest) {
+  return rest.size() >= 20 && is_digit(rest[0]) && is_digit(rest[1]) &&
+         is_digit(rest[2]) && is_digit(rest[3]) && rest[4] == '-' &&
+         rest[7] == '-' && rest[10] == 'T';
+}
+
+static bool parse_rfc3164(std::string_view rest, SyslogRecord &out) {
+  out.version = 0;
+  if (is_bsd_timestamp(rest)) {
+    out.timestamp = rest.substr(0, 15);
+    rest.remove_prefix(16);
+  } else if (is_rfc3339_timestamp(rest)) {
+    out.timestamp = next_token(rest);
+  } else {
+    return false;
+  }
+
+  out.hostname = next_token(rest);
+  if (out.hostname.empty())
+    return false;
+
+  // TAG[PID]: MSG, the tag is optional
+  size_t tag_end = rest.find_first_of("[: ");
+  if (tag_end != std::string_view::npos && rest[tag_end] != ' ' &&
+      tag_end > 0) {
+    std::string_view tag = rest.substr(0, tag_end);
+    std::string_view after = rest.substr(tag_end);
+    std::string_view procid;
+    if (after[0] == '[') {
+      size_t close = after.find(']');
+      if (close == std::string_view::npos) {
+        out.msg = rest;
+        return true;
+      }
+      procid = after.substr(1, close - 1);
+      after.remove_prefix(close + 1);
+    }
+    if (after.starts_with(':')) {
+      after.remove_prefix(1);
+      if (after.starts_with(' '))
+        after.remove_prefix(1);
+      out.app_name = tag;
+      out.procid = procid;
+      out.msg = after;
+      return true;
+    }
+  }
+
+  out.msg = rest;
+  return true;
+}
+
+bool parse_syslog(std::string_view line, SyslogRecord &out) {
+  out = SyslogRecord();
+
+  if (line.ends_with('\n'))
+    line.remove_suffix(1);
+  if (line.ends_with('\r'))
+    line.remove_suffix(1);
+
+  std::string_view rest = line;
+  int pri = parse_pri(rest);
+  if (pri >= 0) {
+    out.facility = pri >> 3;
+    out.severity = pri & 7;
+  }
+
+  bool ok;
+  if (pri >= 0 && rest.size() >= 2 && is_digit(rest[0]) && rest[1] == ' ') {
+    rest.remove_prefix(2);
+    ok = parse_rfc5424(rest, out);
+  } else {
+    ok = parse_rfc3164(rest, out);
+  }
+
+  if (!ok) {
+    out = SyslogRecord();
+    return false;
+  }
+  out.valid = true;
+  return true;
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+
+/**
+ * @brief Header fields of a syslog line
+ * @details Every field is a view into the line that was parsed, nothing is
+ *          copied. Fields missing from the line are empty.
+ */
+struct SyslogRecord {
+  /// False when the line is not syslog. The other fields are then unset
+  bool valid = false;
+
+  /// 0 for RFC 3164 (BSD) lines, 1 for RFC 5424 lines
+  uint8_t version = 0;
+
+  /// -1 when the line carries no `<PRI>` (e.g. lines read back from a file)
+  int16_t facility = -1;
+  int16_t severity = -1;
+
+  std::string_view timestamp;
+  std::string_view hostname;
+  std::string_view app_name;
+  std::string_view procid;
+  std::string_view msgid;
+  std::string_view structured_data;
+  std::string_view msg;
+};
+
+/**
+ * @brief Decode the header of an RFC 3164 or RFC 5424 line
+ * @note Never allocates
+ *
+ * @param[in] line One record, a trailing `\n` / `\r\n` is ignored
+ * @param[out] out Populated on success
+ * @return True if the line could be parsed
+ */
+bool parse_syslog(std::string_view line, SyslogRecord &out);
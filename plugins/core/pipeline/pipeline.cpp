@@ -0,0 +1,111 @@
+#include "pipeline.hpp"
+
+#include <format>
+#include <stats/stats.hpp>
+
+Pipeline::Pipeline(const Source &input) {
+  if (input.parse == ParseFormat::Json)
+    json.emplace(input.json_keys);
+  if (input.parse != ParseFormat::None) {
+    syslog_stage = input.parse == ParseFormat::Syslog;
+    malformed = &StatsRegistry::instance().counter(
+        "dislog_parse_malformed_records_total",
+        std::format("input=\"{}\"", input.tag));
+  }
+  if (input.filter.enabled())
+    filter.emplace(input.filter, input.tag);
+  for (const TransformPluginConfig &config : input.transform_plugins) {
+    plugins.emplace_back(std::make_unique<TransformPlugin>(config, input.tag),
+                         route_tags.size());
+    route_tags.insert(route_tags.end(), config.routes.begin(),
+                      config.routes.end());
+  }
+  routed_bufs.resize(route_tags.size());
+  if (input.aggregate.enabled)
+    aggregator.emplace(input.aggregate, input.tag);
+  if (input.dedup.enabled)
+    dedup.emplace(input.dedup, input.tag);
+}
+
+bool Pipeline::hasStages() const {
+  return malformed || filter.has_value() || !plugins.empty() ||
+         aggregator.has_value() || dedup.has_value();
+}
+
+void Pipeline::run(std::span<const std::string_view> records,
+                   std::string &out) {
+  batch.clear();
+  prepare(records, batch);
+  finish(batch, out);
+}
+
+void Pipeline::prepare(std::span<const std::string_view> records,
+                       std::vector<Record> &out) const {
+  size_t first = out.size();
+  for (std::string_view raw : records) {
+    if (filter && !filter->keep(raw))
+      continue;
+    out.push_back(Record{raw});
+  }
+
+  if (malformed) {
+    // Malformed lines are forwarded untouched, they just have no fields
+    for (size_t i = first; i < out.size(); ++i) {
+      if (!parse(out[i]))
+        malformed->fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+}
+
+bool Pipeline::parse(Record &record) const {
+  if (syslog_stage)
+    return parse_syslog(record.raw, record.syslog);
+  if (json)
+    return json->extract(record.raw, record.json);
+  return true;
+}
+
+void Pipeline::finish(std::span<const Record> prepared, std::string &out) {
+  if (!plugins.empty()) {
+    staged.assign(prepared.begin(), prepared.end());
+    for (auto &[plugin, offset] : plugins) {
+      plugin->apply(staged,
+                    std::span(routed_bufs).subspan(offset,
+                                                   plugin->routes().size()),
+                    [this](Record &record) { parse(record); });
+    }
+    prepared = staged;
+  }
+
+  auto now = std::chrono::steady_clock::now();
+  for (const Record &record : prepared) {
+    if (aggregator) {
+      aggregator->add(record);
+      if (aggregator->dropsRaw())
+        continue;
+    }
+    if (dedup && !dedup->keep(record, now, out))
+      continue;
+    out.append(record.raw);
+  }
+}
+
+int Pipeline::tick(std::string &out, std::string &summaries) {
+  int timeout = -1;
+  if (dedup) {
+    auto now = std::chrono::steady_clock::now();
+    if (now >= next_tick) {
+      dedup->tick(now, out);
+      next_tick = now + dedup->tickInterval();
+    }
+    auto wait = std::chrono::ceil<std::chrono::milliseconds>(next_tick - now);
+    timeout = static_cast<int>(wait.count());
+  }
+
+  if (aggregator) {
+    int wait = aggregator->tick(Aggregator::Clock::now(), summaries);
+    if (timeout < 0 || wait < timeout)
+      timeout = wait;
+  }
+  return timeout;
+}
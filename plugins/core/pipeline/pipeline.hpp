@@ -0,0 +1,120 @@
+#pragma once
+
+#include <aggregate/aggregator.hpp>
+#include <filter/record_filter.hpp>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <span>
+#include <source/source.hpp>
+#include <string>
+#include <string_view>
+#include <transform/transform_plugin.hpp>
+#include <vector>
+
+#include "record.hpp"
+
+/**
+ * @brief Per input chain of stages run over every framed record
+ * @details Stages are plain members rather than a list of virtual objects so
+ *          a batch of records goes through each stage in a tight loop. The
+ *          stateless stages (parse, filter) are split from the stateful ones
+ *          (aggregate, dedup) so a transform pool can run the former on
+ *          many threads while the latter see every record in stream order.
+ *          Transform plugins keep per input state of their own, they run
+ *          with the stateful stages ahead of aggregation.
+ */
+class Pipeline {
+public:
+  /**
+   * @brief Build the stages configured on the input
+   *
+   * @param[in] input The input source block
+   * @throws std::runtime_error if a transform plugin can't be loaded
+   */
+  explicit Pipeline(const Source &input);
+
+  /**
+   * @brief Does the pipeline need the stream framed into records
+   */
+  bool hasStages() const;
+
+  /**
+   * @brief Run a batch of records through the stages
+   *
+   * @param[in] records Records of one read, each ending with `\n`
+   * @param[out] out Records that survived are appended to it
+   */
+  void run(std::span<const std::string_view> records, std::string &out);
+
+  /**
+   * @brief Run the stateless stages over a batch of records
+   * @note Thread safe
+   *
+   * @param[in] records Records of one read, each ending with `\n`
+   * @param[out] out Records that survived, with what the stages learned
+   */
+  void prepare(std::span<const std::string_view> records,
+               std::vector<Record> &out) const;
+
+  /**
+   * @brief Run the stateful stages over prepared records
+   * @note Not thread safe, call in stream order from the service thread
+   *
+   * @param[in] prepared Records `prepare` let through
+   * @param[out] out Records that survived are appended to it
+   */
+  void finish(std::span<const Record> prepared, std::string &out);
+
+  /**
+   * @brief Do the periodic work of the stages, e.g. flushing summaries
+   *
+   * @param[out] out Records generated by the stages are appended to it
+   * @param[out] summaries Aggregation summaries are appended to it, they
+   *             only go to the output the `aggregate` block names
+   * @return Milliseconds until `tick` should be called again, -1 if never
+   */
+  int tick(std::string &out, std::string &summaries);
+
+  /**
+   * @brief Output tags the transform plugins route records to
+   */
+  const std::vector<std::string> &routeTags() const { return route_tags; }
+
+  /**
+   * @brief Records the transform plugins routed away from the outputs of the
+   *        input, one buffer per entry of `routeTags()`
+   * @note The caller sends and clears them after `run` or `finish`
+   */
+  std::vector<std::string> &routed() { return routed_bufs; }
+
+private:
+  /**
+   * @brief Run the parse stage over one record
+   *
+   * @return False if the record is malformed
+   */
+  bool parse(Record &record) const;
+
+  /// Reused for every batch so the steady state doesn't allocate
+  std::vector<Record> batch;
+
+  bool syslog_stage = false;
+  std::optional<JsonExtractor> json;
+  std::atomic<uint64_t> *malformed = nullptr;
+
+  std::optional<RecordFilter> filter;
+
+  /// Plugins in config order, each with the offset of its routes
+  std::vector<std::pair<std::unique_ptr<TransformPlugin>, size_t>> plugins;
+  std::vector<std::string> route_tags;
+  std::vector<std::string> routed_bufs;
+  /// What the plugins let through, rewritten records point into them
+  std::vector<Record> staged;
+
+  std::optional<Aggregator> aggregator;
+
+  std::optional<Deduplicator> dedup;
+  std::chrono::steady_clock::time_point next_tick;
+};
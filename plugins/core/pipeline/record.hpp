@@ -0,0 +1,21 @@
+#pragma once
+
+#include <parse/json_extractor.hpp>
+#include <parse/syslog_parser.hpp>
+#include <string_view>
+
+/**
+ * @brief A framed record and whatever the stages learned about it
+ * @details `raw` points into the receive buffer (or the framer's buffer for a
+ *          record that spanned reads). The parsed fields point into `raw`.
+ */
+struct Record {
+  /// The record as received, including its `\n`
+  std::string_view raw;
+
+  /// Filled by the `syslog` parse stage
+  SyslogRecord syslog;
+
+  /// Filled by the `json` parse stage
+  JsonFields json;
+};
@@ -0,0 +1,112 @@
+#include "rate_limiter.hpp"
+
+#include <algorithm>
+#include <format>
+#include <stats/stats.hpp>
+
+TokenBucket::TokenBucket(double rate, double burst)
+    : rate(rate), burst(std::max(burst, 1.0)), tokens(this->burst),
+      last(Clock::now()) {}
+
+void TokenBucket::refill(Clock::time_point now) {
+  if (unlimited())
+    return;
+
+  std::chrono::duration<double> elapsed = now - last;
+  last = now;
+  tokens = std::min(burst, tokens + elapsed.count() * rate);
+}
+
+void TokenBucket::consume(double amount) {
+  if (!unlimited())
+    tokens -= amount;
+}
+
+TokenBucket::Clock::duration TokenBucket::timeUntilPositive() const {
+  if (unlimited() || tokens >= 0)
+    return Clock::duration::zero();
+
+  std::chrono::duration<double> wait(-tokens / rate);
+  return std::chrono::duration_cast<Clock::duration>(wait);
+}
+
+RateLimiter::RateLimiter(const RateLimitConfig &config, const std::string &tag)
+    : config(config), input(makeBuckets(config.input)),
+      dropped_records(StatsRegistry::instance().counter(
+          "dislog_ratelimit_dropped_records_total",
+          std::format("input=\"{}\"", tag))),
+      dropped_bytes(StatsRegistry::instance().counter(
+          "dislog_ratelimit_dropped_bytes_total",
+          std::format("input=\"{}\"", tag))),
+      sampled_records(StatsRegistry::instance().counter(
+          "dislog_ratelimit_sampled_records_total",
+          std::format("input=\"{}\"", tag))),
+      delayed_reads(StatsRegistry::instance().counter(
+          "dislog_ratelimit_delayed_reads_total",
+          std::format("input=\"{}\"", tag))) {}
+
+RateLimiter::Buckets RateLimiter::makeBuckets(const BucketRates &rates) const {
+  Buckets buckets;
+  buckets.bytes =
+      TokenBucket(rates.bytes_per_sec, rates.bytes_per_sec * config.burst_seconds);
+  buckets.records = TokenBucket(rates.records_per_sec,
+                                rates.records_per_sec * config.burst_seconds);
+  return buckets;
+}
+
+void RateLimiter::addClient(int fd) { clients[fd] = makeBuckets(config.client); }
+
+void RateLimiter::removeClient(int fd) { clients.erase(fd); }
+
+RateLimiter::Clock::duration RateLimiter::readDelay(int fd,
+                                                    Clock::time_point now) {
+  Buckets &client = clients[fd];
+  input.bytes.refill(now);
+  input.records.refill(now);
+  client.bytes.refill(now);
+  client.records.refill(now);
+
+  Clock::duration wait = std::max({input.bytes.timeUntilPositive(),
+                                   input.records.timeUntilPositive(),
+                                   client.bytes.timeUntilPositive(),
+                                   client.records.timeUntilPositive()});
+  if (wait > Clock::duration::zero())
+    delayed_reads.fetch_add(1, std::memory_order_relaxed);
+  return wait;
+}
+
+void RateLimiter::chargeRead(int fd, size_t bytes, size_t records) {
+  Buckets &client = clients[fd];
+  input.bytes.consume(bytes);
+  input.records.consume(records);
+  client.bytes.consume(bytes);
+  client.records.consume(records);
+}
+
+bool RateLimiter::admitRecord(int fd, size_t bytes, Clock::time_point now) {
+  Buckets &client = clients[fd];
+  input.bytes.refill(now);
+  input.records.refill(now);
+  client.bytes.refill(now);
+  client.records.refill(now);
+
+  if (input.bytes.has(bytes) && input.records.has(1) &&
+      client.bytes.has(bytes) && client.records.has(1)) {
+    input.bytes.consume(bytes);
+    input.records.consume(1);
+    client.bytes.consume(bytes);
+    client.records.consume(1);
+    return true;
+  }
+
+  // Over the limit
+  if (config.policy == OverLimitPolicy::Sample &&
+      client.over_limit_seen++ % config.sample_n == 0) {
+    sampled_records.fetch_add(1, std::memory_order_relaxed);
+    return true;
+  }
+
+  dropped_records.fetch_add(1, std::memory_order_relaxed);
+  dropped_bytes.fetch_add(bytes, std::memory_order_relaxed);
+  return false;
+}
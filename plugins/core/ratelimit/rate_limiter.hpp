@@ -0,0 +1,171 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+
+/**
+ * @brief What to do with traffic once a bucket runs dry
+ */
+enum class OverLimitPolicy {
+  /// Stop reading the client until tokens are available (backpressure)
+  Delay,
+  /// Discard over limit records
+  Drop,
+  /// Forward one in every `sample_n` over limit records
+  Sample,
+};
+
+/**
+ * @brief Refill rates of a pair of buckets. 0 means unlimited
+ */
+struct BucketRates {
+  double bytes_per_sec = 0;
+  double records_per_sec = 0;
+};
+
+/**
+ * @brief `rate_limit` block of an input source
+ */
+struct RateLimitConfig {
+  bool enabled = false;
+
+  /// Shared by every client of the input
+  BucketRates input;
+
+  /// Applied to each client connection separately
+  BucketRates client;
+
+  /// Bucket capacity expressed in seconds worth of refill
+  double burst_seconds = 1.0;
+
+  OverLimitPolicy policy = OverLimitPolicy::Delay;
+
+  /// Only used with `OverLimitPolicy::Sample`
+  uint32_t sample_n = 100;
+};
+
+/**
+ * @brief Classic token bucket
+ * @note Not thread safe, each bucket is owned by a single service thread
+ */
+class TokenBucket {
+public:
+  using Clock = std::chrono::steady_clock;
+
+  /**
+   * @brief Construct an unlimited bucket
+   */
+  TokenBucket() = default;
+
+  /**
+   * @brief Construct a bucket which starts full
+   *
+   * @param[in] rate Tokens added per second. 0 means unlimited
+   * @param[in] burst Capacity of the bucket
+   */
+  TokenBucket(double rate, double burst);
+
+  bool unlimited() const { return rate <= 0; }
+
+  /**
+   * @brief Add the tokens accumulated since the last refill
+   */
+  void refill(Clock::time_point now);
+
+  /**
+   * @brief Can `amount` tokens be taken right now
+   * @details A full bucket can give any amount, going into debt for what
+   *          it lacks, else an amount above its capacity would never pass
+   */
+  bool has(double amount) const {
+    return unlimited() || tokens >= std::min(amount, burst);
+  }
+
+  /**
+   * @brief Take tokens, the bucket may go into debt
+   */
+  void consume(double amount);
+
+  /**
+   * @brief How long until the bucket is out of debt
+   */
+  Clock::duration timeUntilPositive() const;
+
+private:
+  double rate = 0;
+  double burst = 0;
+  double tokens = 0;
+  Clock::time_point last;
+};
+
+/**
+ * @brief Per input and per client rate limiting for one input source
+ * @details There is a byte bucket and a record bucket for the input as a
+ *          whole and one more pair per client connection. A record is within
+ *          limits only when all four buckets have tokens for it.
+ */
+class RateLimiter {
+public:
+  using Clock = TokenBucket::Clock;
+
+  /**
+   * @brief Construct the limiter and register its counters
+   *
+   * @param[in] config The `rate_limit` block of the input
+   * @param[in] tag Tag of the input, used as the metric label
+   */
+  RateLimiter(const RateLimitConfig &config, const std::string &tag);
+
+  OverLimitPolicy policy() const { return config.policy; }
+
+  void addClient(int fd);
+  void removeClient(int fd);
+
+  /**
+   * @brief Delay policy: how long `fd` has to wait before reading again
+   *
+   * @return Zero if the client may read now
+   */
+  Clock::duration readDelay(int fd, Clock::time_point now);
+
+  /**
+   * @brief Delay policy: charge a completed read to the buckets
+   *
+   * @param[in] fd Client that was read
+   * @param[in] bytes Bytes read
+   * @param[in] records Records completed by this read
+   */
+  void chargeRead(int fd, size_t bytes, size_t records);
+
+  /**
+   * @brief Drop and sample policy: decide if a single record goes through
+   *
+   * @param[in] fd Client the record came from
+   * @param[in] bytes Size of the record
+   * @return True if the record should be forwarded
+   */
+  bool admitRecord(int fd, size_t bytes, Clock::time_point now);
+
+private:
+  struct Buckets {
+    TokenBucket bytes;
+    TokenBucket records;
+    uint64_t over_limit_seen = 0;
+  };
+
+  Buckets makeBuckets(const BucketRates &rates) const;
+
+  RateLimitConfig config;
+  Buckets input;
+  std::unordered_map<int, Buckets> clients;
+
+  std::atomic<uint64_t> &dropped_records;
+  std::atomic<uint64_t> &dropped_bytes;
+  std::atomic<uint64_t> &sampled_records;
+  std::atomic<uint64_t> &delayed_reads;
+};
@@ -0,0 +1,215 @@
+#include "relay_client.hpp"
+#include "relay_protocol.hpp"
+
+#include <affinity/affinity.hpp>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <format>
+#include <iostream>
+#include <net/socket_options.hpp>
+#include <stats/stats.hpp>
+#include <sys/socket.h>
+#include <thread>
+#include <trace/probes.hpp>
+#include <trace/trace_stamp.hpp>
+#include <unistd.h>
+
+/// Payloads are split so a frame fits comfortably in a read of the receiver
+static constexpr size_t MAX_FRAME_PAYLOAD = 64 * 1024;
+
+/**
+ * @brief Where the frame holding byte `offset` of `frames` starts
+ */
+static size_t frame_start(std::string_view frames, size_t offset) {
+  size_t pos = 0;
+  while (pos < frames.size()) {
+    size_t next = pos + relay::HEADER_SIZE +
+                  relay::payload_length(frames.substr(pos));
+    if (next > offset)
+      return pos;
+    pos = next;
+  }
+  return frames.size();
+}
+
+void RelayClient::start(const RelaySource &config) {
+  auto client = std::unique_ptr<RelayClient>(new RelayClient(config));
+  RelayClient *raw = client.get();
+  Output::add(config.tag, std::move(client));
+  for (auto &link : raw->links)
+    std::thread(&RelayClient::run, raw, std::ref(*link)).detach();
+}
+
+RelayClient::RelayClient(const RelaySource &config)
+    : config(config),
+      bytes_sent(StatsRegistry::instance().counter(
+          "dislog_relay_bytes_sent_total",
+          std::format("output=\"{}\"", config.tag))),
+      dropped_bytes(StatsRegistry::instance().counter(
+          "dislog_relay_dropped_bytes_total",
+          std::format("output=\"{}\"", config.tag))),
+      reconnects(StatsRegistry::instance().counter(
+          "dislog_relay_reconnects_total",
+          std::format("output=\"{}\"", config.tag))) {
+  for (uint32_t i = 0; i < config.connections; ++i)
+    links.push_back(std::make_unique<Link>());
+}
+
+uint16_t RelayClient::tagId(const std::string &origin) {
+  std::lock_guard<std::mutex> guard(tags_lock);
+  auto [id, inserted] =
+      tag_ids.try_emplace(origin, static_cast<uint16_t>(tags.size()));
+  if (inserted)
+    tags.push_back(origin);
+  return id->second;
+}
+
+void RelayClient::announce(Link &link, std::string &out, uint16_t upto) {
+  std::lock_guard<std::mutex> guard(tags_lock);
+  for (; link.announced <= upto; ++link.announced) {
+    const std::string &tag = tags[link.announced];
+    relay::put_header(out, relay::FrameType::Tag, link.announced, 0,
+                      tag.size());
+    out.append(tag);
+  }
+}
+
+void RelayClient::send(int lane, const std::string &origin, uint32_t stream,
+                       std::string_view data, const Trace *trace) {
+  if (data.empty())
+    return;
+
+  uint16_t tag_id = tagId(origin);
+  Link &link = *links[stream % links.size()];
+
+  MemoryGovernor &governor = MemoryGovernor::instance();
+  if (governor.pressure() == Pressure::Shed) {
+    dropped_bytes.fetch_add(data.size(), std::memory_order_relaxed);
+    governor.shed(data.size());
+    return;
+  }
+
+  std::lock_guard<std::mutex> guard(link.lock);
+  if (link.pending.size() + data.size() > config.max_pending_bytes) {
+    // The downstream core can't keep up, don't let the inputs stall
+    dropped_bytes.fetch_add(data.size(), std::memory_order_relaxed);
+    return;
+  }
+
+  if (tag_id >= link.announced)
+    announce(link, link.pending, tag_id);
+
+  while (!data.empty()) {
+    std::string_view part = data.substr(0, MAX_FRAME_PAYLOAD);
+    relay::put_header(link.pending, relay::FrameType::Data, tag_id, stream,
+                      part.size());
+    link.pending.append(part);
+    data.remove_prefix(part.size());
+  }
+  link.pending_memory.set(link.pending.size());
+  link.wakeup.notify_one();
+
+  // Counted as written once queued, the next core measures its own part
+  if (trace)
+    trace->latency->observe(trace->stamp, trace::monotonic_ns());
+}
+
+void RelayClient::closeStream(uint32_t stream) {
+  Link &link = *links[stream % links.size()];
+  std::lock_guard<std::mutex> guard(link.lock);
+  relay::put_header(link.pending, relay::FrameType::Close, 0, stream, 0);
+  link.pending_memory.set(link.pending.size());
+  link.wakeup.notify_one();
+}
+
+int RelayClient::connectLink() {
+  std::chrono::milliseconds backoff(100);
+  for (uint32_t attempt = 1;; ++attempt) {
+    struct sockaddr_storage addr;
+    socklen_t len = config.constructSock(&addr);
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd >= 0)
+      apply_socket_options(fd, config.socket_options, true, config.tag);
+    if (fd >= 0 && connect(fd, (struct sockaddr *)&addr, len) == 0)
+      return fd;
+
+    std::cerr << std::format("Couldn't connect relay {} to {}: {}\n",
+                             config.tag, config.getLocation(),
+                             std::strerror(errno));
+    if (fd >= 0)
+      close(fd);
+    DISLOG_PROBE(reconnect, config.tag.c_str(), attempt, backoff.count());
+    std::this_thread::sleep_for(backoff);
+    backoff = std::min(backoff * 2, std::chrono::milliseconds(5000));
+  }
+}
+
+void RelayClient::run(Link &link) {
+  apply_affinity(config.affinity, config.tag);
+
+  // Frames taken from `pending`, `sent` bytes of them are on the wire. On a
+  // new connection they are preceded by a `preface_size` bytes preface
+  std::string sending;
+  MemoryAccount sending_memory;
+  size_t sent = 0;
+  size_t preface_size = 0;
+  bool connected_before = false;
+
+  while (true) {
+    int fd = connectLink();
+    if (connected_before)
+      reconnects.fetch_add(1, std::memory_order_relaxed);
+    connected_before = true;
+
+    // The downstream core knows nothing about a new connection, tell it
+    // every tag the frames still to come may use
+    std::string preface(relay::MAGIC);
+    {
+      std::lock_guard<std::mutex> guard(link.lock);
+      std::lock_guard<std::mutex> tags_guard(tags_lock);
+      for (uint16_t id = 0; id < link.announced; ++id) {
+        relay::put_header(preface, relay::FrameType::Tag, id, 0,
+                          tags[id].size());
+        preface.append(tags[id]);
+      }
+    }
+    sending.insert(0, preface);
+    preface_size = preface.size();
+    sent = 0;
+
+    while (true) {
+      if (sent == sending.size()) {
+        sending.clear();
+        sending_memory.set(0);
+        sent = 0;
+        preface_size = 0;
+        std::unique_lock<std::mutex> guard(link.lock);
+        link.wakeup.wait(guard, [&] { return !link.pending.empty(); });
+        sending.swap(link.pending);
+        link.pending_memory.set(0);
+        sending_memory.set(sending.size());
+      }
+
+      ssize_t result = ::send(fd, sending.data() + sent, sending.size() - sent,
+                              MSG_NOSIGNAL);
+      if (result < 0) {
+        if (errno == EINTR)
+          continue;
+        std::cerr << std::format("Relay {} lost its connection: {}\n",
+                                 config.tag, std::strerror(errno));
+        close(fd);
+        // The receiver drops a frame cut short, send it again in full. Frames
+        // the kernel accepted but never delivered are lost.
+        size_t resend = preface_size;
+        if (sent > preface_size)
+          resend += frame_start(std::string_view(sending).substr(preface_size),
+                                sent - preface_size);
+        sending.erase(0, resend);
+        break;
+      }
+      sent += result;
+      bytes_sent.fetch_add(result, std::memory_order_relaxed);
+    }
+  }
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <memory/memory_governor.hpp>
+#include <mutex>
+#include <output/output.hpp>
+#include <source/source.hpp>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @brief Sends the data of a `RELAY` output to the downstream core
+ * @details Every input routed to the output shares a small pool of persistent
+ *          connections instead of each connecting on its own. Data is framed
+ *          (see relay_protocol.hpp) with the input tag and client stream it
+ *          came from. A stream always uses the same connection so its records
+ *          stay in order. Each connection has a writer thread which
+ *          reconnects with backoff; while it is down data is queued up to
+ *          `max_pending_bytes` and dropped beyond. Queued frames count
+ *          towards the memory budget and are dropped under shed pressure.
+ */
+class RelayClient : public Output {
+public:
+  /**
+   * @brief Create the client of a `RELAY` output, start its writer threads
+   *        and register it as the shared output of the tag
+   * @note Call before the services start, the registry isn't locked
+   *
+   * @param[in] config The output block
+   */
+  static void start(const RelaySource &config);
+
+  void send(int lane, const std::string &origin, uint32_t stream,
+            std::string_view data, const Trace *trace) override;
+
+  void closeStream(uint32_t stream) override;
+
+private:
+  /**
+   * @brief One connection of the pool
+   */
+  struct Link {
+    std::mutex lock;
+    std::condition_variable wakeup;
+    /// Encoded frames waiting for the writer
+    std::string pending;
+    MemoryAccount pending_memory;
+    /// Tag ids below this have been queued (or sent) on the connection
+    uint16_t announced = 0;
+  };
+
+  explicit RelayClient(const RelaySource &config);
+
+  /**
+   * @brief Body of the writer thread of a link
+   */
+  void run(Link &link);
+
+  /**
+   * @brief Id of an origin tag, assigning the next one on first use
+   */
+  uint16_t tagId(const std::string &origin);
+
+  /**
+   * @brief Queue `Tag` frames for the ids the link hasn't been told about
+   * @note Call with the link locked
+   *
+   * @param[in] upto Highest id the link must know
+   */
+  void announce(Link &link, std::string &out, uint16_t upto);
+
+  /**
+   * @brief Connect to the downstream core, retrying with backoff
+   *
+   * @return The connected socket
+   */
+  int connectLink();
+
+  RelaySource config;
+
+  std::mutex tags_lock;
+  std::unordered_map<std::string, uint16_t> tag_ids;
+  std::vector<std::string> tags;
+
+  std::vector<std::unique_ptr<Link>> links;
+
+  std::atomic<uint64_t> &bytes_sent;
+  std::atomic<uint64_t> &dropped_bytes;
+  std::atomic<uint64_t> &reconnects;
+};
@@ -0,0 +1,150 @@
+#pragma once
+
+#include <cstdint>
+#include <algorithm>
+#include <string>
+#include <string_view>
+
+/**
+ * @brief Wire format of a link between two cores
+ * @details A link starts with `MAGIC` followed by frames. Every frame has a
+ *          fixed 12 byte little endian header:
+ *
+ *          | type (u8) | reserved (u8) | tag id (u16) | stream (u32) | length (u32) |
+ *
+ *          followed by `length` bytes of payload.
+ *          - `Tag` binds a tag id to the input tag in its payload. It is sent
+ *            once per link before the first frame using the id.
+ *          - `Data` carries bytes a client sent on `stream` to the input with
+ *            the given tag id.
+ *          - `Close` tells that `stream` has ended.
+ */
+namespace relay {
+
+constexpr std::string_view MAGIC = "DLRELAY1";
+
+enum class FrameType : uint8_t { Tag = 1, Data = 2, Close = 3 };
+
+constexpr size_t HEADER_SIZE = 12;
+
+/// Larger payloads are split over several frames
+constexpr uint32_t MAX_PAYLOAD = 1 << 20;
+
+/**
+ * @brief Append a frame header to `out`
+ */
+inline void put_header(std::string &out, FrameType type, uint16_t tag_id,
+                       uint32_t stream, uint32_t length) {
+  char header[HEADER_SIZE];
+  header[0] = static_cast<char>(type);
+  header[1] = 0;
+  for (int i = 0; i < 2; ++i)
+    header[2 + i] = static_cast<char>(tag_id >> (8 * i));
+  for (int i = 0; i < 4; ++i)
+    header[4 + i] = static_cast<char>(stream >> (8 * i));
+  for (int i = 0; i < 4; ++i)
+    header[8 + i] = static_cast<char>(length >> (8 * i));
+  out.append(header, HEADER_SIZE);
+}
+
+/**
+ * @brief Payload length of the frame starting at `header`
+ */
+inline uint32_t payload_length(std::string_view header) {
+  uint32_t value = 0;
+  for (int i = 3; i >= 0; --i)
+    value = (value << 8) | static_cast<uint8_t>(header[8 + i]);
+  return value;
+}
+
+/**
+ * @brief Incrementally decodes the frames of a link
+ * @details Payloads are handed out as views into the fed chunk whenever they
+ *          are contiguous in it, only frames split across reads are copied.
+ */
+class Decoder {
+public:
+  /**
+   * @brief Feed bytes read from the link
+   *
+   * @param[in] chunk The bytes
+   * @param[in] fn Called as `fn(type, tag_id, stream, payload)` for every
+   *               complete frame. `payload` is valid during the call only
+   * @return False if the link doesn't speak the protocol
+   */
+  template <typename Fn> bool feed(std::string_view chunk, Fn &&fn) {
+    if (!greeted) {
+      size_t need = MAGIC.size() - partial.size();
+      partial.append(chunk.substr(0, need));
+      chunk.remove_prefix(std::min(need, chunk.size()));
+      if (partial.size() < MAGIC.size())
+        return true;
+      if (partial != MAGIC)
+        return false;
+      greeted = true;
+      partial.clear();
+    }
+
+    while (!chunk.empty()) {
+      if (!partial.empty() || chunk.size() < HEADER_SIZE) {
+        // Finish the frame that started in a previous read
+        size_t want = partial.size() < HEADER_SIZE
+                          ? HEADER_SIZE
+                          : HEADER_SIZE + length(partial);
+        size_t take = std::min(want - partial.size(), chunk.size());
+        partial.append(chunk.substr(0, take));
+        chunk.remove_prefix(take);
+        if (partial.size() < HEADER_SIZE)
+          return true;
+        if (length(partial) > MAX_PAYLOAD)
+          return false;
+        if (partial.size() < HEADER_SIZE + length(partial))
+          continue;
+        if (!emit(partial, fn))
+          return false;
+        partial.clear();
+        continue;
+      }
+
+      if (length(chunk) > MAX_PAYLOAD)
+        return false;
+      size_t total = HEADER_SIZE + length(chunk);
+      if (chunk.size() < total) {
+        partial.append(chunk);
+        return true;
+      }
+      if (!emit(chunk.substr(0, total), fn))
+        return false;
+      chunk.remove_prefix(total);
+    }
+    return true;
+  }
+
+  /**
+   * @brief Bytes of a frame cut short held until the rest arrives
+   */
+  size_t buffered() const { return partial.size(); }
+
+private:
+  static uint32_t length(std::string_view header) {
+    return payload_length(header);
+  }
+
+  template <typename Fn> static bool emit(std::string_view frame, Fn &&fn) {
+    auto type = static_cast<FrameType>(frame[0]);
+    uint16_t tag_id = static_cast<uint8_t>(frame[2]) |
+                      static_cast<uint8_t>(frame[3]) << 8;
+    uint32_t stream = 0;
+    for (int i = 3; i >= 0; --i)
+      stream = (stream << 8) | static_cast<uint8_t>(frame[4 + i]);
+    if (type < FrameType::Tag || type > FrameType::Close)
+      return false;
+    fn(type, tag_id, stream, frame.substr(HEADER_SIZE));
+    return true;
+  }
+
+  bool greeted = false;
+  std::string partial;
+};
+
+} // namespace relay
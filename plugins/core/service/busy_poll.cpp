@@ -0,0 +1,100 @@
+#include "busy_poll.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <format>
+#include <iostream>
+#include <stats/stats.hpp>
+#include <sys/socket.h>
+
+// Older headers lack the options added in Linux 5.11
+#ifndef SO_PREFER_BUSY_POLL
+#define SO_PREFER_BUSY_POLL 69
+#endif
+#ifndef SO_BUSY_POLL_BUDGET
+#define SO_BUSY_POLL_BUDGET 70
+#endif
+
+BusyPoller::BusyPoller(const BusyPollConfig &config, const std::string &tag)
+    : config(config), tag(tag), last_return(Clock::now()),
+      spin_us(StatsRegistry::instance().counter(
+          "dislog_busy_poll_spin_microseconds_total",
+          std::format("input=\"{}\"", tag))),
+      sleep_us(StatsRegistry::instance().counter(
+          "dislog_busy_poll_sleep_microseconds_total",
+          std::format("input=\"{}\"", tag))),
+      work_us(StatsRegistry::instance().counter(
+          "dislog_busy_poll_work_microseconds_total",
+          std::format("input=\"{}\"", tag))),
+      spin_hits(StatsRegistry::instance().counter(
+          "dislog_busy_poll_spin_hits_total",
+          std::format("input=\"{}\"", tag))),
+      sleeps(StatsRegistry::instance().counter(
+          "dislog_busy_poll_sleeps_total", std::format("input=\"{}\"", tag))) {}
+
+void BusyPoller::account(std::chrono::nanoseconds elapsed,
+                         std::chrono::nanoseconds &total,
+                         std::atomic<uint64_t> &counter) {
+  // Kept in nanoseconds here so short spins don't round away to nothing
+  total += elapsed;
+  counter.store(
+      std::chrono::duration_cast<std::chrono::microseconds>(total).count(),
+      std::memory_order_relaxed);
+}
+
+int BusyPoller::wait(int epollfd, epoll_event *events, int max_events,
+                     int timeout) {
+  Clock::time_point start = Clock::now();
+  account(start - last_return, work_total, work_us);
+
+  // A zero timeout is a poll already, there is nothing to spin for
+  auto spin = config.spin;
+  if (timeout >= 0)
+    spin = std::min<std::chrono::microseconds>(
+        spin, std::chrono::milliseconds(timeout));
+
+  Clock::time_point now = start;
+  int nfds = 0;
+  do {
+    nfds = epoll_wait(epollfd, events, max_events, 0);
+    now = Clock::now();
+  } while (nfds == 0 && now - start < spin);
+  account(now - start, spin_total, spin_us);
+
+  if (nfds != 0 || timeout == 0) {
+    if (nfds > 0 && timeout != 0)
+      spin_hits.fetch_add(1, std::memory_order_relaxed);
+    last_return = now;
+    return nfds;
+  }
+
+  int remaining = timeout;
+  if (timeout > 0) {
+    auto spun = std::chrono::duration_cast<std::chrono::milliseconds>(now - start);
+    remaining = std::max<int>(0, timeout - static_cast<int>(spun.count()));
+  }
+  sleeps.fetch_add(1, std::memory_order_relaxed);
+  nfds = epoll_wait(epollfd, events, max_events, remaining);
+  last_return = Clock::now();
+  account(last_return - now, sleep_total, sleep_us);
+  return nfds;
+}
+
+void BusyPoller::tuneSocket(int fd) {
+  auto set = [&](int option, const char *name, int value) {
+    if (setsockopt(fd, SOL_SOCKET, option, &value, sizeof(value)) == 0 ||
+        tune_failed)
+      return;
+    tune_failed = true;
+    std::cerr << std::format("Couldn't set {} for input tag {}: {}\n", name,
+                             tag, std::strerror(errno));
+  };
+
+  if (config.socket_busy_poll_us > 0)
+    set(SO_BUSY_POLL, "SO_BUSY_POLL", config.socket_busy_poll_us);
+  if (config.prefer_busy_poll)
+    set(SO_PREFER_BUSY_POLL, "SO_PREFER_BUSY_POLL", 1);
+  if (config.socket_budget > 0)
+    set(SO_BUSY_POLL_BUDGET, "SO_BUSY_POLL_BUDGET", config.socket_budget);
+}
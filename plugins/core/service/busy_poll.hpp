@@ -0,0 +1,87 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <sys/epoll.h>
+
+/**
+ * @brief `busy_poll` block of an input source
+ */
+struct BusyPollConfig {
+  bool enabled = false;
+
+  /// How long the service thread polls without sleeping once it runs out of
+  /// work, restarted by every event
+  std::chrono::microseconds spin{200};
+
+  /// `SO_BUSY_POLL` of the sockets, how long a read or poll busy waits on
+  /// the device queue. 0 leaves the sockets alone
+  uint32_t socket_busy_poll_us = 0;
+
+  /// `SO_PREFER_BUSY_POLL`, keep interrupts off while the thread busy polls
+  bool prefer_busy_poll = false;
+
+  /// `SO_BUSY_POLL_BUDGET`, packets per busy poll. 0 for the kernel default
+  uint32_t socket_budget = 0;
+};
+
+/**
+ * @brief Low latency replacement of the blocking `epoll_wait` of a service
+ * @details Instead of sleeping as soon as there is nothing to do, the thread
+ *          keeps calling `epoll_wait` with a zero timeout for `spin`, so a
+ *          record arriving shortly after the last one is picked up without a
+ *          wakeup. Only then does it block for whatever is left of the
+ *          timeout. Time spent spinning, sleeping and between waits (the
+ *          useful work) is exported per input.
+ * @note Not thread safe, owned by the service thread of the input
+ */
+class BusyPoller {
+public:
+  /**
+   * @brief Register the counters
+   *
+   * @param[in] config The `busy_poll` block of the input
+   * @param[in] tag Tag of the input, used as the metric label
+   */
+  BusyPoller(const BusyPollConfig &config, const std::string &tag);
+
+  /**
+   * @brief Wait for events, spinning first
+   * @details Same contract as `epoll_wait`
+   */
+  int wait(int epollfd, epoll_event *events, int max_events, int timeout);
+
+  /**
+   * @brief Set the busy poll options of a socket
+   * @details Failures (e.g. lacking `CAP_NET_ADMIN` to go beyond
+   *          `net.core.busy_read`) are logged once and otherwise ignored
+   */
+  void tuneSocket(int fd);
+
+private:
+  using Clock = std::chrono::steady_clock;
+
+  /**
+   * @brief Add time to one of the totals and publish it
+   */
+  static void account(std::chrono::nanoseconds elapsed,
+                      std::chrono::nanoseconds &total,
+                      std::atomic<uint64_t> &counter);
+
+  BusyPollConfig config;
+  std::string tag;
+  bool tune_failed = false;
+
+  Clock::time_point last_return;
+  std::chrono::nanoseconds spin_total{0};
+  std::chrono::nanoseconds sleep_total{0};
+  std::chrono::nanoseconds work_total{0};
+
+  std::atomic<uint64_t> &spin_us;
+  std::atomic<uint64_t> &sleep_us;
+  std::atomic<uint64_t> &work_us;
+  std::atomic<uint64_t> &spin_hits;
+  std::atomic<uint64_t> &sleeps;
+};
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <algorithm>
+#include <cstring>
+#include <memory/memory_governor.hpp>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * @brief Splits a byte stream into newline terminated records
+ * @details Records are handed out as views into the chunk that was read.
+ *          Only a record which spans two reads is copied (into `joined`).
+ *          The partial record is charged to the memory budget.
+ */
+class Framer {
+public:
+  /// A partial record is cut at this length and forwarded, a stream never
+  /// keeps more than this
+  static constexpr size_t MAX_RECORD = 64 * 1024;
+
+  /**
+   * @brief Frame a chunk of the stream
+   *
+   * @param[in] chunk Bytes just read from the client
+   * @param[out] records Every complete record (including the `\n`) is
+   *             appended. The views are valid until the next call to `frame`
+   *             or `finish` and as long as `chunk` is.
+   */
+  void frame(std::string_view chunk, std::vector<std::string_view> &records) {
+    joined.clear();
+
+    size_t start = 0;
+    if (!carry.empty()) {
+      // Complete the partial record, or cut it at `MAX_RECORD`
+      const void *nl = std::memchr(chunk.data(), '\n', chunk.size());
+      start = nl == nullptr ? chunk.size()
+                            : static_cast<const char *>(nl) - chunk.data() + 1;
+      start = std::min(start, MAX_RECORD - carry.size());
+      carry.append(chunk.substr(0, start));
+      if (carry.back() == '\n' || carry.size() >= MAX_RECORD) {
+        joined.swap(carry);
+        records.emplace_back(joined);
+      }
+      memory.set(carry.size());
+      if (!carry.empty())
+        return;
+    }
+
+    while (start < chunk.size()) {
+      const void *nl =
+          std::memchr(chunk.data() + start, '\n', chunk.size() - start);
+      if (nl == nullptr)
+        break;
+      size_t end = static_cast<const char *>(nl) - chunk.data() + 1;
+      records.emplace_back(chunk.substr(start, end - start));
+      start = end;
+    }
+
+    // Chunks of a shm ring can be much larger than `MAX_RECORD`, the tail is
+    // cut into records of that size and only the rest is kept
+    while (chunk.size() - start >= MAX_RECORD) {
+      records.emplace_back(chunk.substr(start, MAX_RECORD));
+      start += MAX_RECORD;
+    }
+    carry.append(chunk.substr(start));
+    memory.set(carry.size());
+  }
+
+  /**
+   * @brief Hand out whatever partial record is left, e.g. on disconnect
+   *
+   * @param[out] records The partial record is appended if there is one
+   */
+  void finish(std::vector<std::string_view> &records) {
+    if (carry.empty())
+      return;
+    joined.clear();
+    joined.swap(carry);
+    records.emplace_back(joined);
+    memory.set(0);
+  }
+
+private:
+  /// Start of a record whose newline hasn't been read yet
+  std::string carry;
+
+  /// Record which spanned reads, kept alive until the next call
+  std::string joined;
+
+  /// Bytes of `carry` charged to the governor
+  MemoryAccount memory;
+};
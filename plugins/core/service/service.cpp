@@ -1,16 +1,43 @@
+#include <affinity/affinity.hpp>
+#include <algorithm>
+#include <capture/capture_writer.hpp>
+#include <atomic>
 #include <cerrno>
+#include <chrono>
 #include <cstddef>
+#include <deque>
 #include <fcntl.h>
 #include <format>
 #include <iostream>
+#include <memory>
+#include <memory/memory_governor.hpp>
+#include <net/socket_options.hpp>
+#include <output/output.hpp>
+#include <pipeline/pipeline.hpp>
+#include <ratelimit/rate_limiter.hpp>
+#include <relay/relay_protocol.hpp>
+#include <session/session.hpp>
+#include <shm/shm_ring.hpp>
 #include <source/source.hpp>
 #include <sys/epoll.h>
 #include <sys/socket.h>
-#include <thread>
+#include <span>
+#include <stats/stats.hpp>
+#include <tail/tail_ring.hpp>
+#include <tls/tls_session.hpp>
+#include <trace/probes.hpp>
+#include <trace/profile_zone.hpp>
+#include <trace/route_latency.hpp>
+#include <trace/trace_stamp.hpp>
+#include <transform/transform_pool.hpp>
 #include <unordered_map>
 
+#include "busy_poll.hpp"
+#include "framer.hpp"
 #include "service.hpp"
 
+using Clock = std::chrono::steady_clock;
+
 int set_nonblocking(int fd) {
   int flags = fcntl(fd, F_GETFL, 0);
   if (flags == -1) {
@@ -22,112 +49,758 @@ int set_nonblocking(int fd) {
   return 0;
 }
 
-// Connect to out sources and map their ids
-std::unordered_map<std::string, int> outSrc_to_fd;
-std::unordered_map<int, std::string> fd_to_outSrc;
+// Every input is serviced on its own thread (see core.cpp) so the state
+// below is kept per thread.
+
+/**
+ * @brief An output of the input
+ */
+struct OutputRef {
+  std::string tag;
+  /// Shared by every input routed to it, see output/output.hpp
+  Output *output;
+  /// Lane of the input on the output
+  int lane;
+  /// Delivers the stamps of sampled batches
+  bool keep_stamps;
+  /// Latency of the sampled batches of the input on the output
+  std::unique_ptr<RouteLatency> latency;
+};
+
+// Outputs of the input
+thread_local std::vector<OutputRef> outputs;
+
+// Outputs of every origin tag of a relay input, origins not listed go to
+// `default_route`. Empty for other inputs, their data goes to every output
+thread_local std::unordered_map<std::string, std::vector<std::string>> routes;
+thread_local std::vector<std::string> default_route;
+
+// Tag of the input, the origin of the data its own clients send
+thread_local std::string input_tag;
+
+// Does the input accept links from upstream cores
+thread_local bool relay_input = false;
+
+// Size of the ring handed to every shipper, 0 unless the input is `SHM`
+thread_local size_t shm_ring_bytes = 0;
+
+// Shipper owning each ring wakeup eventfd
+thread_local std::unordered_map<int, int> ring_wakeups;
+
+// TLS context of the input, null when the input is not encrypted
+thread_local std::unique_ptr<TlsContext> input_tls;
+
+// epoll instance of the input being serviced
+thread_local int epollfd = -1;
+
+// Rate limiter of the input, null when the input is unlimited
+thread_local std::unique_ptr<RateLimiter> limiter;
+
+// Stages run over the records of the input
+thread_local std::unique_ptr<Pipeline> pipeline;
+
+// Set if the traffic of the input is recorded
+thread_local std::unique_ptr<CaptureWriter> capture_writer;
+
+// Set if the stateless stages run on a pool of workers
+thread_local std::unique_ptr<TransformPool> transforms;
+
+// Batches the pool finished, in stream order
+thread_local std::vector<std::unique_ptr<TransformBatch>> transformed;
+
+// Do the records go through the pipeline. Needed by the pipeline stages and by
+// the drop and sample rate limiting policies. Streams are framed either way so
+// outputs only ever get whole records
+thread_local bool run_pipeline = false;
+
+// Client connections of every input are numbered so shared outputs can keep
+// their data apart. 0 is data generated by the core itself
+static std::atomic<uint32_t> next_stream{1};
+
+// Records of the current read
+thread_local std::vector<std::string_view> records;
+
+// Records of the current read the rate limiter let through
+thread_local std::vector<std::string_view> admitted;
+
+/**
+ * @brief What became of a client after it was given its read budget
+ */
+enum class ConnStatus {
+  /// Read until EAGAIN, wait for the next edge
+  Drained,
+  /// Budget used up with data left, read it again next round
+  Budget,
+  /// Out of tokens (delay policy)
+  Throttled,
+  /// Closed by the peer or failed
+  Closed,
+};
+
+/**
+ * @brief A link from an upstream core (relay inputs)
+ * @details Every stream of the link stands in for a client of the upstream
+ *          core and gets a stream of its own here.
+ */
+struct RelayLink {
+  struct Stream {
+    uint32_t stream;
+    uint16_t tag_id;
+    Framer framer;
+  };
+
+  relay::Decoder decoder;
+  /// Origin tag of every tag id
+  std::vector<std::string> tags;
+  /// Streams by their upstream number
+  std::unordered_map<uint32_t, Stream> streams;
+  /// Bytes of the frame cut short charged to the governor
+  MemoryAccount partial_memory;
+};
+
+/**
+ * @brief Scheduling state of a client
+ */
+struct Conn {
+  /// In the `ready` queue
+  bool queued = false;
+  /// Waiting in `throttled`
+  bool throttled = false;
+  /// Session of an encrypted input
+  std::unique_ptr<TlsSession> tls;
+  /// Identifies the client to the shared outputs
+  uint32_t stream = 0;
+  /// Address of the client, see `Session`
+  std::string peer;
+  /// Partial record of the client
+  Framer framer;
+  /// Set if the client is an upstream core
+  std::unique_ptr<RelayLink> relay;
+  /// Set if the client is a local shipper writing into a ring
+  std::unique_ptr<shm::Ring> shm;
+};
+
+// Clients of the input
+thread_local std::unordered_map<int, Conn> conns;
+
+// Clients with data left to read, serviced round robin
+thread_local std::deque<int> ready;
+
+// Bytes a client may read before the next client gets its turn
+thread_local size_t read_budget = 0;
+
+// Clients which are not read until the given time (delay policy)
+thread_local std::vector<std::pair<Clock::time_point, int>> throttled;
+
+// Buffer the clients are read into. Allocated once the thread is placed so
+// it comes from the local NUMA node
+thread_local std::vector<char> read_buf;
+constexpr size_t READ_BUF_SIZE = 16 * 1024;
+
+// How often an input paused by memory pressure checks if it may read again
+constexpr int PRESSURE_POLL_MS = 50;
+
+// Records waiting to be forwarded
+thread_local std::string forward_buf;
+
+// Aggregation summaries waiting to be sent to `summary_output`, which need
+// not be one of the outputs of the input
+thread_local std::string summary_buf;
+thread_local Output *summary_output = nullptr;
+thread_local int summary_lane = 0;
+
+// Recent records of the input for live subscribers, null if tailing is off
+thread_local TailRing *tail_ring = nullptr;
+
+// Set in busy poll mode, replaces the blocking wait for events
+thread_local std::unique_ptr<BusyPoller> busy_poller;
+
+// Outputs the transform plugins route records to, by route index. Null for
+// an output that doesn't exist, its records are dropped
+thread_local std::vector<std::pair<Output *, int>> route_outputs;
+
 int service(Source *inputSource, std::vector<Source *> outputSources) {
+  // Place the thread before it allocates any of its buffers
+  apply_affinity(inputSource->affinity, inputSource->tag);
+  read_buf.resize(READ_BUF_SIZE);
 
   for (auto &out : outputSources) {
-    // Create socket
-    int domain = out->getTypeOfSocket();
-    int sockfd = socket(domain, SOCK_STREAM, 0);
-    if (sockfd < 0) {
-      std::cerr << std::format("Couldn't create a socket for {}", out->tag)
-                << std::strerror(errno) << '\n';
+    Output *output = Output::get(out->tag);
+    outputs.push_back(
+        {out->tag, output,
+         output->openLane(inputSource->tag, "", inputSource->priority),
+         out->keep_trace_stamps,
+         std::make_unique<RouteLatency>(inputSource->tag, out->tag)});
+  }
+
+  if (inputSource->aggregate.enabled) {
+    summary_output = Output::get(inputSource->aggregate.output);
+    if (summary_output) {
+      summary_lane = summary_output->openLane(inputSource->tag, "summary",
+                                              inputSource->priority);
     } else {
-      outSrc_to_fd[out->tag] = sockfd;
-      fd_to_outSrc[sockfd] = out->tag;
+      std::cerr << std::format("Summary output {} for input tag {} is "
+                               "unavailable!\n",
+                               inputSource->aggregate.output,
+                               inputSource->tag);
     }
+  }
+
+  // Start a server to listen at client side
+  return listen_source(inputSource->clone());
+}
+
+/**
+ * @brief Tell the outputs of the input about a new stream
+ */
+void open_stream(uint32_t stream, const Session &session) {
+  for (OutputRef &ref : outputs)
+    ref.output->openStream(stream, session);
+}
+
+/**
+ * @brief Is data of an origin tag routed to an output
+ */
+bool routed(const std::string &origin, const std::string &output) {
+  if (routes.empty())
+    return true;
+  auto route = routes.find(origin);
+  const auto &outputs = route == routes.end() ? default_route : route->second;
+  return std::find(outputs.begin(), outputs.end(), output) != outputs.end();
+}
+
+/**
+ * @brief Forward data to the outputs of the input
+ *
+ * @param[in] data The data to forward
+ * @param[in] stream The client connection the data came from
+ * @param[in] origin Tag of the input the data entered the first core through
+ * @param[in] stamp Set if the data is a sampled batch
+ */
+void forward(std::string_view data, uint32_t stream, const std::string &origin,
+             TraceStamp *stamp = nullptr) {
+  if (data.empty())
+    return;
+  DISLOG_ZONE("route");
+  DISLOG_PROBE(route, stream, origin.c_str(), data.size(), outputs.size());
 
-    set_nonblocking(sockfd);
+  if (stamp)
+    stamp->route_ns = trace::monotonic_ns();
+  if (tail_ring && tail_ring->subscribed())
+    tail_ring->publish(data);
 
-    // Connect to it
-    struct sockaddr_storage sock_out;
-    int socklen = out->constructSock(&sock_out);
-    if (socklen == 0) {
-      std::cerr << std::format("Couldn't connect to tag {} {}\n", out->tag,
-                               std::strerror(errno));
+  // Outputs copy what they need, the caller reuses the buffer for the next
+  // read
+  for (OutputRef &ref : outputs) {
+    if (!routed(origin, ref.tag))
+      continue;
+    if (stamp) {
+      Trace trace{*stamp, ref.latency.get()};
+      ref.output->send(ref.lane, origin, stream, data, &trace);
     } else {
-      int ret = connect(sockfd, (struct sockaddr *)(&sock_out), socklen);
-      if (ret < 0) {
-        if (errno != EINPROGRESS) {
+      ref.output->send(ref.lane, origin, stream, data, nullptr);
+    }
+  }
+}
 
-          std::cerr << std::format("Couldn't connect to tag {} {}\n", out->tag,
-                                   std::strerror(errno));
-        }
-      }
+/**
+ * @brief Forward records as they are, without copying them
+ * @details Records which are adjacent in memory (all but a record joined
+ *          across reads) are handed over as one span.
+ */
+void forward_records(std::span<const std::string_view> records,
+                     uint32_t stream, const std::string &origin,
+                     TraceStamp *stamp) {
+  size_t first = 0;
+  while (first < records.size()) {
+    const char *start = records[first].data();
+    const char *end = start + records[first].size();
+    size_t next = first + 1;
+    while (next < records.size() && records[next].data() == end) {
+      end += records[next].size();
+      ++next;
     }
+    forward(std::string_view(start, end - start), stream, origin, stamp);
+    first = next;
   }
+}
 
-  // Start a server to listen at client side
-  return listen_source(inputSource->clone());
+/**
+ * @brief Send the records the transform plugins routed away
+ */
+void forward_routed() {
+  std::vector<std::string> &routed = pipeline->routed();
+  for (size_t i = 0; i < routed.size(); ++i) {
+    if (routed[i].empty())
+      continue;
+    auto [output, lane] = route_outputs[i];
+    if (output)
+      output->send(lane, input_tag, 0, routed[i], nullptr);
+    routed[i].clear();
+  }
 }
 
 /**
- * @brief It writes to a specific fd
+ * @brief Filter and forward a run of complete records
  *
- * @param[in] write_fd The fd to which to write
- * @param[in] buf The data we need to write
- * @param[in] bytes_to_write How many bytes to write
+ * @param[in] connfd The client, for the per client rate limits
+ * @param[in] batch The records
+ * @param[in] stream The stream
+ * @param[in] origin Tag of the input the stream entered the first core through
+ * @param[in] stamp Set if the records belong to a sampled batch
  */
-void write_to_conn(int write_fd, char *buf, size_t bytes_to_write) {
-  if (bytes_to_write <= 0)
+void deliver(int connfd, std::span<const std::string_view> batch,
+             uint32_t stream, const std::string &origin, TraceStamp *stamp) {
+  DISLOG_ZONE("deliver");
+  if (!run_pipeline) {
+    forward_records(batch, stream, origin, stamp);
     return;
+  }
+
+  if (limiter && limiter->policy() != OverLimitPolicy::Delay) {
+    // Drop and sample policies decide record by record
+    Clock::time_point now = Clock::now();
+    admitted.clear();
+    for (std::string_view record : batch) {
+      if (limiter->admitRecord(connfd, record.size(), now))
+        admitted.push_back(record);
+    }
+    batch = admitted;
+  }
 
-  // Non-blocking write
-  size_t bytes_written = 0;
-  while (bytes_written < bytes_to_write) {
-    ssize_t result =
-        write(write_fd, buf + bytes_written, bytes_to_write - bytes_written);
+  if (transforms) {
+    std::unique_ptr<TransformBatch> work = transforms->acquire();
+    work->stream = stream;
+    work->origin = origin;
+    if (stamp) {
+      work->traced = true;
+      work->stamp = *stamp;
+    }
+    work->add(batch);
+    transforms->submit(std::move(work));
+    return;
+  }
 
-    if (result < 0) {
-      if (errno == EAGAIN || errno == EWOULDBLOCK) {
-        // TODO: Make a queue out of this data
-        return;
+  forward_buf.clear();
+  pipeline->run(batch, forward_buf);
+  forward(forward_buf, stream, origin, stamp);
+  forward_routed();
+}
+
+/**
+ * @brief Finish the batches the transform pool is done with and forward them
+ */
+void forward_transformed() {
+  transformed.clear();
+  transforms->collect(transformed);
+  for (std::unique_ptr<TransformBatch> &batch : transformed) {
+    forward_buf.clear();
+    pipeline->finish(batch->prepared, forward_buf);
+    forward(forward_buf, batch->stream, batch->origin,
+            batch->traced ? &batch->stamp : nullptr);
+    forward_routed();
+    if (batch->last) {
+      for (OutputRef &ref : outputs)
+        ref.output->closeStream(batch->stream);
+    }
+    transforms->recycle(std::move(batch));
+  }
+}
+
+/**
+ * @brief Deliver the framed records, timing the batches the shipper stamped
+ *
+ * A stamp record times the records after it up to the end of the chunk. It
+ * only reaches the outputs which keep stamps.
+ *
+ * @param[in] connfd The client, for the per client rate limits
+ * @param[in] stream The stream
+ * @param[in] origin Tag of the input the stream entered the first core through
+ */
+void process_records(int connfd, uint32_t stream, const std::string &origin) {
+  std::span<const std::string_view> all(records);
+  TraceStamp stamp;
+  TraceStamp *current = nullptr;
+  size_t first = 0;
+  for (size_t i = 0; i < all.size(); i++) {
+    // Anything short of a well formed stamp is an ordinary record
+    int64_t ingest_ns;
+    if (!trace::parse_stamp(all[i], ingest_ns))
+      continue;
+
+    deliver(connfd, all.subspan(first, i - first), stream, origin, current);
+    first = i + 1;
+    stamp = {ingest_ns, trace::monotonic_ns(), 0};
+    current = &stamp;
+    for (OutputRef &ref : outputs) {
+      if (ref.keep_stamps && routed(origin, ref.tag))
+        ref.output->send(ref.lane, origin, stream, all[i], nullptr);
+    }
+  }
+  deliver(connfd, all.subspan(first), stream, origin, current);
+}
+
+/**
+ * @brief Frame, filter and forward a chunk of a client stream
+ *
+ * @param[in] connfd The client, for the per client rate limits
+ * @param[in] framer Partial record of the stream
+ * @param[in] chunk Bytes of the stream
+ * @param[in] stream The stream
+ * @param[in] origin Tag of the input the stream entered the first core through
+ */
+void process_chunk(int connfd, Framer &framer, std::string_view chunk,
+                   uint32_t stream, const std::string &origin) {
+  records.clear();
+  {
+    DISLOG_ZONE("frame");
+    framer.frame(chunk, records);
+  }
+  DISLOG_PROBE(frame, stream, origin.c_str(), records.size(), chunk.size());
+  process_records(connfd, stream, origin);
+}
+
+/**
+ * @brief Forward what is left of a stream which ended
+ */
+void end_stream(int connfd, Framer &framer, uint32_t stream,
+                const std::string &origin) {
+  // Whatever is left can't get any bigger
+  records.clear();
+  framer.finish(records);
+  process_records(connfd, stream, origin);
+
+  if (transforms) {
+    // The stream is closed on the outputs once its batches are through
+    std::unique_ptr<TransformBatch> marker = transforms->acquire();
+    marker->stream = stream;
+    marker->origin = origin;
+    marker->last = true;
+    transforms->submit(std::move(marker));
+    return;
+  }
+  for (OutputRef &ref : outputs)
+    ref.output->closeStream(stream);
+}
+
+/**
+ * @brief Decode the frames an upstream core sent and process their data
+ *
+ * @param[in] connfd The link
+ * @param[in] link State of the link
+ * @param[in] chunk Bytes read from the link
+ * @return False if the link broke the protocol
+ */
+bool relay_feed(int connfd, RelayLink &link, std::string_view chunk) {
+  DISLOG_ZONE("relay_feed");
+  const std::string &peer = conns[connfd].peer;
+  bool valid = true;
+  bool decoded = link.decoder.feed(chunk, [&](relay::FrameType type,
+                                              uint16_t tag_id, uint32_t stream,
+                                              std::string_view payload) {
+    switch (type) {
+    case relay::FrameType::Tag:
+      if (link.tags.size() <= tag_id)
+        link.tags.resize(tag_id + 1);
+      link.tags[tag_id] = payload;
+      break;
+    case relay::FrameType::Data: {
+      if (tag_id >= link.tags.size()) {
+        valid = false;
+        break;
+      }
+      auto [entry, inserted] = link.streams.try_emplace(stream);
+      if (inserted) {
+        entry->second.stream = next_stream.fetch_add(1);
+        entry->second.tag_id = tag_id;
+        // The upstream core is the closest peer known
+        open_stream(entry->second.stream, Session{link.tags[tag_id], peer});
       }
-      std::cerr << "Write error: \n"
-                << std::strerror(errno) << "for " << fd_to_outSrc[write_fd]
-                << '\n';
-      return;
+      process_chunk(connfd, entry->second.framer, payload,
+                    entry->second.stream, link.tags[tag_id]);
+      break;
+    }
+    case relay::FrameType::Close:
+      if (auto entry = link.streams.find(stream);
+          entry != link.streams.end()) {
+        end_stream(connfd, entry->second.framer, entry->second.stream,
+                   link.tags[entry->second.tag_id]);
+        link.streams.erase(entry);
+      }
+      break;
+    }
+  });
+  link.partial_memory.set(link.decoder.buffered());
+  return decoded && valid;
+}
+
+/**
+ * @brief Queue a client to be read in the next round
+ *
+ * @param[in] connfd The client
+ */
+void mark_ready(int connfd) {
+  auto conn = conns.find(connfd);
+  if (conn == conns.end() || conn->second.queued || conn->second.throttled)
+    return;
+  conn->second.queued = true;
+  ready.push_back(connfd);
+}
+
+/**
+ * @brief Stop reading a client until it has tokens again
+ *
+ * @param[in] connfd The client to throttle
+ * @param[in] until When to start reading it again
+ */
+void throttle_conn(int connfd, Clock::time_point until) {
+  // Edge triggered epoll won't report the data already waiting, the client is
+  // simply left out of `ready` until its wait is over
+  conns[connfd].throttled = true;
+  throttled.emplace_back(until, connfd);
+}
+
+/**
+ * @brief Start reading the throttled clients whose wait is over
+ *
+ * @return How long until the next throttled client can be read, -1 if there
+ *         is none. Suitable as an `epoll_wait` timeout.
+ */
+int resume_throttled() {
+  Clock::time_point now = Clock::now();
+  Clock::time_point next = Clock::time_point::max();
+
+  std::erase_if(throttled, [&](const auto &entry) {
+    auto &[until, connfd] = entry;
+    if (until > now) {
+      next = std::min(next, until);
+      return false;
     }
-    bytes_written += result;
+    conns[connfd].throttled = false;
+    mark_ready(connfd);
+    return true;
+  });
+
+  if (next == Clock::time_point::max())
+    return -1;
+  auto wait = std::chrono::ceil<std::chrono::milliseconds>(next - now);
+  return static_cast<int>(wait.count());
+}
+
+/**
+ * @brief Forget a client and close its connection
+ *
+ * @param[in] connfd The client side fd
+ */
+void close_conn(int connfd) {
+  Conn &conn = conns[connfd];
+  if (capture_writer)
+    capture_writer->close(conn.stream);
+  if (conn.relay) {
+    for (auto &[upstream, stream] : conn.relay->streams)
+      end_stream(connfd, stream.framer, stream.stream,
+                 conn.relay->tags[stream.tag_id]);
+  } else {
+    end_stream(connfd, conn.framer, conn.stream, input_tag);
+  }
+  if (limiter)
+    limiter->removeClient(connfd);
+  if (conn.shm) {
+    epoll_ctl(epollfd, EPOLL_CTL_DEL, conn.shm->dataEventFd(), nullptr);
+    ring_wakeups.erase(conn.shm->dataEventFd());
+  }
+  std::erase_if(throttled,
+                [&](const auto &entry) { return entry.second == connfd; });
+  if (conn.queued)
+    std::erase(ready, connfd);
+  conns.erase(connfd);
+
+  epoll_ctl(epollfd, EPOLL_CTL_DEL, connfd, nullptr);
+  close(connfd);
+}
+
+/**
+ * @brief Process what a shipper wrote into its ring
+ * @details Records are framed straight out of the ring, the space is only
+ *          handed back once they were forwarded.
+ *
+ * @param[in] connfd The control socket of the shipper
+ * @param[in] conn The shipper
+ * @param[in] budget Bytes that may be consumed before giving other clients a
+ *            turn
+ * @return What to do with the shipper next
+ */
+ConnStatus drain_ring(int connfd, Conn &conn, size_t budget) {
+  shm::Ring &ring = *conn.shm;
+  bool delay = limiter && limiter->policy() == OverLimitPolicy::Delay;
+  size_t consumed = 0;
+
+  while (true) {
+    if (consumed >= budget) {
+      return ConnStatus::Budget;
+    }
+
+    if (delay) {
+      Clock::time_point now = Clock::now();
+      Clock::duration wait = limiter->readDelay(connfd, now);
+      if (wait > Clock::duration::zero()) {
+        // The ring fills up and the shipper waits for space
+        throttle_conn(connfd, now + wait);
+        return ConnStatus::Throttled;
+      }
+    }
+
+    std::string_view chunk;
+    if (!ring.readable(chunk)) {
+      std::cerr << std::format("Shipper on {} broke its ring, dropping it\n",
+                               input_tag);
+      StatsRegistry::instance()
+          .counter("dislog_shm_ring_errors_total",
+                   std::format("input=\"{}\"", input_tag))
+          .fetch_add(1, std::memory_order_relaxed);
+      return ConnStatus::Closed;
+    }
+    if (chunk.empty()) {
+      if (!ring.idle())
+        continue;
+      // The ring is empty, a hangup of the shipper means it is done
+      char byte;
+      ssize_t ret = recv(connfd, &byte, 1, MSG_PEEK | MSG_DONTWAIT);
+      if (ret == 0 || (ret < 0 && errno != EAGAIN && errno != EWOULDBLOCK))
+        return ConnStatus::Closed;
+      return ConnStatus::Drained;
+    }
+
+    chunk = chunk.substr(0, budget - consumed);
+    DISLOG_PROBE(read, connfd, input_tag.c_str(), chunk.size());
+    if (capture_writer)
+      capture_writer->data(conn.stream, chunk);
+    if (delay) {
+      limiter->chargeRead(connfd, chunk.size(),
+                          std::count(chunk.begin(), chunk.end(), '\n'));
+    }
+    process_chunk(connfd, conn.framer, chunk, conn.stream, input_tag);
+    ring.consume(chunk.size());
+    consumed += chunk.size();
   }
-  return;
 }
 
 /**
  * @brief Receives data from client and forwards it to many of the output fds
  *
  * @param[in] connfd The client side fd from which the data would be read
- * @return True on success;
+ * @param[in] budget Bytes that may be read before giving other clients a turn
+ * @return What to do with the client next
  */
-
-bool handle_conn(int connfd) {
-  char buf[1024];
+ConnStatus handle_conn(int connfd, size_t budget) {
+  DISLOG_ZONE("handle_conn");
+  char *buf = read_buf.data();
   ssize_t bytes_read;
+  bool delay = limiter && limiter->policy() == OverLimitPolicy::Delay;
+  size_t consumed = 0;
+  Conn &conn = conns[connfd];
+  TlsSession *tls = conn.tls.get();
+
+  if (conn.shm)
+    return drain_ring(connfd, conn, budget);
+
+  if (tls != nullptr && !tls->established()) {
+    switch (tls->handshake()) {
+    case TlsSession::Handshake::Done:
+      break;
+    case TlsSession::Handshake::WantRead:
+      return ConnStatus::Drained;
+    case TlsSession::Handshake::WantWrite:
+      // Handshake messages are small, the send buffer frees up quickly
+      return ConnStatus::Budget;
+    case TlsSession::Handshake::Failed:
+      std::cerr << "TLS handshake failed\n";
+      return ConnStatus::Closed;
+    }
+  }
 
   while (true) {
-    bytes_read = read(connfd, buf, sizeof(buf) - 1);
+    if (consumed >= budget) {
+      return ConnStatus::Budget;
+    }
+
+    if (delay) {
+      Clock::time_point now = Clock::now();
+      Clock::duration wait = limiter->readDelay(connfd, now);
+      if (wait > Clock::duration::zero()) {
+        // Leave the data in the socket so the client feels the backpressure
+        throttle_conn(connfd, now + wait);
+        return ConnStatus::Throttled;
+      }
+    }
+
+    size_t want = std::min(read_buf.size(), budget - consumed);
+    bytes_read = tls != nullptr ? tls->read(buf, want) : read(connfd, buf, want);
 
     if (bytes_read < 0) {
       if (errno == EAGAIN || errno == EWOULDBLOCK) {
         // No more data available right now
-        return true;
+        DISLOG_PROBE(eagain, connfd, input_tag.c_str());
+        return ConnStatus::Drained;
       }
       // Real error occurred
       std::cerr << "Read error: " << std::strerror(errno) << '\n';
-      return false;
+      return ConnStatus::Closed;
     } else if (bytes_read == 0) {
       // Connection closed
-      std::cout << fd_to_outSrc[connfd] << "closed the connection" << "\n";
-      return false;
+      return ConnStatus::Closed;
     }
+    consumed += bytes_read;
+    DISLOG_PROBE(read, connfd, input_tag.c_str(), bytes_read);
 
-    for (auto &[tag, fd] : outSrc_to_fd) {
-      // TODO: Imporve this.
-      std::thread(write_to_conn, fd, buf, bytes_read).detach();
+    std::string_view chunk(buf, bytes_read);
+    if (capture_writer)
+      capture_writer->data(conn.stream, chunk);
+    if (delay) {
+      limiter->chargeRead(connfd, chunk.size(),
+                          std::count(chunk.begin(), chunk.end(), '\n'));
+    }
+
+    if (conn.relay) {
+      if (!relay_feed(connfd, *conn.relay, chunk)) {
+        std::cerr << "Relay protocol error\n";
+        return ConnStatus::Closed;
+      }
+      continue;
     }
+
+    process_chunk(connfd, conn.framer, chunk, conn.stream, input_tag);
+  }
+}
+
+/**
+ * @brief Create the ring of a shipper which connected to an `SHM` input and
+ *        hand it over
+ *
+ * @param[in] connfd The control socket of the shipper
+ * @param[out] conn The shipper
+ * @return False on failure
+ */
+bool attach_ring(int connfd, Conn &conn) {
+  conn.shm = shm::Ring::create(shm_ring_bytes, input_tag);
+  if (!conn.shm || !conn.shm->sendTo(connfd)) {
+    std::cerr << std::format("Couldn't set up a ring for {}: {}\n", input_tag,
+                             std::strerror(errno));
+    return false;
   }
+
+  struct epoll_event ev{};
+  ev.events = EPOLLIN | EPOLLET;
+  ev.data.fd = conn.shm->dataEventFd();
+  if (epoll_ctl(epollfd, EPOLL_CTL_ADD, ev.data.fd, &ev) < 0) {
+    std::cerr << "Failed to add ring to epoll: " << std::strerror(errno)
+              << '\n';
+    return false;
+  }
+  ring_wakeups[ev.data.fd] = connfd;
+  // The shipper may have written before the eventfd was watched
+  mark_ready(connfd);
+  return true;
 }
 
 int listen_source(Source *inputSource) {
@@ -144,6 +817,16 @@ int listen_source(Source *inputSource) {
   // Set it to be nonblocking
   set_nonblocking(sockfd);
 
+  // Upstream cores reconnect right away after a restart of this one
+  int reuse = 1;
+  setsockopt(sockfd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+  // Accepted clients inherit the options. Set before listen so the window
+  // scale offered to them fits the buffers
+  bool tcp = inputSource->getTypeOfSocket() == AF_INET;
+  apply_socket_options(sockfd, inputSource->socket_options, tcp,
+                       inputSource->tag);
+
   if (bind(sockfd, (struct sockaddr *)&sock_out, socklen) < 0) {
     std::cerr << std::format("Binding failed for input source {}\n",
                              inputSource->tag);
@@ -158,15 +841,75 @@ int listen_source(Source *inputSource) {
 
   std::cout << "Server started on" << inputSource->getLocation() << std::endl;
 
-  int epollfd = epoll_create1(0);
+  if (inputSource->rate_limit.enabled)
+    limiter =
+        std::make_unique<RateLimiter>(inputSource->rate_limit, inputSource->tag);
+
+  if (const TlsConfig *tls = inputSource->getTls()) {
+    try {
+      input_tls = std::make_unique<TlsContext>(*tls, true, inputSource->tag);
+    } catch (std::exception &e) {
+      std::cerr << e.what() << '\n';
+      close(sockfd);
+      return -1;
+    }
+  }
+
+  if (!inputSource->capture.path.empty()) {
+    try {
+      capture_writer = std::make_unique<CaptureWriter>(inputSource->capture);
+    } catch (std::exception &e) {
+      std::cerr << e.what() << '\n';
+      close(sockfd);
+      return -1;
+    }
+  }
+
+  input_tag = inputSource->tag;
+  tail_ring = TailRing::get(input_tag);
+  if (auto *relay_source = dynamic_cast<RelaySource *>(inputSource)) {
+    relay_input = true;
+    routes = relay_source->routes;
+    default_route = relay_source->output;
+  }
+  if (auto *shm_source = dynamic_cast<ShmSource *>(inputSource))
+    shm_ring_bytes = shm_source->ring_bytes;
+
+  try {
+    pipeline = std::make_unique<Pipeline>(*inputSource);
+  } catch (std::exception &e) {
+    std::cerr << e.what() << '\n';
+    close(sockfd);
+    return -1;
+  }
+  for (size_t route = 0; route < pipeline->routeTags().size(); ++route) {
+    const std::string &tag = pipeline->routeTags()[route];
+    Output *output = Output::get(tag);
+    if (!output) {
+      std::cerr << std::format("Route output {} for input tag {} is "
+                               "unavailable!\n",
+                               tag, inputSource->tag);
+    }
+    route_outputs.emplace_back(
+        output,
+        output ? output->openLane(inputSource->tag,
+                                  std::format("route{}", route),
+                                  inputSource->priority)
+               : 0);
+  }
+  run_pipeline = pipeline->hasStages() ||
+           (limiter && limiter->policy() != OverLimitPolicy::Delay);
+
+  epollfd = epoll_create1(0);
   if (epollfd < 0) {
     std::cerr << "Failed to create epoll: " << std::strerror(errno) << '\n';
     close(sockfd);
     return -1;
   }
 
+  // Edge triggered, every fd is drained (or queued in `ready`) after an event
   struct epoll_event ev{};
-  ev.events = EPOLLIN;
+  ev.events = EPOLLIN | EPOLLET;
   ev.data.fd = sockfd;
   if (epoll_ctl(epollfd, EPOLL_CTL_ADD, sockfd, &ev) < 0) {
     std::cerr << "Failed to add listening socket to epoll: "
@@ -176,10 +919,62 @@ int listen_source(Source *inputSource) {
     return -1;
   }
 
-  std::vector<epoll_event> events(fd_to_outSrc.size());
+  if (inputSource->transform_workers > 0 && pipeline->hasStages()) {
+    transforms = std::make_unique<TransformPool>(
+        *pipeline, inputSource->transform_workers, inputSource->tag);
+    ev.events = EPOLLIN | EPOLLET;
+    ev.data.fd = transforms->eventFd();
+    if (epoll_ctl(epollfd, EPOLL_CTL_ADD, transforms->eventFd(), &ev) < 0) {
+      std::cerr << "Failed to add the transform pool to epoll: "
+                << std::strerror(errno) << '\n';
+      close(epollfd);
+      close(sockfd);
+      return -1;
+    }
+  }
+
+  if (inputSource->busy_poll.enabled) {
+    busy_poller =
+        std::make_unique<BusyPoller>(inputSource->busy_poll, inputSource->tag);
+    busy_poller->tuneSocket(sockfd);
+  }
+
+  read_budget = inputSource->read_budget;
+  std::vector<epoll_event> events(64);
 
   while (true) {
-    int nfds = epoll_wait(epollfd, events.data(), events.size(), -1);
+    forward_buf.clear();
+    summary_buf.clear();
+    int tick_timeout = pipeline->tick(forward_buf, summary_buf);
+    forward(forward_buf, 0, input_tag);
+    if (summary_output && !summary_buf.empty())
+      summary_output->send(summary_lane, input_tag, 0, summary_buf, nullptr);
+
+    int timeout = resume_throttled();
+    if (timeout < 0 || (tick_timeout >= 0 && tick_timeout < timeout))
+      timeout = tick_timeout;
+    if (capture_writer) {
+      int flush_timeout = capture_writer->tick();
+      if (timeout < 0 || (flush_timeout >= 0 && flush_timeout < timeout))
+        timeout = flush_timeout;
+    }
+    // Under memory pressure a low priority input leaves its clients unread,
+    // their data backs up into the socket buffers and the shippers
+    bool paused =
+        !MemoryGovernor::instance().admitsReads(inputSource->priority);
+    if (paused && (timeout < 0 || timeout > PRESSURE_POLL_MS))
+      timeout = PRESSURE_POLL_MS;
+    else if (!paused && !ready.empty())
+      timeout = 0; // Clients still have data, just poll for new events
+
+    // Room for an event from every client and the listening socket
+    if (events.size() < conns.size() + 1)
+      events.resize(std::max(events.size() * 2, conns.size() + 1));
+
+    int nfds =
+        busy_poller
+            ? busy_poller->wait(epollfd, events.data(), events.size(), timeout)
+            : epoll_wait(epollfd, events.data(), events.size(), timeout);
     if (nfds < 0) {
       if (errno == EINTR)
         continue; // Interrupted by signal
@@ -189,33 +984,87 @@ int listen_source(Source *inputSource) {
 
     for (int n = 0; n < nfds; ++n) {
       if (events[n].data.fd == sockfd) {
-        // New connection
-        int connfd = accept(sockfd, nullptr, nullptr);
-        if (connfd < 0) {
-          std::cerr << "Accept failed: " << std::strerror(errno) << '\n';
-          continue;
-        }
+        // Drain the backlog, there won't be another edge for it
+        while (true) {
+          sockaddr_storage addr{};
+          socklen_t addr_len = sizeof(addr);
+          int connfd = accept4(sockfd, (struct sockaddr *)&addr, &addr_len,
+                               SOCK_NONBLOCK | SOCK_CLOEXEC);
+          if (connfd < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+              std::cerr << "Accept failed: " << std::strerror(errno) << '\n';
+            if (errno == EINTR || errno == ECONNABORTED)
+              continue;
+            break;
+          }
 
-        ev.events = EPOLLIN | EPOLLRDHUP; // Detect disconnection
-        ev.data.fd = connfd;
-        if (epoll_ctl(epollfd, EPOLL_CTL_ADD, connfd, &ev) < 0) {
-          std::cerr << "Failed to add client to epoll: " << std::strerror(errno)
-                    << '\n';
-          close(connfd);
-          continue;
+          ev.events = EPOLLIN | EPOLLRDHUP | EPOLLET;
+          ev.data.fd = connfd;
+          if (epoll_ctl(epollfd, EPOLL_CTL_ADD, connfd, &ev) < 0) {
+            std::cerr << "Failed to add client to epoll: "
+                      << std::strerror(errno) << '\n';
+            close(connfd);
+            continue;
+          }
+          if (busy_poller)
+            busy_poller->tuneSocket(connfd);
+          Conn &conn = conns[connfd];
+          conn = Conn();
+          conn.stream = next_stream.fetch_add(1);
+          conn.peer = Session::peerName(connfd, addr);
+          DISLOG_PROBE(accept, connfd, input_tag.c_str(), conn.stream);
+          if (capture_writer)
+            capture_writer->open(conn.stream);
+          if (relay_input)
+            conn.relay = std::make_unique<RelayLink>();
+          if (input_tls)
+            conn.tls = std::make_unique<TlsSession>(*input_tls, connfd);
+          if (shm_ring_bytes > 0 && !attach_ring(connfd, conn)) {
+            conns.erase(connfd);
+            epoll_ctl(epollfd, EPOLL_CTL_DEL, connfd, nullptr);
+            close(connfd);
+            continue;
+          }
+          if (limiter)
+            limiter->addClient(connfd);
+          // A link opens a stream per upstream client instead
+          if (!relay_input)
+            open_stream(conn.stream, Session{input_tag, conn.peer});
         }
+      } else if (transforms && events[n].data.fd == transforms->eventFd()) {
+        forward_transformed();
       } else {
-        // Handle existing connection
-        if (events[n].events & (EPOLLRDHUP | EPOLLERR | EPOLLHUP)) {
-          // Client disconnected or error occurred
-          epoll_ctl(epollfd, EPOLL_CTL_DEL, events[n].data.fd, nullptr);
-          close(events[n].data.fd);
-          std::cerr << "Client disconnected\n";
+        // Data, a hangup or an error. A client which sent its last records
+        // and closed reports EPOLLHUP with the records still unread, so
+        // always read until EOF (or the error) and close from there
+        if (auto wakeup = ring_wakeups.find(events[n].data.fd);
+            wakeup != ring_wakeups.end()) {
+          mark_ready(wakeup->second);
         } else {
-          handle_conn(events[n].data.fd);
+          mark_ready(events[n].data.fd);
         }
       }
     }
+
+    // One round over the clients which were ready when it started
+    for (size_t round = paused ? 0 : ready.size(); round > 0; --round) {
+      int connfd = ready.front();
+      ready.pop_front();
+      conns[connfd].queued = false;
+
+      switch (handle_conn(connfd, read_budget)) {
+      case ConnStatus::Budget:
+        mark_ready(connfd);
+        break;
+      case ConnStatus::Closed:
+        close_conn(connfd);
+        std::cerr << "Client disconnected\n";
+        break;
+      case ConnStatus::Drained:
+      case ConnStatus::Throttled:
+        break;
+      }
+    }
   }
 
   // Cleanup
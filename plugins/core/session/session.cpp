@@ -0,0 +1,41 @@
+#include "session.hpp"
+
+#include <arpa/inet.h>
+#include <format>
+#include <netinet/in.h>
+
+static std::string core_tag = "dislog";
+
+void Session::setCoreTag(std::string tag) { core_tag = std::move(tag); }
+
+const std::string &Session::coreTag() { return core_tag; }
+
+std::string Session::peerName(int fd, const sockaddr_storage &addr) {
+  char host[INET6_ADDRSTRLEN] = "";
+  switch (addr.ss_family) {
+  case AF_INET: {
+    auto &in = reinterpret_cast<const sockaddr_in &>(addr);
+    inet_ntop(AF_INET, &in.sin_addr, host, sizeof(host));
+    return std::format("{}:{}", host, ntohs(in.sin_port));
+  }
+  case AF_INET6: {
+    auto &in6 = reinterpret_cast<const sockaddr_in6 &>(addr);
+    inet_ntop(AF_INET6, &in6.sin6_addr, host, sizeof(host));
+    return std::format("[{}]:{}", host, ntohs(in6.sin6_port));
+  }
+  case AF_UNIX: {
+    // Local clients have no address worth the name, their pid is
+    struct ucred cred{};
+    socklen_t len = sizeof(cred);
+    if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &len) == 0)
+      return std::format("unix:{}", cred.pid);
+    return "unix";
+  }
+  }
+  return "-";
+}
+
+std::string Session::header() const {
+  return std::format("@dislog core={} input={} peer={}", core_tag, input,
+                     peer);
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <string>
+#include <sys/socket.h>
+
+/**
+ * @brief Where a client stream came from, captured when it is accepted
+ * @details Handed to the outputs once per stream (`Output::openStream`) so
+ *          those which tag records with their origin can precompute what
+ *          they prepend instead of working it out per batch.
+ */
+struct Session {
+  /// Tag of the input the stream entered the first core through
+  std::string input;
+
+  /// `address:port` of a TCP client, `unix:pid` of a local one
+  std::string peer;
+
+  /**
+   * @brief Name the core goes by in metadata headers
+   * @note Set before the services start, it isn't locked
+   */
+  static void setCoreTag(std::string tag);
+  static const std::string &coreTag();
+
+  /**
+   * @brief Describe the peer of an accepted connection
+   *
+   * @param[in] fd The accepted connection
+   * @param[in] addr Address `accept` filled in
+   * @return The `peer` of a `Session`
+   */
+  static std::string peerName(int fd, const sockaddr_storage &addr);
+
+  /**
+   * @brief Start of the metadata header of the stream's records
+   * @return `@dislog core=<core> input=<input> peer=<peer>`
+   */
+  std::string header() const;
+};
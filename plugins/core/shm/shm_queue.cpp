@@ -0,0 +1,194 @@
+#include "shm_queue.hpp"
+
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <fcntl.h>
+#include <mutex>
+#include <set>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace shm {
+
+/// The header takes the first page of the region, data starts after it
+static constexpr size_t QUEUE_DATA_OFFSET = 4096;
+static_assert(sizeof(QueueHeader) <= QUEUE_DATA_OFFSET);
+
+/// Names attached by this core, the pid in the header can't tell them apart
+static std::mutex attached_lock;
+static std::set<std::string> attached;
+
+std::unique_ptr<Queue> Queue::attach(const std::string &name,
+                                     size_t capacity) {
+  std::lock_guard<std::mutex> guard(attached_lock);
+  if (attached.contains(name)) {
+    errno = EBUSY;
+    return nullptr;
+  }
+
+  int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+  if (fd < 0)
+    return nullptr;
+
+  struct stat st;
+  if (fstat(fd, &st) < 0) {
+    int saved = errno;
+    close(fd);
+    errno = saved;
+    return nullptr;
+  }
+
+  bool fresh = static_cast<size_t>(st.st_size) <= QUEUE_DATA_OFFSET;
+  size_t data_size = QUEUE_DATA_OFFSET;
+  if (fresh) {
+    while (data_size < capacity)
+      data_size <<= 1;
+    if (ftruncate(fd, QUEUE_DATA_OFFSET + data_size) < 0) {
+      int saved = errno;
+      close(fd);
+      errno = saved;
+      return nullptr;
+    }
+  } else {
+    data_size = st.st_size - QUEUE_DATA_OFFSET;
+  }
+
+  auto queue = std::unique_ptr<Queue>(new Queue());
+  bool mapped = queue->map(fd, data_size);
+  int saved = errno;
+  // The mappings keep the region, the name keeps it past the core
+  close(fd);
+  if (!mapped) {
+    errno = saved;
+    return nullptr;
+  }
+
+  QueueHeader *header = queue->header;
+  if (fresh || header->magic != QUEUE_MAGIC ||
+      header->version != QUEUE_VERSION || header->capacity != data_size ||
+      (data_size & (data_size - 1)) != 0) {
+    // New, or not something this core can read: start it over
+    header->magic = QUEUE_MAGIC;
+    header->version = QUEUE_VERSION;
+    header->capacity = data_size;
+    header->generation = 0;
+    header->owner.store(0);
+    header->tail.store(0);
+    header->head.store(0);
+  }
+
+  int32_t owner = header->owner.load();
+  if (owner != 0 && owner != getpid() && kill(owner, 0) == 0) {
+    errno = EBUSY;
+    return nullptr;
+  }
+  header->owner.store(getpid());
+  ++header->generation;
+  queue->name = name;
+  attached.insert(name);
+
+  queue->restore();
+  return queue;
+}
+
+Queue::~Queue() {
+  if (!name.empty()) {
+    std::lock_guard<std::mutex> guard(attached_lock);
+    attached.erase(name);
+  }
+  if (header != nullptr) {
+    header->owner.store(0);
+    munmap(header, QUEUE_DATA_OFFSET);
+  }
+  if (data != nullptr)
+    munmap(data, 2 * capacity);
+}
+
+bool Queue::map(int fd, size_t data_size) {
+  capacity = data_size;
+  void *head_page = mmap(nullptr, QUEUE_DATA_OFFSET, PROT_READ | PROT_WRITE,
+                         MAP_SHARED, fd, 0);
+  if (head_page == MAP_FAILED)
+    return false;
+  header = static_cast<QueueHeader *>(head_page);
+
+  // Reserve twice the data area and map the data into both halves
+  void *area = mmap(nullptr, 2 * capacity, PROT_NONE,
+                    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (area == MAP_FAILED)
+    return false;
+  data = static_cast<char *>(area);
+  for (size_t half = 0; half < 2; ++half) {
+    if (mmap(data + half * capacity, capacity, PROT_READ | PROT_WRITE,
+             MAP_SHARED | MAP_FIXED, fd, QUEUE_DATA_OFFSET) == MAP_FAILED)
+      return false;
+  }
+  return true;
+}
+
+void Queue::restore() {
+  uint64_t head = header->head.load();
+  uint64_t tail = header->tail.load();
+  if (tail < head || tail - head > capacity || head % 8 != 0) {
+    // Nothing in it can be trusted
+    header->head.store(tail);
+    head = tail;
+  }
+
+  uint64_t pos = head;
+  while (pos < tail) {
+    QueueRecord record;
+    std::memcpy(&record, data + (pos & (capacity - 1)), sizeof(record));
+    if (record.size == 0 || record.generation >= header->generation ||
+        recordSize(record.size) > tail - pos)
+      break;
+    restored_entries.push_back(
+        {{data + ((pos + sizeof(record)) & (capacity - 1)), record.size},
+         record.received_ns});
+    pos += recordSize(record.size);
+  }
+  // A torn record ends the queue
+  header->tail.store(pos);
+  read_pos = head;
+}
+
+bool Queue::push(std::string_view bytes, int64_t received_ns) {
+  size_t size = recordSize(bytes.size());
+  uint64_t tail = header->tail.load(std::memory_order_relaxed);
+  uint64_t head = header->head.load(std::memory_order_acquire);
+  if (bytes.empty() || bytes.size() > UINT32_MAX ||
+      capacity - (tail - head) < size)
+    return false;
+
+  QueueRecord record{static_cast<uint32_t>(bytes.size()),
+                     static_cast<uint32_t>(header->generation), received_ns};
+  char *at = data + (tail & (capacity - 1));
+  std::memcpy(at, &record, sizeof(record));
+  std::memcpy(at + sizeof(record), bytes.data(), bytes.size());
+  header->tail.store(tail + size, std::memory_order_release);
+  return true;
+}
+
+bool Queue::next(Entry &entry) {
+  if (read_pos == header->tail.load(std::memory_order_acquire))
+    return false;
+  QueueRecord record;
+  std::memcpy(&record, data + (read_pos & (capacity - 1)), sizeof(record));
+  entry = {{data + ((read_pos + sizeof(record)) & (capacity - 1)),
+            record.size},
+           record.received_ns};
+  read_pos += recordSize(record.size);
+  return true;
+}
+
+void Queue::release() {
+  uint64_t head = header->head.load(std::memory_order_relaxed);
+  QueueRecord record;
+  std::memcpy(&record, data + (head & (capacity - 1)), sizeof(record));
+  header->head.store(head + recordSize(record.size),
+                     std::memory_order_release);
+}
+
+} // namespace shm
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * @brief Output queue in a named shared memory region which outlives the
+ *        core, so a restarted core carries on draining it
+ * @details The region (`/dev/shm/<name>`) is a header page and a byte ring,
+ *          mapped twice back to back like `shm::Ring` so every record is
+ *          contiguous. A record is a `QueueRecord` and the bytes of one
+ *          chunk, padded to 8 bytes.
+ *
+ *          The header stays consistent whenever the core dies: a record is
+ *          copied in before `tail` moves past it and `head` only moves past
+ *          a record once the output wrote it. A record being copied when the
+ *          core died was never queued, one being written may be sent again.
+ *          `generation` counts the cores which attached, every record
+ *          carries the generation which queued it.
+ *
+ *          One queue is used by one core: `owner` holds its pid while it is
+ *          alive. Within the core a name is attached once at a time.
+ */
+namespace shm {
+
+constexpr uint32_t QUEUE_MAGIC = 0x444c5351; // "DLSQ"
+constexpr uint32_t QUEUE_VERSION = 1;
+
+struct QueueHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint64_t capacity;
+  uint64_t generation;
+  /// Pid of the core using the queue
+  std::atomic<int32_t> owner;
+  /// Bytes ever queued, a record is in place before it is passed
+  alignas(64) std::atomic<uint64_t> tail;
+  /// Bytes ever written to the output
+  alignas(64) std::atomic<uint64_t> head;
+};
+
+struct QueueRecord {
+  uint32_t size;
+  uint32_t generation;
+  /// See `SocketOutput::Chunk::received_ns`
+  int64_t received_ns;
+};
+static_assert(sizeof(QueueRecord) == 16);
+
+class Queue {
+public:
+  struct Entry {
+    /// Valid until the record is released
+    std::string_view data;
+    int64_t received_ns;
+  };
+
+  /**
+   * @brief Create the queue or attach to the one a previous core left
+   * @details An existing queue keeps its capacity. Records it holds are
+   *          checked and a torn tail cut off, see `restored()`.
+   *
+   * @param[in] name Name of the region, starting with `/`
+   * @param[in] capacity Bytes of data for a new queue, rounded up to a power
+   *            of two pages
+   * @return The queue or nullptr on failure, errno is set (`EBUSY` if a live
+   *         core owns it or it is attached already)
+   */
+  static std::unique_ptr<Queue> attach(const std::string &name,
+                                       size_t capacity);
+
+  ~Queue();
+
+  /**
+   * @brief Records left by the previous core, oldest first
+   * @note They are the first `next()` hands out
+   */
+  const std::vector<Entry> &restored() const { return restored_entries; }
+
+  uint64_t generation() const { return header->generation; }
+
+  /**
+   * @brief Append a record
+   *
+   * @return False if the queue is full
+   */
+  bool push(std::string_view data, int64_t received_ns);
+
+  /**
+   * @brief Hand out the oldest record not handed out yet
+   *
+   * @return False if there is none
+   */
+  bool next(Entry &entry);
+
+  /**
+   * @brief The oldest record handed out was written, free it
+   * @note May run concurrently with `push`, not with itself
+   */
+  void release();
+
+private:
+  Queue() = default;
+
+  bool map(int fd, size_t data_size);
+
+  /// Walk the records between head and tail, cut off what doesn't parse
+  void restore();
+
+  static size_t recordSize(size_t data) {
+    return (sizeof(QueueRecord) + data + 7) & ~size_t(7);
+  }
+
+  std::string name;
+  QueueHeader *header = nullptr;
+  char *data = nullptr;
+  size_t capacity = 0;
+  /// Where `next` reads, between head and tail
+  uint64_t read_pos = 0;
+  std::vector<Entry> restored_entries;
+};
+
+} // namespace shm
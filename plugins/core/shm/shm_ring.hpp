@@ -0,0 +1,317 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <poll.h>
+#include <string>
+#include <string_view>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/**
+ * @brief Byte ring shared by a local shipper (producer) and the core
+ *        (consumer) for the `SHM` comm_type
+ * @details The ring lives in a memfd. The core creates it once a shipper
+ *          connects to the control socket of the input and passes the memfd
+ *          and two eventfds over that socket (SCM_RIGHTS). The data area is
+ *          mapped twice back to back, so every readable or writable span is
+ *          contiguous and records are framed straight out of the ring.
+ *
+ *          Wakeups are only paid for by an idle side: the consumer sets
+ *          `consumer_idle` before it waits for `data_efd` and the producer
+ *          signals it only when the flag is set, likewise for the producer
+ *          waiting for space on `space_efd`. The control socket stays open,
+ *          its hangup tells either side the other one is gone.
+ *
+ *          The core doesn't trust the shipper: it keeps its own copy of
+ *          `tail` and a `head` more than `capacity` ahead of it breaks the
+ *          ring.
+ */
+namespace shm {
+
+constexpr uint32_t MAGIC = 0x444c5348; // "DLSH"
+
+/// The header takes the first page of the memfd, data starts after it
+constexpr size_t DATA_OFFSET = 4096;
+
+struct RingHeader {
+  uint32_t magic;
+  uint32_t reserved;
+  uint64_t capacity;
+  /// Bytes ever written, only advanced by the producer
+  alignas(64) std::atomic<uint64_t> head;
+  /// Bytes ever consumed, only advanced by the consumer
+  alignas(64) std::atomic<uint64_t> tail;
+  alignas(64) std::atomic<uint32_t> consumer_idle;
+  alignas(64) std::atomic<uint32_t> producer_waiting;
+};
+static_assert(sizeof(RingHeader) <= DATA_OFFSET);
+
+class Ring {
+public:
+  /**
+   * @brief Create a ring (consumer side)
+   *
+   * @param[in] capacity Bytes of data, rounded up to a power of two pages
+   * @param[in] name Name of the memfd, shows up in /proc/<pid>/fd
+   * @return The ring or nullptr on failure, errno is set
+   */
+  static std::unique_ptr<Ring> create(size_t capacity,
+                                      const std::string &name) {
+    size_t rounded = DATA_OFFSET;
+    while (rounded < capacity)
+      rounded <<= 1;
+
+    int memfd = memfd_create(name.c_str(), MFD_CLOEXEC);
+    if (memfd < 0)
+      return nullptr;
+    auto ring = std::unique_ptr<Ring>(new Ring());
+    ring->memfd = memfd;
+    ring->data_efd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    // The producer blocks on this one, it must not share O_NONBLOCK
+    ring->space_efd = eventfd(0, EFD_CLOEXEC);
+    if (ring->data_efd < 0 || ring->space_efd < 0 ||
+        ftruncate(memfd, DATA_OFFSET + rounded) < 0 || !ring->map(rounded))
+      return nullptr;
+
+    ring->header->magic = MAGIC;
+    ring->header->capacity = rounded;
+    return ring;
+  }
+
+  /**
+   * @brief Send the memfd and the eventfds to the producer
+   *
+   * @param[in] control The control socket of the producer
+   * @return False on failure, errno is set
+   */
+  bool sendTo(int control) const {
+    int fds[3] = {memfd, data_efd, space_efd};
+    char byte = 'S';
+    struct iovec iov = {&byte, 1};
+    alignas(struct cmsghdr) char control_buf[CMSG_SPACE(sizeof(fds))] = {};
+    struct msghdr msg = {};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control_buf;
+    msg.msg_controllen = sizeof(control_buf);
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(fds));
+    std::memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+    return sendmsg(control, &msg, MSG_NOSIGNAL) == 1;
+  }
+
+  /**
+   * @brief Receive a ring from the core (producer side)
+   *
+   * @param[in] control The connected control socket, kept to notice the core
+   *                    going away
+   * @return The ring or nullptr on failure
+   */
+  static std::unique_ptr<Ring> receive(int control) {
+    int fds[3];
+    char byte;
+    struct iovec iov = {&byte, 1};
+    alignas(struct cmsghdr) char control_buf[CMSG_SPACE(sizeof(fds))] = {};
+    struct msghdr msg = {};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control_buf;
+    msg.msg_controllen = sizeof(control_buf);
+    if (recvmsg(control, &msg, MSG_CMSG_CLOEXEC) != 1)
+      return nullptr;
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    if (cmsg == nullptr || cmsg->cmsg_type != SCM_RIGHTS ||
+        cmsg->cmsg_len != CMSG_LEN(sizeof(fds)))
+      return nullptr;
+    std::memcpy(fds, CMSG_DATA(cmsg), sizeof(fds));
+
+    auto ring = std::unique_ptr<Ring>(new Ring());
+    ring->memfd = fds[0];
+    ring->data_efd = fds[1];
+    ring->space_efd = fds[2];
+    ring->control = control;
+    struct stat st;
+    if (fstat(ring->memfd, &st) < 0 ||
+        static_cast<size_t>(st.st_size) <= DATA_OFFSET ||
+        !ring->map(st.st_size - DATA_OFFSET) || ring->header->magic != MAGIC)
+      return nullptr;
+    return ring;
+  }
+
+  ~Ring() {
+    if (data != nullptr)
+      munmap(data, 2 * capacity);
+    if (header != nullptr)
+      munmap(header, DATA_OFFSET);
+    for (int fd : {memfd, data_efd, space_efd})
+      if (fd >= 0)
+        close(fd);
+  }
+
+  /// Readable when the producer wants the consumer to look at the ring
+  int dataEventFd() const { return data_efd; }
+
+  // Consumer side
+
+  /**
+   * @brief Bytes written and not consumed yet, as one contiguous span
+   *
+   * @param[out] span The bytes, empty if there are none
+   * @return False if the producer broke the ring, drop it then
+   */
+  bool readable(std::string_view &span) {
+    uint64_t head = header->head.load(std::memory_order_acquire);
+    span = {};
+    if (head - consumed > capacity)
+      return false;
+    available = head - consumed;
+    span = {data + (consumed & (capacity - 1)), static_cast<size_t>(available)};
+    return true;
+  }
+
+  /**
+   * @brief Hand `size` bytes of `readable()` back to the producer
+   */
+  void consume(size_t size) {
+    size = std::min<uint64_t>(size, available);
+    available -= size;
+    consumed += size;
+    header->tail.store(consumed, std::memory_order_release);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (header->producer_waiting.load(std::memory_order_relaxed) &&
+        header->producer_waiting.exchange(0))
+      signal(space_efd);
+  }
+
+  /**
+   * @brief Announce the consumer is about to wait for `dataEventFd()`
+   *
+   * @return False if data arrived in the meantime, don't wait then
+   */
+  bool idle() {
+    uint64_t value;
+    while (read(data_efd, &value, sizeof(value)) > 0) {
+    }
+    header->consumer_idle.store(1);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    // A broken ring is reported by the next `readable`
+    std::string_view span;
+    if (!readable(span) || !span.empty()) {
+      header->consumer_idle.store(0, std::memory_order_relaxed);
+      return false;
+    }
+    return true;
+  }
+
+  // Producer side
+
+  /**
+   * @brief Copy data into the ring, waiting while it is full
+   *
+   * @return False if the core went away
+   */
+  bool write(const char *buf, size_t size) {
+    while (size > 0) {
+      uint64_t head = header->head.load(std::memory_order_relaxed);
+      uint64_t tail = header->tail.load(std::memory_order_acquire);
+      size_t room = capacity - (head - tail);
+      if (room == 0) {
+        if (!waitForSpace())
+          return false;
+        continue;
+      }
+
+      size_t part = std::min(room, size);
+      std::memcpy(data + (head & (capacity - 1)), buf, part);
+      header->head.store(head + part, std::memory_order_release);
+      buf += part;
+      size -= part;
+
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      if (header->consumer_idle.load(std::memory_order_relaxed) &&
+          header->consumer_idle.exchange(0))
+        signal(data_efd);
+    }
+    return true;
+  }
+
+private:
+  Ring() = default;
+
+  bool map(size_t data_size) {
+    capacity = data_size;
+    void *head_page = mmap(nullptr, DATA_OFFSET, PROT_READ | PROT_WRITE,
+                           MAP_SHARED, memfd, 0);
+    if (head_page == MAP_FAILED)
+      return false;
+    header = static_cast<RingHeader *>(head_page);
+
+    // Reserve twice the data area and map the data into both halves
+    void *area = mmap(nullptr, 2 * capacity, PROT_NONE,
+                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (area == MAP_FAILED)
+      return false;
+    data = static_cast<char *>(area);
+    for (size_t half = 0; half < 2; ++half) {
+      if (mmap(data + half * capacity, capacity, PROT_READ | PROT_WRITE,
+               MAP_SHARED | MAP_FIXED, memfd, DATA_OFFSET) == MAP_FAILED)
+        return false;
+    }
+    return true;
+  }
+
+  static void signal(int efd) {
+    uint64_t one = 1;
+    [[maybe_unused]] ssize_t ret = ::write(efd, &one, sizeof(one));
+  }
+
+  bool waitForSpace() {
+    header->producer_waiting.store(1);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    uint64_t head = header->head.load(std::memory_order_relaxed);
+    if (head - header->tail.load() < capacity) {
+      header->producer_waiting.store(0, std::memory_order_relaxed);
+      return true;
+    }
+
+    struct pollfd fds[2] = {{space_efd, POLLIN, 0}, {control, POLLIN, 0}};
+    while (poll(fds, 2, -1) < 0) {
+      if (errno != EINTR)
+        return false;
+    }
+    if (fds[0].revents & POLLIN) {
+      uint64_t value;
+      [[maybe_unused]] ssize_t ret = read(space_efd, &value, sizeof(value));
+      return true;
+    }
+    // The core never writes on the control socket, this is its hangup
+    return false;
+  }
+
+  RingHeader *header = nullptr;
+  char *data = nullptr;
+  size_t capacity = 0;
+  int memfd = -1;
+  int data_efd = -1;
+  int space_efd = -1;
+  /// Control socket, only set on the producer side
+  int control = -1;
+
+  // Consumer side, kept out of the shared header
+  /// Bytes ever consumed
+  uint64_t consumed = 0;
+  /// Bytes the last `readable` found, `consume` never goes past them
+  uint64_t available = 0;
+};
+
+} // namespace shm
@@ -1,16 +1,51 @@
 #pragma once
 
+#include <affinity/affinity.hpp>
+#include <aggregate/aggregator.hpp>
 #include <arpa/inet.h>
+#include <capture/capture_writer.hpp>
+#include <dedup/deduplicator.hpp>
+#include <filter/record_filter.hpp>
 #include <format>
+#include <net/socket_options.hpp>
 #include <nlohmann/json.hpp>
+#include <ratelimit/rate_limiter.hpp>
+#include <service/busy_poll.hpp>
 #include <stdexcept>
 #include <string>
 #include <string_view>
 #include <sys/socket.h>
 #include <sys/un.h>
+#include <tls/tls_session.hpp>
+#include <transform/transform_plugin.hpp>
 #include <unistd.h>
+#include <unordered_map>
 #include <vector>
 
+/**
+ * @brief How the records of an input are decoded
+ */
+enum class ParseFormat {
+  /// Records are opaque bytes
+  None,
+  /// RFC 3164 / RFC 5424 headers
+  Syslog,
+  /// The `json_keys` of JSON object lines
+  Json,
+};
+
+/**
+ * @brief How an output lays out the records it sends
+ */
+enum class OutputFormat {
+  /// Newline separated, as received
+  Text,
+  /// Parsed into column oriented frames, see `columnar_format.hpp`. BSD
+  /// timestamps carry no zone and are read in the core's local time, their
+  /// text is kept next to them
+  Columnar,
+};
+
 /**
  * @brief Base Class for different type of sources
  * @note Currently this only supports different types of socket but
@@ -21,6 +56,9 @@ public:
   constexpr static std::string_view UNIX_STRING = "UNIX_SOCK";
   constexpr static std::string_view COMM_TYPE = "comm_type";
   constexpr static std::string_view IPV4_STRING = "IPv4";
+  constexpr static std::string_view FILE_STRING = "FILE";
+  constexpr static std::string_view RELAY_STRING = "RELAY";
+  constexpr static std::string_view SHM_STRING = "SHM";
 
   /// Tag for the source
   std::string tag;
@@ -31,6 +69,125 @@ public:
    */
   std::vector<std::string> output;
 
+  /**
+   * @brief Token bucket limits applied on the read path
+   * @detail Only valid for when `isInput()` is true
+   */
+  RateLimitConfig rate_limit;
+
+  /**
+   * @brief Substring lists deciding which records are forwarded
+   * @detail Only valid for when `isInput()` is true
+   */
+  FilterConfig filter;
+
+  /**
+   * @brief Parse stage of the input
+   * @detail Only valid for when `isInput()` is true
+   */
+  ParseFormat parse = ParseFormat::None;
+
+  /**
+   * @brief Top level keys the `json` parse stage extracts
+   * @detail Only valid for when `isInput()` is true
+   */
+  std::vector<std::string> json_keys;
+
+  /**
+   * @brief Collapsing of repeated records
+   * @detail Only valid for when `isInput()` is true
+   */
+  DedupConfig dedup;
+
+  /**
+   * @brief Shared objects run over the records, in order
+   * @detail Only valid for when `isInput()` is true
+   */
+  std::vector<TransformPluginConfig> transform_plugins;
+
+  /**
+   * @brief Windowed counts and quantiles of the records
+   * @detail Only valid for when `isInput()` is true
+   */
+  AggregateConfig aggregate;
+
+  /**
+   * @brief Buffer sizes, TCP options and zero copy sends of the sockets of
+   *        the source
+   */
+  SocketOptions socket_options;
+
+  /**
+   * @brief CPU and NUMA placement of the thread servicing the source
+   */
+  AffinityConfig affinity;
+
+  /**
+   * @brief Spinning instead of sleeping when the input runs out of work
+   * @detail Only valid for when `isInput()` is true
+   */
+  BusyPollConfig busy_poll;
+
+  /**
+   * @brief Bytes read from a client before the next client gets its turn
+   * @detail Only valid for when `isInput()` is true
+   */
+  size_t read_budget = 64 * 1024;
+
+  /**
+   * @brief Recording of the traffic of the input for the `replay` tool
+   * @detail Only valid for when `isInput()` is true
+   */
+  CaptureConfig capture;
+
+  /**
+   * @brief Threads running the parse and filter stages, 0 runs them on the
+   *        service thread
+   * @detail Only valid for when `isInput()` is true
+   */
+  size_t transform_workers = 0;
+
+  /**
+   * @brief Weight of the input on the socket outputs it shares with others
+   * @detail Only valid for when `isInput()` is true
+   */
+  uint32_t priority = 1;
+
+  /**
+   * @brief Bytes an input may have queued on the output before its data is
+   *        dropped
+   * @detail Only valid for `UNIX_SOCK` and `IPv4` outputs
+   */
+  uint64_t lane_queue_bytes = 16ull << 20;
+
+  /**
+   * @brief Deliver the latency stamps of sampled batches instead of
+   *        stripping them
+   * @detail Only valid for when `isOutput()` is true
+   */
+  bool keep_trace_stamps = false;
+
+  /**
+   * @brief Layout of the records on the wire
+   * @detail Only valid for `UNIX_SOCK` and `IPv4` outputs
+   */
+  OutputFormat format = OutputFormat::Text;
+
+  /**
+   * @brief Send a line naming the core, input, peer and receive time ahead
+   *        of every chunk of records
+   * @detail Only valid for `UNIX_SOCK` and `IPv4` outputs in `Text` format.
+   *         Their batches are sent without `zerocopy`
+   */
+  bool metadata_header = false;
+
+  /**
+   * @brief Keep the lanes in named shared memory so queued chunks survive a
+   *        restart of the core
+   * @detail Only valid for `UNIX_SOCK` and `IPv4` outputs
+   */
+  bool persistent_queues = false;
+
   /**
    * @brief It constructs a socket address and returns
    *
@@ -61,6 +218,13 @@ public:
    */
   virtual void cleanUp() const {}
 
+  /**
+   * @brief TLS settings of the source
+   *
+   * @return The settings or nullptr if the source is not encrypted
+   */
+  virtual const TlsConfig *getTls() const { return nullptr; }
+
   /**
    * @brief Create a clone
    *
@@ -178,11 +342,15 @@ private:
   using json = nlohmann::json;
   std::string_view URI = "uri";
   std::string_view PORT = "port";
+  std::string_view TLS = "tls";
 
 public:
   std::string uri;
   int port;
 
+  /// Optional, see `TlsConfig`
+  TlsConfig tls;
+
   IPv4Source(nlohmann::basic_json<> sourceBlock) : Source() {
 
     if (!sourceBlock.contains("tag")) {
@@ -230,6 +398,48 @@ public:
 
     uri = ipv4_details_j[URI].get<std::string>();
     port = ipv4_details_j[PORT].get<int>();
+
+    if (ipv4_details_j.contains(TLS)) {
+      parseTls(ipv4_details_j[TLS]);
+    }
+  }
+
+  /**
+   * @brief Parse the `tls` block of the IPv4 details
+   *
+   * @param[in] tls_j The `tls` json block
+   */
+  void parseTls(const nlohmann::basic_json<> &tls_j) {
+    if (!tls_j.is_object()) {
+      throw std::runtime_error("tls is not an object in config");
+    }
+
+    tls.enabled = true;
+    for (auto [key, value] : {std::pair{"cert_file", &tls.cert_file},
+                              std::pair{"key_file", &tls.key_file},
+                              std::pair{"ca_file", &tls.ca_file},
+                              std::pair{"server_name", &tls.server_name}}) {
+      if (!tls_j.contains(key))
+        continue;
+      if (!tls_j[key].is_string()) {
+        throw std::runtime_error(
+            std::format("tls.{} is not a string in config", key));
+      }
+      *value = tls_j[key].get<std::string>();
+    }
+
+    for (auto key : {"verify_peer", "ktls"}) {
+      if (tls_j.contains(key) && !tls_j[key].is_boolean()) {
+        throw std::runtime_error(
+            std::format("tls.{} is not a boolean in config", key));
+      }
+    }
+    if (tls_j.contains("verify_peer"))
+      tls.verify_peer = tls_j["verify_peer"].get<bool>();
+    if (tls_j.contains("ktls"))
+      tls.ktls = tls_j["ktls"].get<bool>();
+    if (tls.server_name.empty())
+      tls.server_name = uri;
   }
 
   /**
@@ -266,11 +476,343 @@ public:
     return std::format("{} : {}", uri, port);
   }
 
+  /**
+   * @brief TLS settings of the source
+   *
+   * @return The settings or nullptr if the `tls` block is absent
+   */
+  const TlsConfig *getTls() const override {
+    return tls.enabled ? &tls : nullptr;
+  }
+
   Source * clone() override {
     return  new IPv4Source(*this);
   }
 };
 
+/**
+ * @brief Class for modelling a local archive of rolling segment files
+ * @note Only valid as an output
+ */
+class FileSource : public Source {
+private:
+  using json = nlohmann::json;
+
+public:
+  /// Directory holding the segments
+  std::string dir;
+
+  /// Segment files are named `{prefix}-{start time in ns}.log`
+  std::string prefix;
+
+  /// A segment is rotated after this many bytes...
+  uint64_t segment_bytes = 256ull << 20;
+
+  /// ...or after this many seconds, whichever comes first
+  uint64_t segment_seconds = 3600;
+
+  /// Size of the batches handed to `pwrite`
+  uint64_t write_batch_bytes = 1 << 20;
+
+  /// One time index entry is written every this many bytes
+  uint64_t index_interval_bytes = 64 << 10;
+
+  /// A partial batch is written after this many milliseconds
+  uint64_t flush_ms = 200;
+
+  /// Data queued beyond this is dropped rather than blocking the inputs
+  uint64_t max_pending_bytes = 64ull << 20;
+
+  FileSource(nlohmann::basic_json<> sourceBlock) : Source() {
+    if (!sourceBlock.contains("tag")) {
+      throw std::runtime_error("Tag not provided for the block\n");
+    }
+
+    if (!sourceBlock["tag"].is_string()) {
+      throw std::runtime_error("Tag type is not string");
+    }
+
+    tag = sourceBlock["tag"].get<std::string>();
+
+    if (!sourceBlock.contains(FILE_STRING)) {
+      throw std::runtime_error("No file info found! Check if FILE defined");
+    }
+
+    auto file_details_j = sourceBlock[FILE_STRING];
+
+    if (!file_details_j.contains("dir") || !file_details_j["dir"].is_string()) {
+      throw std::runtime_error("Archive dir is not a string in config");
+    }
+    dir = file_details_j["dir"].get<std::string>();
+
+    prefix = tag;
+    if (file_details_j.contains("prefix")) {
+      if (!file_details_j["prefix"].is_string()) {
+        throw std::runtime_error("Archive prefix is not a string in config");
+      }
+      prefix = file_details_j["prefix"].get<std::string>();
+    }
+
+    for (auto [key, value] :
+         {std::pair{"segment_bytes", &segment_bytes},
+          std::pair{"segment_seconds", &segment_seconds},
+          std::pair{"write_batch_bytes", &write_batch_bytes},
+          std::pair{"index_interval_bytes", &index_interval_bytes},
+          std::pair{"flush_ms", &flush_ms},
+          std::pair{"max_pending_bytes", &max_pending_bytes}}) {
+      if (!file_details_j.contains(key))
+        continue;
+      if (!file_details_j[key].is_number_unsigned() ||
+          file_details_j[key].get<uint64_t>() == 0) {
+        throw std::runtime_error(
+            std::format("{} is not a positive integer in config", key));
+      }
+      *value = file_details_j[key].get<uint64_t>();
+    }
+  }
+
+  /**
+   * @brief Not a socket
+   *
+   * @return -1
+   */
+  int getTypeOfSocket() const override { return -1; }
+
+  /**
+   * @brief Gets you where the segments are written
+   *
+   * @return `{dir}/{prefix}-*`
+   */
+  std::string getLocation() const override {
+    return std::format("{}/{}-*", dir, prefix);
+  }
+
+  Source *clone() override { return new FileSource(*this); }
+};
+
+/**
+ * @brief Class for modelling a link to another core
+ * @details As an output the data of every input routed to it is multiplexed,
+ *          tagged with the input and client stream it came from, over a small
+ *          pool of persistent connections. As an input it accepts such links
+ *          and restores the original input tag of every record.
+ */
+class RelaySource : public Source {
+private:
+  using json = nlohmann::json;
+  std::string_view URI = "uri";
+  std::string_view PORT = "port";
+  std::string_view CONNECTIONS = "connections";
+  std::string_view ROUTES = "routes";
+
+public:
+  std::string uri;
+  int port;
+
+  /// Connections to the downstream core, only used as an output
+  uint32_t connections = 1;
+
+  /// Data queued on a connection beyond this is dropped, only used as an
+  /// output
+  uint64_t max_pending_bytes = 16ull << 20;
+
+  /**
+   * @brief Outputs of records by the tag they entered the upstream core with
+   * @detail Only valid as an input. Tags not listed go to `output`
+   */
+  std::unordered_map<std::string, std::vector<std::string>> routes;
+
+  RelaySource(nlohmann::basic_json<> sourceBlock) : Source() {
+    if (!sourceBlock.contains("tag")) {
+      throw std::runtime_error("Tag not provided for the block\n");
+    }
+
+    if (!sourceBlock["tag"].is_string()) {
+      throw std::runtime_error("Tag type is not string");
+    }
+
+    tag = sourceBlock["tag"].get<std::string>();
+
+    if (!sourceBlock.contains(RELAY_STRING)) {
+      throw std::runtime_error("No relay info found! Check if RELAY defined");
+    }
+
+    auto relay_details_j = sourceBlock[RELAY_STRING];
+
+    if (!relay_details_j.contains(URI) || !relay_details_j[URI].is_string()) {
+      throw std::runtime_error("URI not a string in config");
+    }
+    uri = relay_details_j[URI].get<std::string>();
+
+    if (!relay_details_j.contains(PORT) ||
+        !relay_details_j[PORT].is_number()) {
+      throw std::runtime_error("PORT not a number in config");
+    }
+    port = relay_details_j[PORT].get<int>();
+
+    if (relay_details_j.contains(CONNECTIONS)) {
+      if (!relay_details_j[CONNECTIONS].is_number_unsigned() ||
+          relay_details_j[CONNECTIONS].get<uint32_t>() == 0) {
+        throw std::runtime_error(
+            std::format("{} is not a positive integer in config", CONNECTIONS));
+      }
+      connections = relay_details_j[CONNECTIONS].get<uint32_t>();
+    }
+
+    if (relay_details_j.contains("max_pending_bytes")) {
+      if (!relay_details_j["max_pending_bytes"].is_number_unsigned() ||
+          relay_details_j["max_pending_bytes"].get<uint64_t>() == 0) {
+        throw std::runtime_error(
+            "max_pending_bytes is not a positive integer in config");
+      }
+      max_pending_bytes = relay_details_j["max_pending_bytes"].get<uint64_t>();
+    }
+
+    if (sourceBlock.contains(ROUTES)) {
+      if (!sourceBlock[ROUTES].is_object()) {
+        throw std::runtime_error(
+            std::format("routes is not an object for {}", tag));
+      }
+      for (auto &[origin, outputs_j] : sourceBlock[ROUTES].items()) {
+        if (!outputs_j.is_array()) {
+          throw std::runtime_error(std::format(
+              "routes.{} is not an array of tags for {}", origin, tag));
+        }
+        auto &outputs = routes[origin];
+        for (auto &out : outputs_j) {
+          if (!out.is_string()) {
+            throw std::runtime_error(std::format(
+                "routes.{} is not an array of tags for {}", origin, tag));
+          }
+          outputs.push_back(out.get<std::string>());
+        }
+      }
+    }
+  }
+
+  /**
+   * @brief Construct a IPv4 socket
+   *
+   * @param[out] out The constructed socket
+   * @return size of the socket
+   */
+  socklen_t constructSock(struct sockaddr_storage *out) const override {
+    struct sockaddr_in *ipv4_addr = (struct sockaddr_in *)(out);
+    memset(ipv4_addr, 0, sizeof(*ipv4_addr));
+    ipv4_addr->sin_family = AF_INET;
+    ipv4_addr->sin_port = htons(port);
+    inet_pton(AF_INET, uri.c_str(), &(ipv4_addr->sin_addr));
+    return sizeof(*ipv4_addr);
+  }
+
+  /**
+   * @brief Links run over IPv4
+   *
+   * @return `AF_INET`
+   */
+  int getTypeOfSocket() const override { return AF_INET; }
+
+  /**
+   * @brief Gets uri and port number
+   *
+   * @return A string having {uri} : {port}
+   */
+  std::string getLocation() const override {
+    return std::format("{} : {}", uri, port);
+  }
+
+  Source *clone() override { return new RelaySource(*this); }
+};
+
+/**
+ * @brief Class for modelling a shared memory ring fed by a local shipper
+ * @details Shippers connect to a UNIX control socket. Each one is handed a
+ *          ring of its own (see shm/shm_ring.hpp) and writes its data there
+ *          instead of on the socket.
+ * @note Only valid as an input
+ */
+class ShmSource : public Source {
+private:
+  using json = nlohmann::json;
+  std::string_view SHM_FILEPATH = "sock_file_path";
+  std::string_view RING_BYTES = "ring_bytes";
+
+public:
+  /// Control socket the shippers connect to
+  std::string socket_file_path;
+
+  /// Size of the ring of every shipper
+  uint64_t ring_bytes = 4 << 20;
+
+  ShmSource(nlohmann::basic_json<> sourceBlock) : Source() {
+    if (!sourceBlock.contains("tag")) {
+      throw std::runtime_error("Tag not provided for the block\n");
+    }
+
+    if (!sourceBlock["tag"].is_string()) {
+      throw std::runtime_error("Tag type is not string");
+    }
+
+    tag = sourceBlock["tag"].get<std::string>();
+
+    if (!sourceBlock.contains(SHM_STRING)) {
+      throw std::runtime_error("No shm info found! Check if SHM defined");
+    }
+
+    auto shm_detail_j = sourceBlock[SHM_STRING];
+
+    if (!shm_detail_j.contains(SHM_FILEPATH) ||
+        !shm_detail_j[SHM_FILEPATH].is_string()) {
+      throw std::runtime_error("Socket filepath is not a string!");
+    }
+    socket_file_path = shm_detail_j[SHM_FILEPATH].get<std::string>();
+
+    if (shm_detail_j.contains(RING_BYTES)) {
+      if (!shm_detail_j[RING_BYTES].is_number_unsigned() ||
+          shm_detail_j[RING_BYTES].get<uint64_t>() == 0) {
+        throw std::runtime_error(
+            std::format("{} is not a positive integer in config", RING_BYTES));
+      }
+      ring_bytes = shm_detail_j[RING_BYTES].get<uint64_t>();
+    }
+  }
+
+  /**
+   * @brief Setup the control socket
+   *
+   * @param[out] out `sockaddr_storage`
+   * @return sizeof the socket
+   */
+  socklen_t constructSock(struct sockaddr_storage *out) const override {
+    struct sockaddr_un *unix_addr = (struct sockaddr_un *)(out);
+    unix_addr->sun_family = AF_UNIX;
+    std::strncpy(unix_addr->sun_path, socket_file_path.c_str(), 100);
+    return sizeof(*unix_addr);
+  }
+
+  /**
+   * @brief The control socket is a UNIX Socket
+   *
+   * @return `AF_UNIX`
+   */
+  int getTypeOfSocket() const override { return AF_UNIX; }
+
+  /**
+   * @brief Gets you the control socket file path
+   *
+   * @return The socket file path
+   */
+  std::string getLocation() const override { return socket_file_path; }
+
+  /**
+   * @brief Remove the socket file
+   *
+   */
+  void cleanUp() const override { std::filesystem::remove(socket_file_path); }
+
+  Source *clone() override { return new ShmSource(*this); }
+};
+
 /**
  * @brief It is an invalid Source
  */
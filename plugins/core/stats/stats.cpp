@@ -0,0 +1,105 @@
+#include "stats.hpp"
+
+#include <cstdio>
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <thread>
+
+Histogram::Histogram(std::vector<double> bounds)
+    : bounds(std::move(bounds)),
+      buckets(new std::atomic<uint64_t>[this->bounds.size() + 1]()) {}
+
+std::vector<double> Histogram::latencyBounds() {
+  return {0.00001, 0.00005, 0.0001, 0.0005, 0.001, 0.005,
+          0.01,    0.05,    0.1,    0.5,    1,     5,     10};
+}
+
+void Histogram::observe(double value) {
+  size_t bucket = 0;
+  while (bucket < bounds.size() && value > bounds[bucket])
+    ++bucket;
+  buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+  sum.fetch_add(value, std::memory_order_relaxed);
+  count.fetch_add(1, std::memory_order_relaxed);
+}
+
+void Histogram::render(const std::string &name, const std::string &labels,
+                       std::string &out) const {
+  std::string prefix = labels.empty() ? "" : labels + ",";
+  uint64_t cumulative = 0;
+  for (size_t bucket = 0; bucket <= bounds.size(); ++bucket) {
+    cumulative += buckets[bucket].load(std::memory_order_relaxed);
+    std::string le =
+        bucket < bounds.size() ? std::format("{}", bounds[bucket]) : "+Inf";
+    out += name + "_bucket{" + prefix + "le=\"" + le + "\"} " +
+           std::to_string(cumulative) + "\n";
+  }
+  std::string braces = labels.empty() ? "" : "{" + labels + "}";
+  out += std::format("{}_sum{} {}\n", name, braces,
+                     sum.load(std::memory_order_relaxed));
+  out += std::format("{}_count{} {}\n", name, braces,
+                     count.load(std::memory_order_relaxed));
+}
+
+StatsRegistry &StatsRegistry::instance() {
+  static StatsRegistry registry;
+  return registry;
+}
+
+std::atomic<uint64_t> &StatsRegistry::counter(const std::string &name,
+                                              const std::string &labels) {
+  std::string key = labels.empty() ? name : name + "{" + labels + "}";
+
+  std::lock_guard<std::mutex> guard(lock);
+  auto &slot = counters[key];
+  if (!slot) {
+    slot = std::make_unique<std::atomic<uint64_t>>(0);
+  }
+  return *slot;
+}
+
+Histogram &StatsRegistry::histogram(const std::string &name,
+                                    const std::string &labels,
+                                    std::vector<double> bounds) {
+  std::lock_guard<std::mutex> guard(lock);
+  auto &slot = histograms[{name, labels}];
+  if (!slot) {
+    slot = std::make_unique<Histogram>(std::move(bounds));
+  }
+  return *slot;
+}
+
+std::string StatsRegistry::render() {
+  std::string out;
+  std::lock_guard<std::mutex> guard(lock);
+  for (auto &[key, value] : counters) {
+    out += std::format("{} {}\n", key, value->load(std::memory_order_relaxed));
+  }
+  for (auto &[key, histogram] : histograms) {
+    histogram->render(key.first, key.second, out);
+  }
+  return out;
+}
+
+void StatsRegistry::exportLoop(StatsConfig config) {
+  // Write to a temporary file and rename it so readers never see a
+  // half written snapshot
+  std::string tmp_path = config.path + ".tmp";
+  while (true) {
+    std::this_thread::sleep_for(config.interval);
+
+    std::ofstream out(tmp_path, std::ios::trunc);
+    if (!out) {
+      std::cerr << std::format("Couldn't open stats file {}\n", tmp_path);
+      continue;
+    }
+    out << render();
+    out.close();
+
+    if (std::rename(tmp_path.c_str(), config.path.c_str()) != 0) {
+      std::cerr << std::format("Couldn't publish stats file {}\n",
+                               config.path);
+    }
+  }
+}
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief Where and how often the core exports its counters
+ */
+struct StatsConfig {
+  /// File the counters are written to. Empty disables exporting
+  std::string path;
+
+  /// How often the file is rewritten
+  std::chrono::milliseconds interval{1000};
+};
+
+/**
+ * @brief Prometheus style histogram with fixed bucket bounds
+ * @details Observing is a short scan over the bounds and two relaxed atomic
+ *          increments, cheap enough for the data path.
+ */
+class Histogram {
+public:
+  /**
+   * @param[in] bounds Upper bounds of the buckets, ascending
+   */
+  explicit Histogram(std::vector<double> bounds);
+
+  /**
+   * @brief Bounds suited to latencies in seconds, 10us up to 10s
+   */
+  static std::vector<double> latencyBounds();
+
+  /**
+   * @brief Count one value
+   */
+  void observe(double value);
+
+  /**
+   * @brief Append the `_bucket`, `_sum` and `_count` series to `out`
+   */
+  void render(const std::string &name, const std::string &labels,
+              std::string &out) const;
+
+private:
+  std::vector<double> bounds;
+  /// One per bound plus +Inf, not cumulative
+  std::unique_ptr<std::atomic<uint64_t>[]> buckets;
+  std::atomic<double> sum{0};
+  std::atomic<uint64_t> count{0};
+};
+
+/**
+ * @brief Process wide registry of named counters
+ * @details Counters are registered once (usually when a service starts) and
+ *          the returned reference is kept around, so the data path only pays
+ *          for a relaxed atomic increment.
+ */
+class StatsRegistry {
+public:
+  /**
+   * @brief Get the registry shared by the whole core
+   */
+  static StatsRegistry &instance();
+
+  /**
+   * @brief Get (or create) a monotonically increasing counter
+   *
+   * @param[in] name Metric name, e.g. `dislog_ratelimit_dropped_records_total`
+   * @param[in] labels Prometheus style labels without braces, e.g.
+   *                   `input="SYSLOG"`
+   * @return Reference which stays valid for the lifetime of the process
+   */
+  std::atomic<uint64_t> &counter(const std::string &name,
+                                 const std::string &labels = "");
+
+  /**
+   * @brief Get (or create) a value which may go up and down
+   * @details Same storage as a counter, only named without `_total`
+   */
+  std::atomic<uint64_t> &gauge(const std::string &name,
+                               const std::string &labels = "") {
+    return counter(name, labels);
+  }
+
+  /**
+   * @brief Get (or create) a histogram
+   *
+   * @param[in] name Metric name without the `_bucket` suffix
+   * @param[in] labels Prometheus style labels without braces
+   * @param[in] bounds Bucket bounds, only used when the histogram is created
+   * @return Reference which stays valid for the lifetime of the process
+   */
+  Histogram &histogram(const std::string &name, const std::string &labels,
+                       std::vector<double> bounds = Histogram::latencyBounds());
+
+  /**
+   * @brief Render every counter in the Prometheus text format
+   */
+  std::string render();
+
+  /**
+   * @brief Periodically write `render()` to `config.path`
+   * @note Blocks forever, run it on its own thread
+   *
+   * @param[in] config Export destination and interval
+   */
+  void exportLoop(StatsConfig config);
+
+private:
+  StatsRegistry() = default;
+
+  std::mutex lock;
+  std::map<std::string, std::unique_ptr<std::atomic<uint64_t>>> counters;
+  std::map<std::pair<std::string, std::string>, std::unique_ptr<Histogram>>
+      histograms;
+};
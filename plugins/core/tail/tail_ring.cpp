@@ -0,0 +1,99 @@
+#include "tail_ring.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <unordered_map>
+
+// Filled before the services start and only read afterwards
+static std::unordered_map<std::string, std::unique_ptr<TailRing>> rings;
+
+TailRing::TailRing(size_t bytes)
+    : data(std::bit_ceil(std::max<size_t>(bytes, 4096))),
+      mask(data.size() - 1), slots(std::make_unique<Slot[]>(SLOTS)) {}
+
+void TailRing::add(const std::string &tag, size_t bytes) {
+  rings[tag] = std::make_unique<TailRing>(bytes);
+}
+
+TailRing *TailRing::get(const std::string &tag) {
+  auto ring = rings.find(tag);
+  return ring == rings.end() ? nullptr : ring->second.get();
+}
+
+void TailRing::publish(std::string_view records) {
+  // A batch may take up to a quarter of the ring so a reader has a chance
+  // to copy it out before it is overwritten. Larger ones are cut between
+  // records
+  size_t limit = data.size() / 4;
+  while (records.size() > limit) {
+    size_t cut = records.rfind('\n', limit - 1);
+    if (cut == std::string_view::npos) {
+      // A single record larger than that isn't worth showing
+      cut = records.find('\n', limit);
+      if (cut == std::string_view::npos)
+        return;
+      records.remove_prefix(cut + 1);
+      continue;
+    }
+    append(records.substr(0, cut + 1));
+    records.remove_prefix(cut + 1);
+  }
+  if (!records.empty())
+    append(records);
+}
+
+void TailRing::append(std::string_view records) {
+  uint64_t seq = published.load(std::memory_order_relaxed);
+  uint64_t start = published_bytes.load(std::memory_order_relaxed);
+  uint64_t end = start + records.size();
+
+  // Readers see the claim before any byte or slot they copy changes
+  claimed.store(seq + 1, std::memory_order_relaxed);
+  claimed_bytes.store(end, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+
+  size_t at = start & mask;
+  size_t first = std::min(records.size(), data.size() - at);
+  std::memcpy(data.data() + at, records.data(), first);
+  std::memcpy(data.data(), records.data() + first, records.size() - first);
+
+  Slot &slot = slots[seq % SLOTS];
+  slot.start.store(start, std::memory_order_relaxed);
+  slot.end.store(end, std::memory_order_relaxed);
+  published_bytes.store(end, std::memory_order_release);
+  published.store(seq + 1, std::memory_order_release);
+}
+
+TailRing::ReadStatus TailRing::read(uint64_t seq, std::string &out,
+                                    uint64_t &end) const {
+  uint64_t next = published.load(std::memory_order_acquire);
+  if (seq >= next)
+    return ReadStatus::Empty;
+  if (next - seq >= SLOTS)
+    return ReadStatus::Lost;
+
+  const Slot &slot = slots[seq % SLOTS];
+  uint64_t start = slot.start.load(std::memory_order_relaxed);
+  uint64_t stop = slot.end.load(std::memory_order_relaxed);
+  if (stop < start || stop - start > data.size())
+    return ReadStatus::Lost;
+
+  // The copy may race with the writer, it is thrown away if the writer got
+  // there first
+  size_t old_size = out.size();
+  size_t size = stop - start;
+  size_t at = start & mask;
+  size_t first = std::min(size, data.size() - at);
+  out.append(data.data() + at, first);
+  out.append(data.data(), size - first);
+
+  std::atomic_thread_fence(std::memory_order_acquire);
+  if (claimed.load(std::memory_order_relaxed) - seq > SLOTS ||
+      claimed_bytes.load(std::memory_order_relaxed) > start + data.size()) {
+    out.resize(old_size);
+    return ReadStatus::Lost;
+  }
+  end = stop;
+  return ReadStatus::Read;
+}
@@ -0,0 +1,121 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * @brief Top level `tail` block of the core config
+ */
+struct TailConfig {
+  /// UNIX socket subscribers connect to. Empty disables live tailing
+  std::string socket_path;
+
+  /// Size of the ring of recent records of every input
+  size_t ring_bytes = 1024 * 1024;
+};
+
+/**
+ * @brief Ring of the recent records of one input, read by live subscribers
+ * @details The service thread of the input is the only writer and never
+ *          waits for a reader: it copies each forwarded batch into a byte
+ *          ring and publishes where the batch starts and ends in a ring of
+ *          slots. Readers copy a batch out and then check that the writer
+ *          didn't reach it in the meantime, like a seqlock. A reader which
+ *          was overtaken learns that it lost records and skips to the
+ *          newest batch.
+ *
+ *          Nothing is copied while nobody is subscribed.
+ */
+class TailRing {
+public:
+  /// Batches the ring keeps track of, whatever their size
+  static constexpr size_t SLOTS = 4096;
+
+  enum class ReadStatus {
+    /// The batch was appended
+    Read,
+    /// Not published yet
+    Empty,
+    /// Overwritten, the reader fell behind
+    Lost,
+  };
+
+  /**
+   * @param[in] bytes Size of the byte ring, rounded up to a power of two
+   */
+  explicit TailRing(size_t bytes);
+
+  /**
+   * @brief Create the ring of an input
+   * @note Call before the services start, the registry isn't locked
+   */
+  static void add(const std::string &tag, size_t bytes);
+
+  /**
+   * @brief Get the ring of an input, null if live tailing is off
+   */
+  static TailRing *get(const std::string &tag);
+
+  /**
+   * @brief Is anybody reading
+   */
+  bool subscribed() const {
+    return subscribers.load(std::memory_order_relaxed) > 0;
+  }
+
+  void subscribe() { subscribers.fetch_add(1, std::memory_order_relaxed); }
+  void unsubscribe() { subscribers.fetch_sub(1, std::memory_order_relaxed); }
+
+  /**
+   * @brief Copy a batch of whole records in
+   * @note Service thread of the input only
+   */
+  void publish(std::string_view records);
+
+  /**
+   * @brief Number of the next batch to be published
+   */
+  uint64_t next() const { return published.load(std::memory_order_acquire); }
+
+  /**
+   * @brief Bytes published so far, where the next batch starts
+   */
+  uint64_t bytes() const {
+    return published_bytes.load(std::memory_order_acquire);
+  }
+
+  /**
+   * @brief Copy batch `seq` out
+   *
+   * @param[in] seq Number of the batch
+   * @param[out] out The batch is appended to it
+   * @param[out] end Byte position the batch ends at, if read
+   */
+  ReadStatus read(uint64_t seq, std::string &out, uint64_t &end) const;
+
+private:
+  struct Slot {
+    std::atomic<uint64_t> start{0};
+    std::atomic<uint64_t> end{0};
+  };
+
+  void append(std::string_view records);
+
+  std::vector<char> data;
+  size_t mask;
+  std::unique_ptr<Slot[]> slots;
+
+  /// Bytes and batches the writer is about to overwrite, stored before it
+  /// touches them
+  std::atomic<uint64_t> claimed_bytes{0};
+  std::atomic<uint64_t> claimed{0};
+  /// Batches and bytes readers may copy
+  std::atomic<uint64_t> published{0};
+  std::atomic<uint64_t> published_bytes{0};
+
+  std::atomic<uint32_t> subscribers{0};
+};
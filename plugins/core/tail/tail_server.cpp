@@ -0,0 +1,240 @@
+#include "tail_server.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <format>
+#include <iostream>
+#include <list>
+#include <poll.h>
+#include <string>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <thread>
+#include <trace/trace_stamp.hpp>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+/// How often the rings are checked for new records
+constexpr int POLL_MS = 20;
+
+/// Longest subscription line accepted
+constexpr size_t REQUEST_MAX = 1024;
+
+/// Bytes taken from the ring per subscriber and round, so one busy input
+/// doesn't starve the other subscribers
+constexpr size_t TURN_BYTES = 256 * 1024;
+
+struct Subscriber {
+  int fd;
+  /// The subscription line as it comes in
+  std::string request;
+  /// The subscriber shut down its side, e.g. `socat` after the line
+  bool eof = false;
+
+  /// Set once subscribed
+  TailRing *ring = nullptr;
+  std::string filter;
+  uint64_t seq = 0;
+  uint64_t next_byte = 0;
+
+  /// Not yet taken by the socket
+  std::string pending;
+  size_t sent = 0;
+};
+
+/**
+ * @brief Send what the socket takes without blocking
+ *
+ * @return False if the subscriber is gone
+ */
+bool flush(Subscriber &sub) {
+  while (sub.sent < sub.pending.size()) {
+    ssize_t result = send(sub.fd, sub.pending.data() + sub.sent,
+                          sub.pending.size() - sub.sent,
+                          MSG_NOSIGNAL | MSG_DONTWAIT);
+    if (result < 0) {
+      if (errno == EINTR)
+        continue;
+      return errno == EAGAIN || errno == EWOULDBLOCK;
+    }
+    sub.sent += result;
+  }
+  sub.pending.clear();
+  sub.sent = 0;
+  return true;
+}
+
+/**
+ * @brief Parse the subscription line once it is complete
+ *
+ * @return False if the subscriber is to be dropped
+ */
+bool subscribe(Subscriber &sub) {
+  size_t newline = sub.request.find('\n');
+  if (newline == std::string::npos)
+    return sub.request.size() <= REQUEST_MAX;
+
+  std::string line = sub.request.substr(0, newline);
+  if (line.ends_with('\r'))
+    line.pop_back();
+  size_t space = line.find(' ');
+  std::string tag = line.substr(0, space);
+  if (space != std::string::npos)
+    sub.filter = line.substr(space + 1);
+
+  sub.ring = TailRing::get(tag);
+  if (!sub.ring) {
+    sub.pending = std::format("ERR unknown input {}\n", tag);
+    flush(sub);
+    return false;
+  }
+  sub.ring->subscribe();
+  sub.seq = sub.ring->next();
+  sub.next_byte = sub.ring->bytes();
+  return true;
+}
+
+/**
+ * @brief Move new records of the ring to the subscriber
+ *
+ * @return False if the subscriber is gone
+ */
+bool pump(Subscriber &sub, std::string &batch) {
+  if (!flush(sub))
+    return false;
+  // A subscriber whose socket is full falls behind in the ring instead
+  if (!sub.pending.empty())
+    return true;
+
+  while (sub.pending.size() < TURN_BYTES) {
+    batch.clear();
+    uint64_t end = 0;
+    TailRing::ReadStatus status = sub.ring->read(sub.seq, batch, end);
+    if (status == TailRing::ReadStatus::Empty)
+      break;
+
+    if (status == TailRing::ReadStatus::Lost) {
+      uint64_t bytes = sub.ring->bytes();
+      sub.seq = sub.ring->next();
+      sub.pending += std::format("--- dislog tail: skipped {} bytes ---\n",
+                                 bytes - sub.next_byte);
+      sub.next_byte = bytes;
+      continue;
+    }
+
+    ++sub.seq;
+    sub.next_byte = end;
+    std::string_view records(batch);
+    while (!records.empty()) {
+      size_t newline = records.find('\n');
+      std::string_view record = newline == std::string_view::npos
+                                    ? records
+                                    : records.substr(0, newline + 1);
+      records.remove_prefix(record.size());
+      if (trace::is_stamp(record))
+        continue;
+      if (sub.filter.empty() ||
+          record.find(sub.filter) != std::string_view::npos)
+        sub.pending += record;
+    }
+  }
+  return flush(sub);
+}
+
+void drop(Subscriber &sub) {
+  if (sub.ring)
+    sub.ring->unsubscribe();
+  close(sub.fd);
+}
+
+void serve(int listen_fd) {
+  std::list<Subscriber> subs;
+  std::vector<pollfd> fds;
+  std::string batch;
+  char buf[4096];
+
+  while (true) {
+    fds.assign(1, pollfd{listen_fd, POLLIN, 0});
+    for (Subscriber &sub : subs) {
+      short events = sub.eof ? 0 : POLLIN;
+      if (!sub.pending.empty())
+        events |= POLLOUT;
+      fds.push_back(pollfd{sub.fd, events, 0});
+    }
+    if (poll(fds.data(), fds.size(), POLL_MS) < 0 && errno != EINTR) {
+      std::cerr << "Tail poll failed: " << std::strerror(errno) << '\n';
+      return;
+    }
+
+    if (fds[0].revents & POLLIN) {
+      while (true) {
+        int fd = accept4(listen_fd, nullptr, nullptr,
+                         SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0)
+          break;
+        subs.push_back(Subscriber{fd});
+      }
+    }
+
+    // Subscribers accepted just now are past the end of `fds`
+    size_t n = 1;
+    for (auto sub = subs.begin(); sub != subs.end(); ++n) {
+      short revents = n < fds.size() ? fds[n].revents : 0;
+      bool keep = !(revents & POLLERR);
+
+      if (keep && !sub->eof && (revents & (POLLIN | POLLHUP))) {
+        ssize_t size = read(sub->fd, buf, sizeof(buf));
+        if (size < 0 && errno != EAGAIN && errno != EINTR) {
+          keep = false;
+        } else if (size == 0) {
+          sub->eof = true;
+        } else if (size > 0 && !sub->ring) {
+          sub->request.append(buf, size);
+          keep = subscribe(*sub);
+        }
+      } else if (sub->eof && (revents & POLLHUP)) {
+        // Both sides are shut now
+        keep = false;
+      }
+      if (sub->eof && !sub->ring)
+        keep = false;
+      if (keep && sub->ring)
+        keep = pump(*sub, batch);
+
+      if (keep) {
+        ++sub;
+      } else {
+        drop(*sub);
+        sub = subs.erase(sub);
+      }
+    }
+  }
+}
+
+} // namespace
+
+void TailServer::start(const TailConfig &config) {
+  struct sockaddr_un addr{};
+  addr.sun_family = AF_UNIX;
+  if (config.socket_path.size() >= sizeof(addr.sun_path)) {
+    std::cerr << std::format("Tail socket path {} is too long\n",
+                             config.socket_path);
+    return;
+  }
+  std::strcpy(addr.sun_path, config.socket_path.c_str());
+
+  int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  // A socket left behind by a previous run
+  unlink(config.socket_path.c_str());
+  if (fd < 0 || bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+      listen(fd, SOMAXCONN) < 0) {
+    std::cerr << std::format("Couldn't serve live tails on {}: {}\n",
+                             config.socket_path, std::strerror(errno));
+    if (fd >= 0)
+      close(fd);
+    return;
+  }
+  std::thread(serve, fd).detach();
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <tail/tail_ring.hpp>
+
+/**
+ * @brief Serves live tails of the inputs on a UNIX socket
+ * @details A subscriber connects and sends one line, the tag of an input
+ *          optionally followed by a space and a substring:
+ *
+ *              printf 'SYSLOG sshd\n' | socat - UNIX-CONNECT:/run/dislog/tail.sock
+ *
+ *          From then on it receives the records of the input (that contain
+ *          the substring) as they are forwarded. The server thread polls the
+ *          rings of the inputs and never holds up their service threads: a
+ *          subscriber which doesn't keep up misses records and gets a
+ *          `--- dislog tail: skipped N bytes ---` line in their place.
+ *          An unknown tag gets an `ERR` line and the connection is closed.
+ */
+class TailServer {
+public:
+  /**
+   * @brief Start the server thread
+   * @note The rings of the inputs must exist already
+   *
+   * @param[in] config The `tail` block
+   */
+  static void start(const TailConfig &config);
+};
@@ -0,0 +1,212 @@
+#include "tls_session.hpp"
+
+#include <arpa/inet.h>
+#include <atomic>
+#include <cerrno>
+#include <format>
+#include <openssl/err.h>
+#include <openssl/ssl.h>
+#include <openssl/x509v3.h>
+#include <stats/stats.hpp>
+#include <stdexcept>
+#include <unistd.h>
+
+/**
+ * @brief Last OpenSSL error as a string
+ */
+static std::string ssl_error() {
+  char buf[256];
+  ERR_error_string_n(ERR_get_error(), buf, sizeof(buf));
+  return buf;
+}
+
+TlsContext::TlsContext(const TlsConfig &config, bool server,
+                       const std::string &tag)
+    : server(server), verify(config.verify_peer.value_or(!server)),
+      config(config), tag(tag) {
+  ctx = SSL_CTX_new(server ? TLS_server_method() : TLS_client_method());
+  if (ctx == nullptr) {
+    throw std::runtime_error(
+        std::format("Couldn't create TLS context for {}: {}", tag, ssl_error()));
+  }
+
+  // Older peers still get TLS 1.2, the kernel can offload both versions
+  SSL_CTX_set_min_proto_version(ctx, TLS1_2_VERSION);
+  SSL_CTX_set_mode(ctx, SSL_MODE_ENABLE_PARTIAL_WRITE |
+                            SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER);
+  if (config.ktls)
+    SSL_CTX_set_options(ctx, SSL_OP_ENABLE_KTLS);
+
+  if (server && (config.cert_file.empty() || config.key_file.empty())) {
+    SSL_CTX_free(ctx);
+    throw std::runtime_error(
+        std::format("TLS input {} needs cert_file and key_file", tag));
+  }
+
+  if (!config.cert_file.empty() &&
+      SSL_CTX_use_certificate_chain_file(ctx, config.cert_file.c_str()) != 1) {
+    std::string err = ssl_error();
+    SSL_CTX_free(ctx);
+    throw std::runtime_error(std::format("Couldn't load {} for {}: {}",
+                                         config.cert_file, tag, err));
+  }
+
+  if (!config.key_file.empty() &&
+      SSL_CTX_use_PrivateKey_file(ctx, config.key_file.c_str(),
+                                  SSL_FILETYPE_PEM) != 1) {
+    std::string err = ssl_error();
+    SSL_CTX_free(ctx);
+    throw std::runtime_error(std::format("Couldn't load {} for {}: {}",
+                                         config.key_file, tag, err));
+  }
+
+  if (!config.ca_file.empty() &&
+      SSL_CTX_load_verify_locations(ctx, config.ca_file.c_str(), nullptr) !=
+          1) {
+    std::string err = ssl_error();
+    SSL_CTX_free(ctx);
+    throw std::runtime_error(std::format("Couldn't load {} for {}: {}",
+                                         config.ca_file, tag, err));
+  }
+
+  if (verify && config.ca_file.empty() &&
+      SSL_CTX_set_default_verify_paths(ctx) != 1) {
+    std::string err = ssl_error();
+    SSL_CTX_free(ctx);
+    throw std::runtime_error(std::format(
+        "Couldn't load the system trust store for {}: {}", tag, err));
+  }
+
+  if (verify && !server && config.server_name.empty()) {
+    SSL_CTX_free(ctx);
+    throw std::runtime_error(
+        std::format("TLS output {} needs a server_name to verify", tag));
+  }
+
+  if (verify) {
+    int mode = SSL_VERIFY_PEER;
+    if (server)
+      mode |= SSL_VERIFY_FAIL_IF_NO_PEER_CERT;
+    SSL_CTX_set_verify(ctx, mode, nullptr);
+  }
+}
+
+TlsContext::~TlsContext() { SSL_CTX_free(ctx); }
+
+TlsSession::TlsSession(const TlsContext &context, int fd)
+    : context(context), fd(fd) {
+  ssl = SSL_new(context.get());
+  // A socket BIO is required for OpenSSL to set up kTLS on the fd
+  SSL_set_fd(ssl, fd);
+
+  const TlsConfig &config = context.getConfig();
+  if (context.isServer()) {
+    SSL_set_accept_state(ssl);
+  } else {
+    // SNI can't carry an address, the certificate's IP SAN is checked then
+    const char *name = config.server_name.c_str();
+    in6_addr addr;
+    bool literal = inet_pton(AF_INET, name, &addr) == 1 ||
+                   inet_pton(AF_INET6, name, &addr) == 1;
+    if (!config.server_name.empty() && !literal)
+      SSL_set_tlsext_host_name(ssl, name);
+    if (context.verifies()) {
+      if (literal)
+        X509_VERIFY_PARAM_set1_ip_asc(SSL_get0_param(ssl), name);
+      else
+        SSL_set1_host(ssl, name);
+    }
+    SSL_set_connect_state(ssl);
+  }
+}
+
+TlsSession::~TlsSession() {
+  if (done)
+    SSL_shutdown(ssl);
+  SSL_free(ssl);
+}
+
+TlsSession::Handshake TlsSession::handshake() {
+  if (done)
+    return Handshake::Done;
+
+  int ret = SSL_do_handshake(ssl);
+  if (ret != 1) {
+    switch (SSL_get_error(ssl, ret)) {
+    case SSL_ERROR_WANT_READ:
+      return Handshake::WantRead;
+    case SSL_ERROR_WANT_WRITE:
+      return Handshake::WantWrite;
+    default:
+      StatsRegistry::instance()
+          .counter("dislog_tls_handshake_failures_total",
+                   std::format("source=\"{}\"", context.getTag()))
+          .fetch_add(1, std::memory_order_relaxed);
+      ERR_clear_error();
+      return Handshake::Failed;
+    }
+  }
+
+  done = true;
+  kernel_tx = BIO_get_ktls_send(SSL_get_wbio(ssl)) == 1;
+  kernel_rx = BIO_get_ktls_recv(SSL_get_rbio(ssl)) == 1;
+
+  StatsRegistry::instance()
+      .counter("dislog_tls_sessions_total",
+               std::format("source=\"{}\",tx=\"{}\",rx=\"{}\"",
+                           context.getTag(), kernel_tx ? "kernel" : "software",
+                           kernel_rx ? "kernel" : "software"))
+      .fetch_add(1, std::memory_order_relaxed);
+  return Handshake::Done;
+}
+
+ssize_t TlsSession::read(char *buf, size_t len) {
+  // With kTLS RX OpenSSL only reads the records the kernel already decrypted,
+  // and it still has to deal with control records (alerts, key updates)
+  int ret = SSL_read(ssl, buf, static_cast<int>(len));
+  if (ret > 0)
+    return ret;
+
+  switch (SSL_get_error(ssl, ret)) {
+  case SSL_ERROR_WANT_READ:
+  case SSL_ERROR_WANT_WRITE:
+    errno = EAGAIN;
+    return -1;
+  case SSL_ERROR_ZERO_RETURN:
+    return 0;
+  case SSL_ERROR_SYSCALL:
+    ERR_clear_error();
+    if (ret == 0)
+      return 0; // EOF without close_notify
+    return -1;
+  default:
+    ERR_clear_error();
+    errno = EIO;
+    return -1;
+  }
+}
+
+ssize_t TlsSession::write(const char *buf, size_t len) {
+  if (kernel_tx) {
+    // The kernel frames and encrypts, the fd behaves like a plain socket
+    return ::write(fd, buf, len);
+  }
+
+  int ret = SSL_write(ssl, buf, static_cast<int>(len));
+  if (ret > 0)
+    return ret;
+
+  switch (SSL_get_error(ssl, ret)) {
+  case SSL_ERROR_WANT_READ:
+  case SSL_ERROR_WANT_WRITE:
+    errno = EAGAIN;
+    return -1;
+  case SSL_ERROR_SYSCALL:
+    ERR_clear_error();
+    return -1;
+  default:
+    ERR_clear_error();
+    errno = EIO;
+    return -1;
+  }
+}
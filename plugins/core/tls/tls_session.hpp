@@ -0,0 +1,130 @@
+#pragma once
+
+#include <memory>
+#include <optional>
+#include <string>
+#include <sys/types.h>
+
+// Keep OpenSSL out of every file including `source.hpp`
+struct ssl_st;
+struct ssl_ctx_st;
+
+/**
+ * @brief `tls` block of an `IPv4` source
+ */
+struct TlsConfig {
+  bool enabled = false;
+
+  /// PEM certificate chain. Required for inputs, enables mTLS for outputs
+  std::string cert_file;
+  std::string key_file;
+
+  /// PEM bundle used to verify the peer, the system trust store if empty
+  std::string ca_file;
+
+  /// Inputs: require a client certificate, off by default. Outputs: verify
+  /// the server, on by default
+  std::optional<bool> verify_peer;
+
+  /// SNI and hostname checked against the certificate of an output, the
+  /// `uri` if not set
+  std::string server_name;
+
+  /// Hand the session keys to the kernel (kTLS) when it supports the cipher
+  bool ktls = true;
+};
+
+/**
+ * @brief OpenSSL context of a source, shared by all its connections
+ */
+class TlsContext {
+public:
+  /**
+   * @brief Load the certificates of the source
+   * @note Throws `std::runtime_error` when they can't be loaded
+   *
+   * @param[in] config The `tls` block of the source
+   * @param[in] server True for inputs (accepting side)
+   * @param[in] tag Tag of the source, used for errors and metrics
+   */
+  TlsContext(const TlsConfig &config, bool server, const std::string &tag);
+  ~TlsContext();
+
+  TlsContext(const TlsContext &) = delete;
+  TlsContext &operator=(const TlsContext &) = delete;
+
+  ssl_ctx_st *get() const { return ctx; }
+  bool isServer() const { return server; }
+  const TlsConfig &getConfig() const { return config; }
+  const std::string &getTag() const { return tag; }
+
+  /// Is the peer's certificate checked
+  bool verifies() const { return verify; }
+
+private:
+  ssl_ctx_st *ctx = nullptr;
+  bool server;
+  bool verify;
+  TlsConfig config;
+  std::string tag;
+};
+
+/**
+ * @brief TLS on top of a connected socket
+ * @details Inputs use non-blocking sockets and call `handshake` again on
+ *          `WantRead`/`WantWrite`. Outputs keep their sockets blocking, so
+ *          there the handshake and every write block until done. The
+ *          handshake is done in user space. If the kernel supports the
+ *          negotiated cipher the keys are then installed with `TCP_ULP tls`,
+ *          after which writes go straight to the socket with `write` so
+ *          `writev`, `sendfile` and `splice` keep working on the fd. Otherwise
+ *          OpenSSL encrypts in user space.
+ */
+class TlsSession {
+public:
+  enum class Handshake { Done, WantRead, WantWrite, Failed };
+
+  /**
+   * @brief Start a session on `fd`, the fd stays owned by the caller
+   */
+  TlsSession(const TlsContext &context, int fd);
+  ~TlsSession();
+
+  TlsSession(const TlsSession &) = delete;
+  TlsSession &operator=(const TlsSession &) = delete;
+
+  /**
+   * @brief Drive the handshake, call again when the socket is ready
+   */
+  Handshake handshake();
+
+  bool established() const { return done; }
+
+  /// Is encryption of outgoing records done by the kernel
+  bool kernelTx() const { return kernel_tx; }
+
+  /// Is decryption of incoming records done by the kernel
+  bool kernelRx() const { return kernel_rx; }
+
+  /**
+   * @brief Read decrypted data, same contract as `read(2)`
+   * @return Bytes read, 0 on close_notify or EOF, -1 with errno set
+   *         (`EAGAIN` when more data is needed)
+   */
+  ssize_t read(char *buf, size_t len);
+
+  /**
+   * @brief Write data to be encrypted, same contract as `write(2)`
+   * @return Bytes written or -1 with errno set (`EAGAIN` when the socket is
+   *         full)
+   */
+  ssize_t write(const char *buf, size_t len);
+
+private:
+  ssl_st *ssl = nullptr;
+  const TlsContext &context;
+  int fd;
+  bool done = false;
+  bool kernel_tx = false;
+  bool kernel_rx = false;
+};
@@ -0,0 +1,37 @@
+#pragma once
+
+/**
+ * @brief Static tracepoints (USDT) on the data path
+ * @details Probes of the `dislog` provider, listed by
+ *          `bpftrace -l 'usdt:./core:dislog:*'`. A disabled probe is a single
+ *          `nop`, its arguments are only read off registers once a tracer
+ *          attached. Strings are passed as `const char *`.
+ *
+ *          | Probe         | Arguments                                     |
+ *          |---------------|-----------------------------------------------|
+ *          | `accept`      | fd, input tag, stream                         |
+ *          | `read`        | fd, input tag, bytes                          |
+ *          | `eagain`      | fd, input tag                                 |
+ *          | `frame`       | stream, input tag, records, bytes             |
+ *          | `route`       | stream, origin tag, bytes, outputs            |
+ *          | `enqueue`     | output tag, lane, bytes, lane queued bytes    |
+ *          | `write`       | output tag, fd, bytes written, chunks         |
+ *          | `reconnect`   | output tag, attempt, backoff ms               |
+ *
+ *          e.g. `bpftrace -e 'usdt:./core:dislog:read { @[str(arg1)] =
+ *          sum(arg2); }'`. Without `<sys/sdt.h>` (systemtap-sdt-dev) the
+ *          probes compile to nothing.
+ */
+
+#if defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define DISLOG_HAVE_USDT 1
+#endif
+#endif
+
+#ifdef DISLOG_HAVE_USDT
+#define DISLOG_PROBE(name, ...) STAP_PROBEV(dislog, name, ##__VA_ARGS__)
+#else
+#define DISLOG_PROBE(name, ...) ((void)0)
+#endif
@@ -0,0 +1,141 @@
+#include "profile_zone.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+struct Zone {
+  const char *name;
+  int64_t start_ns;
+  int64_t end_ns;
+};
+
+/**
+ * @brief Most recent zones of one thread
+ * @details The lock is only ever contended while a dump copies the ring
+ */
+struct ThreadZones {
+  std::mutex lock;
+  pid_t tid;
+  std::vector<Zone> ring;
+  /// Zones recorded so far, the next goes to `next % ring.size()`
+  uint64_t next = 0;
+};
+
+ProfileConfig profile_config;
+
+std::mutex registry_lock;
+std::vector<std::shared_ptr<ThreadZones>> registry;
+
+thread_local std::shared_ptr<ThreadZones> zones;
+
+volatile std::sig_atomic_t dump_requested = 0;
+
+/// How often the dump thread looks for a request
+constexpr auto DUMP_POLL = std::chrono::milliseconds(100);
+
+void request_dump(int) { dump_requested = 1; }
+
+void dump() {
+  std::vector<std::shared_ptr<ThreadZones>> threads;
+  {
+    std::lock_guard<std::mutex> guard(registry_lock);
+    threads = registry;
+  }
+
+  // Written next to the target and renamed so a viewer never sees half
+  std::string tmp = profile_config.path + ".tmp";
+  std::ofstream out(tmp, std::ios::trunc);
+  if (!out) {
+    std::cerr << std::format("Couldn't write the profile to {}: {}\n", tmp,
+                             std::strerror(errno));
+    return;
+  }
+
+  pid_t pid = getpid();
+  bool first = true;
+  std::vector<Zone> copy;
+  out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+  for (auto &thread : threads) {
+    uint64_t next;
+    {
+      std::lock_guard<std::mutex> guard(thread->lock);
+      copy = thread->ring;
+      next = thread->next;
+    }
+    size_t count = std::min<uint64_t>(next, copy.size());
+    for (size_t i = 0; i < count; ++i) {
+      // Oldest first
+      const Zone &zone = copy[(next - count + i) % copy.size()];
+      out << (first ? "\n" : ",\n") << "{\"name\":\"" << zone.name
+          << "\",\"ph\":\"X\",\"pid\":" << pid << ",\"tid\":" << thread->tid
+          << ",\"ts\":" << zone.start_ns / 1000.0
+          << ",\"dur\":" << (zone.end_ns - zone.start_ns) / 1000.0 << "}";
+      first = false;
+    }
+  }
+  out << "\n]}\n";
+  out.close();
+  if (!out || std::rename(tmp.c_str(), profile_config.path.c_str()) != 0) {
+    std::cerr << std::format("Couldn't write the profile to {}\n",
+                             profile_config.path);
+    return;
+  }
+  std::cerr << std::format("Profile written to {}\n", profile_config.path);
+}
+
+} // namespace
+
+bool Profiler::compiledIn() {
+#ifdef DISLOG_PROFILE_ZONES
+  return true;
+#else
+  return false;
+#endif
+}
+
+void Profiler::start(const ProfileConfig &config) {
+  profile_config = config;
+
+  struct sigaction action{};
+  action.sa_handler = request_dump;
+  sigemptyset(&action.sa_mask);
+  action.sa_flags = SA_RESTART;
+  sigaction(SIGUSR2, &action, nullptr);
+
+  std::thread([] {
+    while (true) {
+      std::this_thread::sleep_for(DUMP_POLL);
+      if (dump_requested) {
+        dump_requested = 0;
+        dump();
+      }
+    }
+  }).detach();
+  active.store(true, std::memory_order_relaxed);
+}
+
+void Profiler::record(const char *name, int64_t start_ns, int64_t end_ns) {
+  if (!zones) {
+    zones = std::make_shared<ThreadZones>();
+    zones->tid = gettid();
+    zones->ring.resize(profile_config.events_per_thread);
+    std::lock_guard<std::mutex> guard(registry_lock);
+    registry.push_back(zones);
+  }
+  std::lock_guard<std::mutex> guard(zones->lock);
+  zones->ring[zones->next++ % zones->ring.size()] = {name, start_ns, end_ns};
+}
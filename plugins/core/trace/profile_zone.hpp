@@ -0,0 +1,85 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include <trace/trace_stamp.hpp>
+
+/**
+ * @brief Top level `profile` block of the core config
+ */
+struct ProfileConfig {
+  /// Where the Chrome trace is written on `SIGUSR2`. Empty disables zones
+  std::string path;
+
+  /// Most recent zones kept per thread
+  size_t events_per_thread = 64 * 1024;
+};
+
+/**
+ * @brief Records scoped timing zones and dumps them as a Chrome trace
+ * @details Only built in with `-DDISLOG_PROFILE_ZONES=ON`, otherwise
+ *          `DISLOG_ZONE` compiles to nothing. Every thread keeps its most
+ *          recent zones in a ring of its own, `kill -USR2 <core>` writes the
+ *          rings of all threads to `path` as a Chrome trace (`chrome://tracing`
+ *          or Perfetto). Until `start` the zones cost a relaxed load.
+ */
+class Profiler {
+public:
+  /**
+   * @brief Was the core built with zones
+   */
+  static bool compiledIn();
+
+  /**
+   * @brief Start recording and dump on `SIGUSR2`
+   * @note Call before the services start
+   */
+  static void start(const ProfileConfig &config);
+
+  /**
+   * @brief Are zones being recorded
+   */
+  static bool recording() { return active.load(std::memory_order_relaxed); }
+
+  /**
+   * @brief Record a zone of the calling thread
+   *
+   * @param[in] name A string literal
+   */
+  static void record(const char *name, int64_t start_ns, int64_t end_ns);
+
+private:
+  static inline std::atomic<bool> active{false};
+};
+
+#ifdef DISLOG_PROFILE_ZONES
+/**
+ * @brief Records the time from its construction to the end of the scope
+ */
+class ProfileZone {
+public:
+  explicit ProfileZone(const char *name)
+      : name(name), start_ns(Profiler::recording() ? trace::monotonic_ns() : 0) {
+  }
+  ~ProfileZone() {
+    if (start_ns != 0)
+      Profiler::record(name, start_ns, trace::monotonic_ns());
+  }
+
+  ProfileZone(const ProfileZone &) = delete;
+  ProfileZone &operator=(const ProfileZone &) = delete;
+
+private:
+  const char *name;
+  int64_t start_ns;
+};
+
+#define DISLOG_ZONE_VAR2(line) dislog_zone_##line
+#define DISLOG_ZONE_VAR(line) DISLOG_ZONE_VAR2(line)
+#define DISLOG_ZONE(name) ProfileZone DISLOG_ZONE_VAR(__LINE__)(name)
+#else
+#define DISLOG_ZONE(name) ((void)0)
+#endif
@@ -0,0 +1,25 @@
+#include "route_latency.hpp"
+
+#include <format>
+
+static Histogram &stage(const std::string &input, const std::string &output,
+                        const char *name) {
+  return StatsRegistry::instance().histogram(
+      "dislog_route_latency_seconds",
+      std::format("input=\"{}\",output=\"{}\",stage=\"{}\"", input, output,
+                  name));
+}
+
+RouteLatency::RouteLatency(const std::string &input, const std::string &output)
+    : ship(stage(input, output, "ship")),
+      pipeline(stage(input, output, "pipeline")),
+      output(stage(input, output, "output")),
+      total(stage(input, output, "total")) {}
+
+void RouteLatency::observe(const TraceStamp &stamp, int64_t write_ns) {
+  constexpr double NS = 1e-9;
+  ship.observe((stamp.read_ns - stamp.ingest_ns) * NS);
+  pipeline.observe((stamp.route_ns - stamp.read_ns) * NS);
+  output.observe((write_ns - stamp.route_ns) * NS);
+  total.observe((write_ns - stamp.ingest_ns) * NS);
+}
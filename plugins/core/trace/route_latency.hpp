@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstdint>
+#include <stats/stats.hpp>
+#include <string>
+
+/**
+ * @brief When a sampled batch passed each point of the data path
+ * @details All CLOCK_MONOTONIC ns, see trace/trace_stamp.hpp
+ */
+struct TraceStamp {
+  /// Read from its source by the shipper
+  int64_t ingest_ns;
+  /// Read from the shipper by the core
+  int64_t read_ns;
+  /// Through the pipeline, handed to the outputs
+  int64_t route_ns;
+};
+
+/**
+ * @brief Latency histograms of one input to output route
+ */
+class RouteLatency {
+public:
+  RouteLatency(const std::string &input, const std::string &output);
+
+  /**
+   * @brief Count a sampled batch which was written out at `write_ns`
+   */
+  void observe(const TraceStamp &stamp, int64_t write_ns);
+
+private:
+  Histogram &ship;
+  Histogram &pipeline;
+  Histogram &output;
+  Histogram &total;
+};
+
+/**
+ * @brief A sampled batch on its way to an output
+ */
+struct Trace {
+  TraceStamp stamp;
+  RouteLatency *latency;
+};
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <charconv>
+#include <cstdint>
+#include <ctime>
+#include <string>
+#include <string_view>
+
+/**
+ * @brief In-band latency stamps
+ * @details A shipper which samples a batch puts a stamp record in front of
+ *          it: `\x1e` `DLTS ` <CLOCK_MONOTONIC ns> `\n`. Only a record which
+ *          is exactly that is a stamp, any other record starting with the
+ *          record separator (e.g. RFC 7464 JSON text sequences) is an ordinary
+ *          one. Stamps are stripped before delivery unless the output keeps
+ *          them.
+ * @note The clock is only comparable on one host, stamps from shippers on
+ *       other hosts measure nothing useful
+ */
+namespace trace {
+
+constexpr std::string_view PREFIX = "\x1e" "DLTS ";
+
+inline int64_t monotonic_ns() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+/**
+ * @brief Is the record a stamp: the prefix, digits and `\n`
+ *
+ * @param[in] record The record, including its `\n`
+ */
+inline bool is_stamp(std::string_view record) {
+  if (!record.starts_with(PREFIX) || !record.ends_with('\n'))
+    return false;
+  std::string_view digits =
+      record.substr(PREFIX.size(), record.size() - PREFIX.size() - 1);
+  return !digits.empty() &&
+         digits.find_first_not_of("0123456789") == std::string_view::npos;
+}
+
+/**
+ * @brief Build a stamp record for now
+ */
+inline std::string make_stamp() {
+  return std::string(PREFIX) + std::to_string(monotonic_ns()) + "\n";
+}
+
+/**
+ * @brief Read the time out of a stamp record
+ *
+ * @param[in] record The record, including its `\n`
+ * @param[out] ns The time of the stamp
+ * @return False if the record is malformed
+ */
+inline bool parse_stamp(std::string_view record, int64_t &ns) {
+  if (!is_stamp(record))
+    return false;
+  record.remove_prefix(PREFIX.size());
+  auto [end, error] =
+      std::from_chars(record.data(), record.data() + record.size(), ns);
+  return error == std::errc() && end != record.data();
+}
+
+} // namespace trace
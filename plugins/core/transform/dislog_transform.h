@@ -0,0 +1,100 @@
+#ifndef DISLOG_TRANSFORM_H
+#define DISLOG_TRANSFORM_H
+
+/**
+ * @file dislog_transform.h
+ * @brief C ABI of transform plugins loaded by the core
+ * @details A plugin is a shared object exporting `dislog_transform_entry`.
+ *          The core loads the plugins listed in `transform_plugins` of an
+ *          input, creates one instance per input and hands it each batch of
+ *          records as spans into the core's own buffers. The plugin answers
+ *          with one decision per record. Records it rewrites live in memory
+ *          the plugin owns and must stay valid until the next `process` call
+ *          on the same instance, nothing is copied on the way in.
+ *
+ *          An instance is only ever used by the service thread of its input,
+ *          one call at a time, so it needs no locking of its own.
+ *
+ *          The ABI only grows at the end of the structs. A core refuses a
+ *          plugin whose `abi_version` differs from its own.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define DISLOG_TRANSFORM_ABI_VERSION 1
+
+/** Name of the symbol the core looks up */
+#define DISLOG_TRANSFORM_ENTRY "dislog_transform_entry"
+
+/** A record, or any text, as a pointer and a length. Not NUL terminated */
+typedef struct dislog_span {
+  const char *data;
+  size_t len;
+} dislog_span;
+
+typedef enum dislog_verdict {
+  /** Forward the record as it is */
+  DISLOG_KEEP = 0,
+  /** Forget the record */
+  DISLOG_DROP = 1,
+  /** Forward `rewritten` in place of the record */
+  DISLOG_REWRITE = 2,
+  /** Send the record, or `rewritten` if not empty, to `routes[route]`
+      of the plugin's config instead of the outputs of the input */
+  DISLOG_ROUTE = 3,
+} dislog_verdict;
+
+/** What happens to one record, filled in by the plugin */
+typedef struct dislog_decision {
+  uint32_t verdict;
+  uint32_t route;
+  /** Must end with `\n` like the records the plugin is given */
+  dislog_span rewritten;
+} dislog_decision;
+
+typedef struct dislog_transform_plugin {
+  uint32_t abi_version;
+  /** Used in metric labels and error messages */
+  const char *name;
+
+  /**
+   * Create an instance for an input
+   *
+   * @param input Tag of the input
+   * @param config The `config` of the plugin in the core config, as JSON
+   * @param error Buffer for a NUL terminated reason if creating fails
+   * @param error_len Size of `error`
+   * @return The instance, NULL if it couldn't be created
+   */
+  void *(*create)(const char *input, const char *config, char *error,
+                  size_t error_len);
+
+  /** Free an instance and everything it owns */
+  void (*destroy)(void *instance);
+
+  /**
+   * Decide the fate of a batch of records
+   *
+   * @param instance What `create` returned
+   * @param records The records, each ending with `\n`
+   * @param count Number of records and of decisions
+   * @param decisions One per record, all set to `DISLOG_KEEP` beforehand
+   * @return 0, anything else forwards the batch untouched
+   */
+  int (*process)(void *instance, const dislog_span *records, size_t count,
+                 dislog_decision *decisions);
+} dislog_transform_plugin;
+
+/** The one symbol a plugin exports */
+typedef const dislog_transform_plugin *(*dislog_transform_entry_fn)(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
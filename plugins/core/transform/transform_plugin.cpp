@@ -0,0 +1,116 @@
+#include "transform_plugin.hpp"
+
+#include <dlfcn.h>
+#include <format>
+#include <stats/stats.hpp>
+#include <stdexcept>
+
+TransformPlugin::TransformPlugin(const TransformPluginConfig &config,
+                                 const std::string &tag)
+    : config(config) {
+  // Local so two plugins can use the same symbol names for their internals
+  handle = dlopen(config.path.c_str(), RTLD_NOW | RTLD_LOCAL);
+  if (!handle) {
+    throw std::runtime_error(std::format(
+        "Couldn't load transform plugin {} for {}: {}", config.path, tag,
+        dlerror()));
+  }
+
+  auto entry = reinterpret_cast<dislog_transform_entry_fn>(
+      dlsym(handle, DISLOG_TRANSFORM_ENTRY));
+  plugin = entry ? entry() : nullptr;
+  if (!plugin) {
+    dlclose(handle);
+    throw std::runtime_error(
+        std::format("{} is not a transform plugin for {}", config.path, tag));
+  }
+  if (plugin->abi_version != DISLOG_TRANSFORM_ABI_VERSION) {
+    uint32_t version = plugin->abi_version;
+    dlclose(handle);
+    throw std::runtime_error(std::format(
+        "Transform plugin {} has ABI version {}, the core has {} for {}",
+        config.path, version, DISLOG_TRANSFORM_ABI_VERSION, tag));
+  }
+
+  char error[256] = "";
+  instance = plugin->create(tag.c_str(), config.config.c_str(), error,
+                            sizeof(error));
+  if (!instance) {
+    std::string name = plugin->name;
+    dlclose(handle);
+    throw std::runtime_error(std::format(
+        "Transform plugin {} refused its config for {}: {}", name, tag,
+        error));
+  }
+
+  std::string labels =
+      std::format("input=\"{}\",plugin=\"{}\"", tag, plugin->name);
+  StatsRegistry &stats = StatsRegistry::instance();
+  errors = &stats.counter("dislog_transform_plugin_errors_total", labels);
+  dropped =
+      &stats.counter("dislog_transform_plugin_dropped_records_total", labels);
+  routed_records =
+      &stats.counter("dislog_transform_plugin_routed_records_total", labels);
+}
+
+TransformPlugin::~TransformPlugin() {
+  plugin->destroy(instance);
+  dlclose(handle);
+}
+
+void TransformPlugin::apply(std::vector<Record> &records,
+                            std::span<std::string> routed,
+                            const std::function<void(Record &)> &reparse) {
+  if (records.empty())
+    return;
+
+  spans.clear();
+  for (const Record &record : records)
+    spans.push_back({record.raw.data(), record.raw.size()});
+  decisions.assign(records.size(), dislog_decision{DISLOG_KEEP, 0, {}});
+
+  if (plugin->process(instance, spans.data(), spans.size(),
+                      decisions.data()) != 0) {
+    errors->fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+
+  // Compact the survivors in place
+  size_t kept = 0;
+  for (size_t i = 0; i < records.size(); ++i) {
+    const dislog_decision &decision = decisions[i];
+    std::string_view rewritten(decision.rewritten.data,
+                               decision.rewritten.len);
+    bool valid_rewrite = rewritten.ends_with('\n');
+
+    switch (decision.verdict) {
+    case DISLOG_DROP:
+      dropped->fetch_add(1, std::memory_order_relaxed);
+      continue;
+
+    case DISLOG_ROUTE:
+      if (decision.route >= routed.size() ||
+          (!rewritten.empty() && !valid_rewrite))
+        break;
+      routed[decision.route] += rewritten.empty() ? records[i].raw : rewritten;
+      routed_records->fetch_add(1, std::memory_order_relaxed);
+      continue;
+
+    case DISLOG_REWRITE:
+      if (!valid_rewrite)
+        break;
+      records[kept] = Record{rewritten};
+      reparse(records[kept++]);
+      continue;
+
+    case DISLOG_KEEP:
+      records[kept++] = records[i];
+      continue;
+    }
+
+    // Anything the plugin got wrong ends up here
+    errors->fetch_add(1, std::memory_order_relaxed);
+    records[kept++] = records[i];
+  }
+  records.resize(kept);
+}
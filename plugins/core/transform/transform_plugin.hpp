@@ -0,0 +1,80 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <span>
+#include <string>
+#include <vector>
+
+#include <pipeline/record.hpp>
+#include <transform/dislog_transform.h>
+
+/**
+ * @brief Entry of `transform_plugins` of an input source
+ */
+struct TransformPluginConfig {
+  /// Shared object exporting `dislog_transform_entry`
+  std::string path;
+
+  /// The plugin's `config`, passed to it as JSON text
+  std::string config = "{}";
+
+  /// Output tags the plugin's `DISLOG_ROUTE` decisions index
+  std::vector<std::string> routes;
+};
+
+/**
+ * @brief An instance of a transform plugin, owned by the pipeline of an input
+ * @details The shared object is loaded when the instance is created and
+ *          unloaded with it. `dlopen` counts references so inputs sharing a
+ *          plugin share its code but each have their own instance.
+ * @note Not thread safe, owned by the service thread of the input
+ */
+class TransformPlugin {
+public:
+  /**
+   * @brief Load the plugin and create its instance for an input
+   * @throws std::runtime_error if the plugin can't be loaded, has another ABI
+   *         version or refuses its config
+   *
+   * @param[in] config The entry of `transform_plugins`
+   * @param[in] tag Tag of the input
+   */
+  TransformPlugin(const TransformPluginConfig &config, const std::string &tag);
+  ~TransformPlugin();
+
+  TransformPlugin(const TransformPlugin &) = delete;
+  TransformPlugin &operator=(const TransformPlugin &) = delete;
+
+  /**
+   * @brief Run a batch of records through the plugin
+   * @details Dropped and routed records are taken out of `records`, rewritten
+   *          ones point into the plugin's memory until the next call. A
+   *          decision the plugin got wrong keeps the record as it is.
+   *
+   * @param[in,out] records The records, each ending with `\n`
+   * @param[out] routed Records routed to `routes()[i]` are appended to
+   *             `routed[i]`
+   * @param[in] reparse Runs the parse stage of the input again over
+   *            rewritten records
+   */
+  void apply(std::vector<Record> &records, std::span<std::string> routed,
+             const std::function<void(Record &)> &reparse);
+
+  const std::vector<std::string> &routes() const { return config.routes; }
+
+private:
+  TransformPluginConfig config;
+  void *handle = nullptr;
+  const dislog_transform_plugin *plugin = nullptr;
+  void *instance = nullptr;
+
+  /// Reused for every batch so the steady state doesn't allocate
+  std::vector<dislog_span> spans;
+  std::vector<dislog_decision> decisions;
+
+  std::atomic<uint64_t> *errors = nullptr;
+  std::atomic<uint64_t> *dropped = nullptr;
+  std::atomic<uint64_t> *routed_records = nullptr;
+};
@@ -0,0 +1,204 @@
+#include "transform_pool.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <format>
+#include <iostream>
+#include <stats/stats.hpp>
+#include <stdexcept>
+#include <sys/eventfd.h>
+#include <trace/profile_zone.hpp>
+#include <unistd.h>
+
+/// Recycled batches kept around, beyond that they are freed
+static constexpr size_t FREE_BATCHES = 64;
+
+void TransformBatch::add(std::span<const std::string_view> records) {
+  for (std::string_view record : records) {
+    data.append(record);
+    ends.push_back(data.size());
+  }
+  memory.set(data.size());
+}
+
+void TransformBatch::clear() {
+  data.clear();
+  ends.clear();
+  prepared.clear();
+  traced = false;
+  last = false;
+  memory.set(0);
+}
+
+TransformPool::TransformPool(const Pipeline &pipeline, size_t workers,
+                             const std::string &tag)
+    : pipeline(pipeline), max_inflight(workers * MAX_INFLIGHT_PER_WORKER),
+      batches(StatsRegistry::instance().counter(
+          "dislog_transform_batches_total", std::format("input=\"{}\"", tag))),
+      steals(StatsRegistry::instance().counter(
+          "dislog_transform_steals_total", std::format("input=\"{}\"", tag))) {
+  event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (event_fd < 0) {
+    throw std::runtime_error(std::format(
+        "Couldn't create the transform eventfd: {}", std::strerror(errno)));
+  }
+  for (size_t i = 0; i < workers; ++i)
+    queues.push_back(std::make_unique<Queue>());
+  for (size_t i = 0; i < workers; ++i)
+    threads.emplace_back(&TransformPool::run, this, i);
+}
+
+TransformPool::~TransformPool() {
+  {
+    std::lock_guard<std::mutex> guard(sleep_lock);
+    stopping = true;
+  }
+  work.notify_all();
+  for (std::thread &thread : threads)
+    thread.join();
+  close(event_fd);
+}
+
+std::unique_ptr<TransformBatch> TransformPool::acquire() {
+  if (free_batches.empty())
+    return std::make_unique<TransformBatch>();
+  auto batch = std::move(free_batches.back());
+  free_batches.pop_back();
+  return batch;
+}
+
+void TransformPool::recycle(std::unique_ptr<TransformBatch> batch) {
+  if (free_batches.size() >= FREE_BATCHES)
+    return;
+  batch->clear();
+  free_batches.push_back(std::move(batch));
+}
+
+void TransformPool::submit(std::unique_ptr<TransformBatch> batch) {
+  {
+    std::lock_guard<std::mutex> guard(order_lock);
+    batch->seq = order[batch->stream].next_submit++;
+  }
+
+  {
+    std::unique_lock<std::mutex> guard(sleep_lock);
+    space.wait(guard, [&] { return inflight < max_inflight; });
+    ++inflight;
+  }
+
+  Queue &queue = *queues[next_queue];
+  next_queue = (next_queue + 1) % queues.size();
+  {
+    std::lock_guard<std::mutex> guard(queue.lock);
+    queue.tasks.push_back(std::move(batch));
+  }
+  {
+    // Counted under the lock the workers sleep on so none misses it
+    std::lock_guard<std::mutex> guard(sleep_lock);
+    queued.fetch_add(1, std::memory_order_relaxed);
+  }
+  work.notify_one();
+}
+
+std::unique_ptr<TransformBatch> TransformPool::take(size_t worker) {
+  // Own queue first, oldest batch first
+  {
+    Queue &own = *queues[worker];
+    std::lock_guard<std::mutex> guard(own.lock);
+    if (!own.tasks.empty()) {
+      auto batch = std::move(own.tasks.front());
+      own.tasks.pop_front();
+      queued.fetch_sub(1, std::memory_order_relaxed);
+      return batch;
+    }
+  }
+
+  // Steal from the back of the others, away from their owners
+  for (size_t i = 1; i < queues.size(); ++i) {
+    Queue &victim = *queues[(worker + i) % queues.size()];
+    std::lock_guard<std::mutex> guard(victim.lock);
+    if (!victim.tasks.empty()) {
+      auto batch = std::move(victim.tasks.back());
+      victim.tasks.pop_back();
+      queued.fetch_sub(1, std::memory_order_relaxed);
+      steals.fetch_add(1, std::memory_order_relaxed);
+      return batch;
+    }
+  }
+  return nullptr;
+}
+
+void TransformPool::run(size_t worker) {
+  std::vector<std::string_view> records;
+  while (true) {
+    std::unique_ptr<TransformBatch> batch = take(worker);
+    if (!batch) {
+      std::unique_lock<std::mutex> guard(sleep_lock);
+      work.wait(guard, [&] {
+        return stopping || queued.load(std::memory_order_relaxed) > 0;
+      });
+      if (stopping)
+        return;
+      continue;
+    }
+
+    DISLOG_ZONE("transform");
+    records.clear();
+    size_t start = 0;
+    for (size_t end : batch->ends) {
+      records.emplace_back(batch->data.data() + start, end - start);
+      start = end;
+    }
+    pipeline.prepare(records, batch->prepared);
+    batches.fetch_add(1, std::memory_order_relaxed);
+    complete(std::move(batch));
+  }
+}
+
+void TransformPool::complete(std::unique_ptr<TransformBatch> batch) {
+  bool wake;
+  {
+    std::lock_guard<std::mutex> guard(order_lock);
+    uint32_t stream = batch->stream;
+    StreamOrder &stream_order = order[stream];
+    stream_order.done.emplace(batch->seq, std::move(batch));
+
+    bool was_empty = finished.empty();
+    bool last = false;
+    auto next = stream_order.done.begin();
+    while (next != stream_order.done.end() &&
+           next->first == stream_order.next_emit) {
+      last = next->second->last;
+      finished.push_back(std::move(next->second));
+      next = stream_order.done.erase(next);
+      ++stream_order.next_emit;
+    }
+    // Nothing more is submitted for a stream after its last batch
+    if (last)
+      order.erase(stream);
+    wake = was_empty && !finished.empty();
+  }
+
+  {
+    std::lock_guard<std::mutex> guard(sleep_lock);
+    --inflight;
+  }
+  space.notify_one();
+
+  if (wake) {
+    uint64_t one = 1;
+    if (write(event_fd, &one, sizeof(one)) < 0 && errno != EAGAIN)
+      std::cerr << "Transform eventfd write failed\n";
+  }
+}
+
+void TransformPool::collect(std::vector<std::unique_ptr<TransformBatch>> &out) {
+  uint64_t count;
+  if (read(event_fd, &count, sizeof(count)) < 0 && errno != EAGAIN)
+    std::cerr << "Transform eventfd read failed\n";
+
+  std::lock_guard<std::mutex> guard(order_lock);
+  for (auto &batch : finished)
+    out.push_back(std::move(batch));
+  finished.clear();
+}
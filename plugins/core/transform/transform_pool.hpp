@@ -0,0 +1,170 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory>
+#include <memory/memory_governor.hpp>
+#include <mutex>
+#include <pipeline/pipeline.hpp>
+#include <span>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <trace/route_latency.hpp>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @brief Records of one read of a stream on their way through the pool
+ */
+struct TransformBatch {
+  uint32_t stream = 0;
+  /// Tag of the input the stream entered the first core through
+  std::string origin;
+  /// Set if the records belong to a sampled batch
+  bool traced = false;
+  TraceStamp stamp{};
+  /// The stream is over once this batch is forwarded
+  bool last = false;
+
+  /// The records back to back, and where each of them ends
+  std::string data;
+  std::vector<size_t> ends;
+  /// Filled by the worker, the views point into `data`
+  std::vector<Record> prepared;
+
+  /// Position of the batch in its stream
+  uint64_t seq = 0;
+  MemoryAccount memory;
+
+  /**
+   * @brief Copy records into the batch
+   */
+  void add(std::span<const std::string_view> records);
+
+  /**
+   * @brief Forget the records, keeping the buffers for reuse
+   */
+  void clear();
+};
+
+/**
+ * @brief Work stealing pool running the stateless pipeline stages
+ * @details The service thread (the reactor) reads and frames, then submits
+ *          each read as a batch. Batches are dealt round robin to the
+ *          workers' queues and a worker whose queue is empty steals from the
+ *          others, so one slow batch doesn't hold up the rest. Finished
+ *          batches are put back in stream order and the reactor is woken
+ *          through `eventFd()` to collect them, run the stateful stages and
+ *          hand them to the outputs. Records of a stream thus leave in the
+ *          order they came in while streams overtake each other freely.
+ *
+ *          At most `MAX_INFLIGHT_PER_WORKER` batches per worker are queued,
+ *          `submit` blocks beyond that so a reactor which outruns the workers
+ *          leaves data in the sockets.
+ */
+class TransformPool {
+public:
+  static constexpr size_t MAX_INFLIGHT_PER_WORKER = 16;
+
+  /**
+   * @brief Start the workers
+   *
+   * @param[in] pipeline Pipeline of the input, only `prepare` is used by the
+   *                     workers. Must outlive the pool
+   * @param[in] workers Number of worker threads
+   * @param[in] tag Tag of the input, used as the metric label
+   */
+  TransformPool(const Pipeline &pipeline, size_t workers,
+                const std::string &tag);
+  ~TransformPool();
+
+  TransformPool(const TransformPool &) = delete;
+  TransformPool &operator=(const TransformPool &) = delete;
+
+  /**
+   * @brief Get an empty batch, reusing a recycled one if possible
+   * @note Reactor only
+   */
+  std::unique_ptr<TransformBatch> acquire();
+
+  /**
+   * @brief Queue a batch for the workers
+   * @note Reactor only. Blocks while the pool is full
+   */
+  void submit(std::unique_ptr<TransformBatch> batch);
+
+  /**
+   * @brief Becomes readable when finished batches can be collected
+   */
+  int eventFd() const { return event_fd; }
+
+  /**
+   * @brief Take the finished batches whose turn has come, in stream order
+   * @note Reactor only
+   *
+   * @param[out] out The batches are appended to it
+   */
+  void collect(std::vector<std::unique_ptr<TransformBatch>> &out);
+
+  /**
+   * @brief Give a collected batch back for reuse
+   * @note Reactor only
+   */
+  void recycle(std::unique_ptr<TransformBatch> batch);
+
+private:
+  struct Queue {
+    std::mutex lock;
+    std::deque<std::unique_ptr<TransformBatch>> tasks;
+  };
+
+  struct StreamOrder {
+    uint64_t next_submit = 0;
+    uint64_t next_emit = 0;
+    /// Finished batches waiting for an earlier one
+    std::map<uint64_t, std::unique_ptr<TransformBatch>> done;
+  };
+
+  /**
+   * @brief Body of a worker thread
+   */
+  void run(size_t worker);
+
+  /**
+   * @brief Take a batch from the worker's own queue, else steal one
+   */
+  std::unique_ptr<TransformBatch> take(size_t worker);
+
+  /**
+   * @brief Put a finished batch in stream order and wake the reactor
+   */
+  void complete(std::unique_ptr<TransformBatch> batch);
+
+  const Pipeline &pipeline;
+  std::vector<std::unique_ptr<Queue>> queues;
+  std::vector<std::thread> threads;
+
+  std::mutex sleep_lock;
+  std::condition_variable work;
+  std::condition_variable space;
+  std::atomic<size_t> queued{0};
+  size_t inflight = 0;
+  size_t max_inflight;
+  bool stopping = false;
+
+  std::mutex order_lock;
+  std::unordered_map<uint32_t, StreamOrder> order;
+  std::vector<std::unique_ptr<TransformBatch>> finished;
+  int event_fd = -1;
+
+  // Reactor only
+  size_t next_queue = 0;
+  std::vector<std::unique_ptr<TransformBatch>> free_batches;
+
+  std::atomic<uint64_t> &batches;
+  std::atomic<uint64_t> &steals;
+};
@@ -26,6 +26,23 @@ ConfigHandler::ConfigHandler(std::string filePath) {
   }
 }
 
+bool ConfigHandler::usesSharedMemory() {
+  constexpr std::string_view COMM_TYPE = "comm_type";
+  return configData.contains(COMM_TYPE) && configData[COMM_TYPE] == "SHM";
+}
+
+unsigned ConfigHandler::getTraceEvery() {
+  constexpr std::string_view TRACE_EVERY = "trace_every";
+  if (!configData.contains(TRACE_EVERY))
+    return 0;
+  if (!configData[TRACE_EVERY].is_number_unsigned()) {
+    std::cerr << std::format("{} should be a non negative integer\n",
+                             TRACE_EVERY);
+    return 0;
+  }
+  return configData[TRACE_EVERY].get<unsigned>();
+}
+
 int ConfigHandler::getSocketType() {
   constexpr std::string_view COMM_TYPE = "comm_type";
   if (!configData.contains(COMM_TYPE)) {
@@ -39,7 +56,7 @@ int ConfigHandler::getSocketType() {
     return -1;
   }
 
-  if (comm_type_j == "UNIX_SOCK")
+  if (comm_type_j == "UNIX_SOCK" || comm_type_j == "SHM")
     return AF_UNIX;
   else if (comm_type_j == "IPv4")
     return AF_INET;
@@ -72,6 +89,9 @@ ConfigHandler::getForwardedSocketStore(struct sockaddr_storage *socket_out) {
   // Or enum tactics what to do?
   if (comm_type == "UNIX_SOCK") {
     return getUnixSocket(socket_out);
+  } else if (comm_type == "SHM") {
+    // The data goes through a ring, the socket only hands it over
+    return getUnixSocket(socket_out, "SHM");
   } else if (comm_type == "IPv4") {
     return getIPv4Socket(socket_out);
   } else {
@@ -81,10 +101,10 @@ ConfigHandler::getForwardedSocketStore(struct sockaddr_storage *socket_out) {
 }
 
 /// Create a unix socket from a path
-/// `"UNIX_SOCK" :` Unix socket object
+/// `"UNIX_SOCK" :` Unix socket object (or `"SHM"`)
 /// `"sock_file_path"` : Socket file path
-socklen_t ConfigHandler::getUnixSocket(struct sockaddr_storage *socket_out) {
-  constexpr std::string_view UNIX_STRING = "UNIX_SOCK";
+socklen_t ConfigHandler::getUnixSocket(struct sockaddr_storage *socket_out,
+                                       std::string_view UNIX_STRING) {
   constexpr std::string_view UNIX_FILEPATH = "sock_file_path";
 
   if (!configData.contains(UNIX_STRING)) {
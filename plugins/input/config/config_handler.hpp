@@ -13,7 +13,7 @@ public:
   /**
    * @brief Construct a socket on where the core is already listening
    * @details Expects json entry "comm_type : <json_string>"
-   *            The valid options are `UNIX_SOCKET` | `IPv4`
+   *            The valid options are `UNIX_SOCKET` | `IPv4` | `SHM`
    *            Support for Ipv6 is underway
    *
    * @param[out] socket_out This storage will be populated
@@ -31,6 +31,23 @@ public:
    */
   int getSocketType();
 
+  /**
+   * @brief Is the data written into a ring shared with the core
+   * @details With `comm_type : SHM` the socket only hands the ring over
+   *
+   * @return True for `SHM`
+   */
+  bool usesSharedMemory();
+
+  /**
+   * @brief How often a read is stamped for the core's route latency
+   * @details Expects json entry "trace_every : <json_int>", the stamp goes
+   *            into every that many reads. Stamping is off when absent or 0
+   *
+   * @return Reads per stamp, 0 if off
+   */
+  unsigned getTraceEvery();
+
 private:
   using json = nlohmann::json;
   json configData;
@@ -39,9 +56,11 @@ private:
    * @brief Construct a Unix Socket according to the configuration file
    *
    * @param[out] socket_out Socket being populated
+   * @param[in] UNIX_STRING Block holding the socket path
    * @return 0 on error else size of socket
    */
-  socklen_t getUnixSocket(struct sockaddr_storage *socket_out);
+  socklen_t getUnixSocket(struct sockaddr_storage *socket_out,
+                          std::string_view UNIX_STRING = "UNIX_SOCK");
 
   /**
    * @brief Construct a Ipv4 socket according to the configuration file
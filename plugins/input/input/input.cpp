@@ -1,10 +1,12 @@
 #include "input.hpp"
 
 #include <array>
+#include <cstring>
 #include <fcntl.h>
 #include <string>
 #include <sys/socket.h>
 #include <sys/types.h>
+#include <trace/trace_stamp.hpp>
 #include <unistd.h>
 
 /// This reads from the source file
@@ -33,9 +35,33 @@ int Input::stream_from_source(int start_offset) {
 
 /// Attempt to send all the data that has been read
 int Input::stream(int b_read) {
+  if (trace_every == 0 || ++reads < trace_every)
+    return send_all(buf.data(), b_read);
+
+  // The stamp has to be a record of its own, so it goes after the first
+  // newline. A read without one waits for the next read to be stamped
+  auto *newline = static_cast<char *>(memchr(buf.data(), '\n', b_read));
+  if (!newline)
+    return send_all(buf.data(), b_read);
+  reads = 0;
+
+  size_t head = newline + 1 - buf.data();
+  std::string stamp = trace::make_stamp();
+  int ret = send_all(buf.data(), head);
+  if (ret == 0)
+    ret = send_all(stamp.data(), stamp.size());
+  if (ret == 0)
+    ret = send_all(buf.data() + head, b_read - head);
+  return ret;
+}
+
+int Input::send_all(const char *data, size_t size) {
+  if (ring)
+    return ring->write(data, size) ? 0 : -1;
+
   size_t tot_sent = 0;
-  while (tot_sent < b_read) {
-    ssize_t sent = send(socket_fd, buf.data() + tot_sent, b_read - tot_sent, 0);
+  while (tot_sent < size) {
+    ssize_t sent = send(socket_fd, data + tot_sent, size - tot_sent, 0);
 
     if (sent < 0)
       return sent;
@@ -1,6 +1,8 @@
 #pragma once
 
 #include <array>
+#include <memory>
+#include <shm/shm_ring.hpp>
 #include <string>
 
 /**
@@ -26,12 +28,45 @@ public:
   Input(const std::string file_path, const int socket_fd)
       : file_path(file_path), socket_fd(socket_fd) {};
 
+  /**
+   * @brief Construct Input Class writing into a ring shared with the core
+   *
+   * @param[in] file_path File path of the log
+   * @param[in] socket_fd Control socket the ring was received on
+   * @param[in] ring The ring
+   */
+  Input(const std::string file_path, const int socket_fd,
+        std::unique_ptr<shm::Ring> ring)
+      : file_path(file_path), socket_fd(socket_fd), ring(std::move(ring)) {};
+
+  /**
+   * @brief Stamp every `every`th read so the core can time it
+   *
+   * @param[in] every Reads per stamp, 0 turns stamping off
+   */
+  void setTraceEvery(unsigned every) { trace_every = every; }
+
 private:
   const std::string file_path;
   static const int BUF_SIZE = 1024;
   const int socket_fd;
   std::array<char, BUF_SIZE> buf;
 
+  /// Set for `comm_type : SHM`, the data then bypasses the socket
+  std::unique_ptr<shm::Ring> ring;
+
+  /// Reads per stamp, 0 if off
+  unsigned trace_every = 0;
+  /// Reads since the last stamp
+  unsigned reads = 0;
+
+  /**
+   * @brief Send bytes to the core over the socket or the ring
+   *
+   * @return < 0 if error 0 if successful
+   */
+  int send_all(const char *data, size_t size);
+
   /**
    * @brief Stream data to socket
    *
@@ -30,7 +30,20 @@ int main() {
   if (ret < 0)
     return ret;
 
+  if (Config.usesSharedMemory()) {
+    auto ring = shm::Ring::receive(sock_fd);
+    if (!ring) {
+      std::cerr << "Couldn't receive the ring from the core\n";
+      exit(EXIT_FAILURE);
+    }
+    Input syslog(file_path, sock_fd, std::move(ring));
+    syslog.setTraceEvery(Config.getTraceEvery());
+    syslog.stream_from_source();
+    return 0;
+  }
+
   Input syslog(file_path, sock_fd);
+  syslog.setTraceEvery(Config.getTraceEvery());
   syslog.stream_from_source();
 
 }
@@ -0,0 +1,285 @@
+#include "config/config_handler.hpp"
+#include <capture/capture_format.hpp>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <format>
+#include <iostream>
+#include <memory>
+#include <shm/shm_ring.hpp>
+#include <string>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <thread>
+#include <trace/trace_stamp.hpp>
+#include <unistd.h>
+#include <unordered_map>
+
+namespace {
+
+/**
+ * @brief A replayed client connection
+ */
+struct Connection {
+  int fd = -1;
+  /// Set for `comm_type : SHM`
+  std::unique_ptr<shm::Ring> ring;
+  /// Is the next byte sent the start of a line
+  bool line_start = true;
+  /// Start of a line which may still turn out to be a stamp
+  std::string held;
+};
+
+/// Bytes actually sent by `send_restamped`
+std::string restamped;
+
+/**
+ * @brief Connect to the core like a shipper does
+ *
+ * @return The connection, `fd` is negative on failure
+ */
+Connection connect_core(ConfigHandler &config) {
+  Connection conn;
+  struct sockaddr_storage addr;
+  socklen_t len = config.getForwardedSocketStore(&addr);
+  conn.fd = socket(config.getSocketType(), SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (conn.fd < 0 || len == 0 ||
+      connect(conn.fd, (struct sockaddr *)&addr, len) < 0) {
+    std::cerr << std::format("Couldn't connect to the core: {}\n",
+                             std::strerror(errno));
+    if (conn.fd >= 0)
+      close(conn.fd);
+    conn.fd = -1;
+    return conn;
+  }
+
+  if (config.usesSharedMemory()) {
+    conn.ring = shm::Ring::receive(conn.fd);
+    if (!conn.ring) {
+      std::cerr << "Couldn't receive the ring from the core\n";
+      close(conn.fd);
+      conn.fd = -1;
+    }
+  }
+  return conn;
+}
+
+/**
+ * @brief Send all of `data` over a connection
+ *
+ * @return False if the core went away
+ */
+bool send_all(Connection &conn, std::string_view data) {
+  if (conn.ring)
+    return conn.ring->write(data.data(), data.size());
+
+  while (!data.empty()) {
+    ssize_t sent = send(conn.fd, data.data(), data.size(), MSG_NOSIGNAL);
+    if (sent < 0) {
+      if (errno == EINTR)
+        continue;
+      return false;
+    }
+    data.remove_prefix(sent);
+  }
+  return true;
+}
+
+/**
+ * @brief Could `line` be the start of a stamp record
+ */
+bool stamp_prefix(std::string_view line) {
+  if (line.size() < trace::PREFIX.size())
+    return trace::PREFIX.starts_with(line);
+  line.remove_prefix(trace::PREFIX.size());
+  // Far more digits than a stamp has
+  return line.size() <= 20 &&
+         line.find_first_not_of("0123456789") == std::string_view::npos;
+}
+
+/**
+ * @brief Send captured bytes with their latency stamps made anew
+ * @details A stamp holds the clock of the capturing host when it was
+ *          captured. Sent as is it would time the capture, not the replay,
+ *          so every line which is a stamp is replaced by one for now. A
+ *          line which may still become a stamp waits for the next bytes of
+ *          the connection.
+ *
+ * @return False if the core went away
+ */
+bool send_restamped(Connection &conn, std::string_view data) {
+  if (conn.held.empty() && data.find(trace::PREFIX[0]) == data.npos) {
+    if (!data.empty())
+      conn.line_start = data.back() == '\n';
+    return send_all(conn, data);
+  }
+
+  std::string text = std::move(conn.held);
+  conn.held.clear();
+  text.append(data);
+  restamped.clear();
+  std::string_view rest = text;
+  while (!rest.empty()) {
+    size_t end = rest.find('\n');
+    if (end == rest.npos) {
+      if (conn.line_start && stamp_prefix(rest)) {
+        conn.held = rest;
+      } else {
+        restamped.append(rest);
+        conn.line_start = false;
+      }
+      break;
+    }
+    std::string_view line = rest.substr(0, end + 1);
+    if (conn.line_start && trace::is_stamp(line))
+      restamped.append(trace::make_stamp());
+    else
+      restamped.append(line);
+    conn.line_start = true;
+    rest.remove_prefix(line.size());
+  }
+  return send_all(conn, restamped);
+}
+
+/**
+ * @brief Send what a connection holds back, the capture has no more for it
+ */
+bool send_held(Connection &conn) {
+  if (conn.held.empty())
+    return true;
+  std::string held = std::move(conn.held);
+  conn.held.clear();
+  return send_all(conn, held);
+}
+
+} // namespace
+
+/**
+ * @brief Replay a capture of the core into a core
+ * @details Usage: `replay <capture> <input.json> [speed]`. Connects to the
+ *          core `input.json` points at, exactly like the shipper, opening a
+ *          connection for every connection of the capture and sending what
+ *          it sent. `speed` is `1` (the default) for the timing of the
+ *          capture, `N` for N times as fast or `max` to send as fast as the
+ *          core takes it. Events are replayed in order from one thread, so a
+ *          connection the core doesn't read holds up the others. Latency
+ *          stamps are sent with the time they are replayed at.
+ */
+int main(int argc, char **argv) {
+  if (argc != 3 && argc != 4) {
+    std::cerr << "Usage: replay <capture> <input.json> [speed|max]\n";
+    exit(EXIT_FAILURE);
+  }
+
+  double speed = 1;
+  bool max_speed = false;
+  if (argc == 4) {
+    if (std::string(argv[3]) == "max") {
+      max_speed = true;
+    } else {
+      speed = std::atof(argv[3]);
+      if (speed <= 0) {
+        std::cerr << "speed must be a positive number or max\n";
+        exit(EXIT_FAILURE);
+      }
+    }
+  }
+
+  int fd = open(argv[1], O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    std::cerr << std::format("Couldn't open {}: {}\n", argv[1],
+                             std::strerror(errno));
+    exit(EXIT_FAILURE);
+  }
+  struct stat st;
+  fstat(fd, &st);
+  size_t size = st.st_size;
+  void *mapped = size ? mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0)
+                      : MAP_FAILED;
+  close(fd);
+  if (mapped == MAP_FAILED) {
+    std::cerr << std::format("Couldn't map {}\n", argv[1]);
+    exit(EXIT_FAILURE);
+  }
+  madvise(mapped, size, MADV_SEQUENTIAL);
+  std::string_view file(static_cast<const char *>(mapped), size);
+  if (!file.starts_with(capture::MAGIC)) {
+    std::cerr << std::format("{} is not a capture\n", argv[1]);
+    exit(EXIT_FAILURE);
+  }
+  file.remove_prefix(capture::MAGIC.size());
+
+  ConfigHandler config(argv[2]);
+  std::unordered_map<uint32_t, Connection> conns;
+  uint64_t bytes = 0;
+  uint64_t replayed = 0;
+  auto start = std::chrono::steady_clock::now();
+
+  while (file.size() >= sizeof(capture::EventHeader)) {
+    capture::EventHeader header;
+    std::memcpy(&header, file.data(), sizeof(header));
+    if (file.size() < sizeof(header) + header.length()) {
+      std::cerr << "The capture ends in the middle of an event\n";
+      break;
+    }
+    std::string_view data = file.substr(sizeof(header), header.length());
+    file.remove_prefix(sizeof(header) + header.length());
+
+    if (!max_speed) {
+      auto due = std::chrono::nanoseconds(
+          static_cast<int64_t>(header.time_ns / speed));
+      std::this_thread::sleep_until(start + due);
+    }
+
+    switch (header.type()) {
+    case capture::EventType::Open:
+    case capture::EventType::Data: {
+      auto [entry, inserted] = conns.try_emplace(header.conn);
+      if (inserted)
+        entry->second = connect_core(config);
+      Connection &conn = entry->second;
+      if (conn.fd < 0)
+        break;
+      if (!send_restamped(conn, data)) {
+        std::cerr << std::format("Connection {} lost: {}\n", header.conn,
+                                 std::strerror(errno));
+        close(conn.fd);
+        conn.fd = -1;
+        conn.ring.reset();
+        break;
+      }
+      bytes += data.size();
+      break;
+    }
+    case capture::EventType::Close:
+      if (auto entry = conns.find(header.conn); entry != conns.end()) {
+        if (entry->second.fd >= 0) {
+          send_held(entry->second);
+          close(entry->second.fd);
+        }
+        conns.erase(entry);
+      }
+      break;
+    }
+    ++replayed;
+  }
+
+  for (auto &[id, conn] : conns) {
+    if (conn.fd >= 0) {
+      send_held(conn);
+      close(conn.fd);
+    }
+  }
+
+  double seconds = std::chrono::duration<double>(
+                       std::chrono::steady_clock::now() - start)
+                       .count();
+  std::cerr << std::format("Replayed {} events, {} bytes in {:.3f}s ({:.1f} "
+                           "MB/s)\n",
+                           replayed, bytes, seconds,
+                           seconds > 0 ? bytes / seconds / 1e6 : 0.0);
+  munmap(mapped, size);
+}
@@ -0,0 +1,123 @@
+#include <cstdio>
+#include <nlohmann/json.hpp>
+#include <string>
+#include <string_view>
+#include <transform/dislog_transform.h>
+#include <vector>
+
+/**
+ * @file redact.cpp
+ * @brief Example transform plugin masking the values of `key=value` pairs
+ * @details Config:
+ *          `{"keys": ["password", "token"], "route_if_contains": "level=error"}`
+ *          Values of the keys are replaced by `***`. Records containing
+ *          `route_if_contains`, if set, go to the first route of the plugin.
+ */
+
+namespace {
+
+struct Redact {
+  std::vector<std::string> patterns;
+  std::string route_if_contains;
+
+  /// Rewritten records of the last batch, back to back
+  std::string arena;
+  std::vector<std::pair<size_t, size_t>> rewrites;
+};
+
+/**
+ * @brief Append the record to the arena with the values masked
+ * @return Was anything masked
+ */
+bool redact(const Redact &state, std::string_view record, std::string &out) {
+  bool masked = false;
+  size_t copied = 0;
+  for (size_t at = 0; at < record.size(); ++at) {
+    if (at > 0 && record[at - 1] != ' ')
+      continue;
+    for (const std::string &pattern : state.patterns) {
+      if (record.substr(at, pattern.size()) != pattern)
+        continue;
+      size_t value = at + pattern.size();
+      size_t end = record.find_first_of(" \r\n", value);
+      if (end == std::string_view::npos)
+        end = record.size();
+      out.append(record.substr(copied, value - copied));
+      out.append("***");
+      copied = end;
+      at = end;
+      masked = true;
+      break;
+    }
+  }
+  out.append(record.substr(copied));
+  return masked;
+}
+
+void *create(const char *, const char *config, char *error, size_t error_len) {
+  auto parsed = nlohmann::json::parse(config, nullptr, false);
+  if (!parsed.is_object() || !parsed.contains("keys") ||
+      !parsed["keys"].is_array()) {
+    std::snprintf(error, error_len, "keys is not a list of names");
+    return nullptr;
+  }
+
+  auto *state = new Redact;
+  for (auto &key : parsed["keys"]) {
+    if (!key.is_string() || key.get<std::string>().empty()) {
+      std::snprintf(error, error_len, "keys is not a list of names");
+      delete state;
+      return nullptr;
+    }
+    state->patterns.push_back(key.get<std::string>() + "=");
+  }
+  if (parsed.contains("route_if_contains") &&
+      parsed["route_if_contains"].is_string())
+    state->route_if_contains = parsed["route_if_contains"].get<std::string>();
+  return state;
+}
+
+void destroy(void *instance) { delete static_cast<Redact *>(instance); }
+
+int process(void *instance, const dislog_span *records, size_t count,
+            dislog_decision *decisions) {
+  auto &state = *static_cast<Redact *>(instance);
+  state.arena.clear();
+  state.rewrites.clear();
+
+  // Offsets first, the arena may move while it grows
+  for (size_t i = 0; i < count; ++i) {
+    std::string_view record(records[i].data, records[i].len);
+    size_t start = state.arena.size();
+    if (redact(state, record, state.arena)) {
+      state.rewrites.emplace_back(i, start);
+      decisions[i].verdict = DISLOG_REWRITE;
+    } else {
+      state.arena.resize(start);
+    }
+    if (!state.route_if_contains.empty() &&
+        record.find(state.route_if_contains) != std::string_view::npos) {
+      decisions[i].verdict = DISLOG_ROUTE;
+      decisions[i].route = 0;
+    }
+  }
+
+  for (size_t r = 0; r < state.rewrites.size(); ++r) {
+    auto [i, start] = state.rewrites[r];
+    size_t end = r + 1 < state.rewrites.size() ? state.rewrites[r + 1].second
+                                               : state.arena.size();
+    decisions[i].rewritten = {state.arena.data() + start, end - start};
+  }
+  return 0;
+}
+
+const dislog_transform_plugin PLUGIN = {
+    DISLOG_TRANSFORM_ABI_VERSION, "redact", create, destroy, process,
+};
+
+} // namespace
+
+extern "C" __attribute__((visibility("default"))) const dislog_transform_plugin *
+dislog_transform_entry(void) {
+  return &PLUGIN;
+}